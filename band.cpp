@@ -0,0 +1,267 @@
+#include "./band.h"
+
+#include <thread>
+
+// ============================================================================
+// [BandWriter]
+// ============================================================================
+
+BandWriter::BandWriter() noexcept {}
+BandWriter::~BandWriter() noexcept {}
+
+// ============================================================================
+// [FileBandWriter]
+// ============================================================================
+
+FileBandWriter::FileBandWriter(const char* fileName, uint32_t format) noexcept
+  : _fileName(fileName),
+    _format(format),
+    _file(nullptr) {}
+
+FileBandWriter::~FileBandWriter() noexcept {
+  if (_file)
+    std::fclose(_file);
+}
+
+bool FileBandWriter::begin(int w, int h) noexcept {
+  // BMP stores the file and image size as 32-bit integers, the header fails
+  // to initialize if they don't fit.
+  BmpHeader bmp;
+  if (_format == kFormatBmp && !bmp.init(w, h))
+    return false;
+
+  _file = std::fopen(_fileName, "wb");
+  if (!_file)
+    return false;
+
+  if (_format == kFormatBmp) {
+    if (std::fwrite(&bmp.signature, sizeof(BmpHeader) - 2, 1, _file) != 1)
+      return false;
+  }
+
+  return true;
+}
+
+bool FileBandWriter::write(const Image& strip, int y, int h) noexcept {
+  (void)y;
+
+  size_t rowSize = size_t(strip.width()) * 4;
+  const uint8_t* row = strip.data();
+
+  if (strip.stride() == intptr_t(rowSize))
+    return std::fwrite(row, rowSize * size_t(h), 1, _file) == 1;
+
+  for (int i = 0; i < h; i++, row += strip.stride())
+    if (std::fwrite(row, rowSize, 1, _file) != 1)
+      return false;
+  return true;
+}
+
+bool FileBandWriter::end() noexcept {
+  int err = std::fclose(_file);
+  _file = nullptr;
+  return err == 0;
+}
+
+// ============================================================================
+// [ImageBandWriter]
+// ============================================================================
+
+ImageBandWriter::ImageBandWriter() noexcept {}
+ImageBandWriter::~ImageBandWriter() noexcept {}
+
+bool ImageBandWriter::begin(int w, int h) noexcept {
+  return _image.create(w, h);
+}
+
+bool ImageBandWriter::write(const Image& strip, int y, int h) noexcept {
+  size_t rowSize = size_t(strip.width()) * 4;
+  for (int i = 0; i < h; i++)
+    std::memcpy(_image.data() + intptr_t(y + i) * _image.stride(), strip.data() + intptr_t(i) * strip.stride(), rowSize);
+  return true;
+}
+
+bool ImageBandWriter::end() noexcept {
+  return true;
+}
+
+// ============================================================================
+// [BandRenderer - Construction / Destruction]
+// ============================================================================
+
+BandRenderer::BandRenderer(int w, int h, uint32_t options, int bandHeight) noexcept
+  : _width(w),
+    _height(h),
+    _bandHeight(bandHeight),
+    _options(options),
+    _bandCount(0),
+    _rasterizers { nullptr, nullptr },
+    _rendered(0),
+    _written(0),
+    _writeFailed(false) {}
+
+BandRenderer::~BandRenderer() noexcept {
+  delete _rasterizers[0];
+  delete _rasterizers[1];
+}
+
+bool BandRenderer::_init() noexcept {
+  if (_rasterizers[0])
+    return true;
+
+  int bh = std::min(_bandHeight, _height);
+  for (uint32_t i = 0; i < 2; i++) {
+    if (!_strips[i].create(_width, bh))
+      return false;
+
+    _rasterizers[i] = new(std::nothrow) TileRasterizer(_strips[i], _options);
+    if (!_rasterizers[i] || !_rasterizers[i]->init(_width, bh)) {
+      delete _rasterizers[0];
+      delete _rasterizers[1];
+      _rasterizers[0] = _rasterizers[1] = nullptr;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// ============================================================================
+// [BandRenderer - Render]
+// ============================================================================
+
+bool BandRenderer::_bin(const Scene& scene) noexcept {
+  uint32_t bh = uint32_t(_bandHeight);
+  _bandCount = (uint32_t(_height) + bh - 1) / bh;
+
+  if (!_binOffsets.resize(size_t(_bandCount) + 1))
+    return false;
+
+  uint32_t* offsets = _binOffsets.data();
+  std::memset(offsets, 0, (size_t(_bandCount) + 1) * sizeof(uint32_t));
+
+  // Same two-pass binning as `TileRenderer::_bin()`, but only by y.
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (size_t i = 0; i < scene.shapeCount(); i++) {
+      const Scene::Shape& shape = scene.shapeAt(i);
+
+      int y0 = std::max(shape.y0, 0);
+      int y1 = std::min(shape.y1, _height);
+
+      if (shape.x0 >= _width || shape.x1 <= 0 || y0 >= y1)
+        continue;
+
+      uint32_t b0 = uint32_t(y0) / bh;
+      uint32_t b1 = uint32_t(y1 - 1) / bh;
+
+      for (uint32_t b = b0; b <= b1; b++) {
+        if (pass == 0)
+          offsets[b + 1]++;
+        else
+          _binShapes[offsets[b]++] = uint32_t(i);
+      }
+    }
+
+    if (pass == 0) {
+      for (uint32_t b = 0; b < _bandCount; b++)
+        offsets[b + 1] += offsets[b];
+
+      if (!_binShapes.resize(offsets[_bandCount]))
+        return false;
+    }
+    else {
+      std::memmove(offsets + 1, offsets, _bandCount * sizeof(uint32_t));
+      offsets[0] = 0;
+    }
+  }
+
+  return true;
+}
+
+void BandRenderer::_renderBand(const Scene& scene, uint32_t bandIndex, Image& strip, uint32_t background) noexcept {
+  TileRasterizer& ras = *_rasterizers[bandIndex & 1];
+
+  int y = int(bandIndex) * _bandHeight;
+  int h = std::min(_bandHeight, _height - y);
+
+  strip.fillRect(0, 0, _width, h, background);
+  ras.setTile(0, 0, _width, h);
+  ras.setOrigin(0, y);
+
+  const Scene::Contour* contours = scene.contours();
+  const Point* points = scene.points();
+
+  for (uint32_t i = _binOffsets[bandIndex]; i < _binOffsets[bandIndex + 1]; i++) {
+    const Scene::Shape& shape = scene.shapeAt(_binShapes[i]);
+
+    for (uint32_t c = 0; c < shape.contourCount; c++) {
+      const Scene::Contour& contour = contours[shape.contourIndex + c];
+      ras.addPoly(points + contour.pointIndex, contour.pointCount);
+    }
+
+    ras.setFillMode(shape.fillMode);
+    ras.render(shape.argb32);
+  }
+}
+
+void BandRenderer::_writerMain(BandWriter* writer) noexcept {
+  for (uint32_t b = 0; b < _bandCount; b++) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _condition.wait(lock, [&] { return _rendered > b; });
+    }
+
+    int y = int(b) * _bandHeight;
+    int h = std::min(_bandHeight, _height - y);
+    bool ok = writer->write(_strips[b & 1], y, h);
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _written = b + 1;
+      if (!ok) {
+        _writeFailed = true;
+        _written = _bandCount;
+      }
+    }
+    _condition.notify_all();
+
+    if (!ok)
+      return;
+  }
+}
+
+bool BandRenderer::render(const Scene& scene, uint32_t background, BandWriter& writer) noexcept {
+  if (_width <= 0 || _height <= 0 || _bandHeight <= 0)
+    return false;
+
+  if (!_init() || !_bin(scene) || !writer.begin(_width, _height))
+    return false;
+
+  _rendered = 0;
+  _written = 0;
+  _writeFailed = false;
+
+  // Two strips - band `b` is rendered into strip `b & 1` once band `b - 2`
+  // that used it before has been written.
+  std::thread writerThread(&BandRenderer::_writerMain, this, &writer);
+
+  for (uint32_t b = 0; b < _bandCount; b++) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _condition.wait(lock, [&] { return b < _written + 2; });
+      if (_writeFailed)
+        break;
+    }
+
+    _renderBand(scene, b, _strips[b & 1], background);
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _rendered = b + 1;
+    }
+    _condition.notify_all();
+  }
+
+  writerThread.join();
+  return writer.end() && !_writeFailed;
+}
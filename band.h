@@ -0,0 +1,123 @@
+#ifndef _BAND_H
+#define _BAND_H
+
+#include "./globals.h"
+#include "./scene.h"
+#include "./tile.h"
+
+#include <condition_variable>
+#include <mutex>
+
+// ============================================================================
+// [BandWriter]
+// ============================================================================
+
+//! Consumer of horizontal bands (strips) of an image rendered by
+//! `BandRenderer`, bands are passed from top to bottom.
+class BandWriter {
+public:
+  BandWriter() noexcept;
+  virtual ~BandWriter() noexcept;
+
+  virtual bool begin(int w, int h) noexcept = 0;
+  //! Writes `h` rows of `strip`, which are rows `[y, y + h)` of the image.
+  virtual bool write(const Image& strip, int y, int h) noexcept = 0;
+  virtual bool end() noexcept = 0;
+};
+
+//! Writes bands to a file as they come, either as a top-down 32-bit BMP or as
+//! raw premultiplied ARGB32 rows.
+class FileBandWriter : public BandWriter {
+public:
+  enum Format : uint32_t {
+    kFormatBmp = 0,
+    kFormatRaw = 1
+  };
+
+  FileBandWriter(const char* fileName, uint32_t format) noexcept;
+  virtual ~FileBandWriter() noexcept;
+
+  virtual bool begin(int w, int h) noexcept override;
+  virtual bool write(const Image& strip, int y, int h) noexcept override;
+  virtual bool end() noexcept override;
+
+  const char* _fileName;
+  uint32_t _format;
+  std::FILE* _file;
+};
+
+//! Copies bands into an image of the full size created by `begin()`, used to
+//! compare banded output with a full-frame render of a canvas that fits into
+//! memory.
+class ImageBandWriter : public BandWriter {
+public:
+  ImageBandWriter() noexcept;
+  virtual ~ImageBandWriter() noexcept;
+
+  inline const Image& image() const noexcept { return _image; }
+
+  virtual bool begin(int w, int h) noexcept override;
+  virtual bool write(const Image& strip, int y, int h) noexcept override;
+  virtual bool end() noexcept override;
+
+  Image _image;
+};
+
+// ============================================================================
+// [BandRenderer]
+// ============================================================================
+
+//! Renders a scene of any size in horizontal bands with constant memory.
+//!
+//! Shapes are binned by their y bounds into bands of `bandHeight` rows. Each
+//! band is rasterized by a `TileRasterizer` spanning the whole width into one
+//! of two band-sized strips and handed to a `BandWriter` running on its own
+//! thread, so the next band is rasterized while the previous one is written.
+//! Memory used is proportional to `w * bandHeight` instead of `w * h`.
+class BandRenderer {
+public:
+  enum : uint32_t {
+    kDefaultBandHeight = 64
+  };
+
+  BandRenderer(int w, int h, uint32_t options, int bandHeight = kDefaultBandHeight) noexcept;
+  ~BandRenderer() noexcept;
+
+  BandRenderer(const BandRenderer& other) noexcept = delete;
+  BandRenderer& operator=(const BandRenderer& other) noexcept = delete;
+
+  inline int width() const noexcept { return _width; }
+  inline int height() const noexcept { return _height; }
+  inline int bandHeight() const noexcept { return _bandHeight; }
+
+  //! Renders `scene` onto `background` and passes all bands to `writer`.
+  bool render(const Scene& scene, uint32_t background, BandWriter& writer) noexcept;
+
+  bool _init() noexcept;
+  bool _bin(const Scene& scene) noexcept;
+  void _renderBand(const Scene& scene, uint32_t bandIndex, Image& strip, uint32_t background) noexcept;
+  void _writerMain(BandWriter* writer) noexcept;
+
+  int _width;
+  int _height;
+  int _bandHeight;
+  uint32_t _options;
+  uint32_t _bandCount;
+
+  Image _strips[2];
+  TileRasterizer* _rasterizers[2];
+
+  //! Offsets into `_binShapes` of each band (`bandCount + 1` items).
+  PodArray<uint32_t> _binOffsets;
+  //! Shape indexes of all bins, in scene order.
+  PodArray<uint32_t> _binShapes;
+
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  //! Number of bands rendered / written, guarded by `_mutex`.
+  uint32_t _rendered;
+  uint32_t _written;
+  bool _writeFailed;
+};
+
+#endif // _BAND_H
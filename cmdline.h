@@ -0,0 +1,55 @@
+#ifndef _CMDLINE_H
+#define _CMDLINE_H
+
+#include "./globals.h"
+
+// ============================================================================
+// [CmdLine]
+// ============================================================================
+
+class CmdLine {
+public:
+  CmdLine(int argc, const char* const* argv)
+    : argc(argc),
+      argv(argv) {}
+
+  bool hasKey(const char* key) const {
+    size_t size = ::strlen(key);
+    for (int i = 0; i < argc; i++)
+      if (::strlen(argv[i]) >= size && ::memcmp(argv[i], key, size) == 0)
+        return true;
+    return false;
+  }
+
+  const char* valueOf(const char* key) const {
+    size_t keySize = ::strlen(key);
+    size_t argSize = 0;
+
+    const char* arg = nullptr;
+    for (int i = 0; i <= argc; i++) {
+      if (i == argc)
+        return nullptr;
+
+      arg = argv[i];
+      argSize = ::strlen(arg);
+      if (argSize >= keySize && ::memcmp(arg, key, keySize) == 0)
+        break;
+    }
+
+    if (argSize > keySize && arg[keySize] == '=')
+      return arg + keySize + 1;
+    else
+      return arg + keySize;
+  }
+
+  int intValueOf(const char* key) const {
+    const char* value = valueOf(key);
+    if (!value) return 0;
+    return atoi(value);
+  }
+
+  int argc;
+  const char* const* argv;
+};
+
+#endif // _CMDLINE_H
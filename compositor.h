@@ -9,6 +9,10 @@
 // ============================================================================
 
 namespace CompositeUtils {
+  //! Minimum length (in pixels) of an opaque run that `CompositorSIMD::cmask()`
+  //! writes by non-temporal (streaming) stores.
+  static constexpr size_t kNonTemporalThreshold = 2048;
+
   template<bool NonZero>
   static ALWAYS_INLINE uint32_t calcMask(int m) noexcept {
     if (NonZero) {
@@ -21,6 +25,21 @@ namespace CompositeUtils {
     }
     return uint32_t(m);
   }
+
+  //! Calculates a mask from a floating point coverage, where `1.0` means full
+  //! coverage (used by rasterizers that accumulate float area deltas).
+  template<bool NonZero>
+  static ALWAYS_INLINE uint32_t calcMaskF(float c) noexcept {
+    c = std::fabs(c);
+    if (NonZero) {
+      if (c > 1.0f) c = 1.0f;
+    }
+    else {
+      c -= float(int(c * 0.5f)) * 2.0f;
+      if (c > 1.0f) c = 2.0f - c;
+    }
+    return uint32_t(int(c * 255.0f + 0.5f));
+  }
 }
 
 // ============================================================================
@@ -57,12 +76,50 @@ public:
     return x0;
   }
 
-  template<bool NonZero>
+  template<bool NonZero, bool ResetCells = true>
   ALWAYS_INLINE uint32_t vmask(uint32_t* dst, size_t x0, size_t x1, Cell* cell, int& cover) {
     while (x0 < x1) {
       cover += cell[x0].cover;
       uint32_t mask = CompositeUtils::calcMask<NonZero>(cover - (cell[x0].area >> 9));
-      cell[x0].reset();
+      if (ResetCells)
+        cell[x0].reset();
+
+      if (mask == 255)
+        overwrite(&dst[x0]);
+      else
+        composite(&dst[x0], mask);
+      x0++;
+    }
+    return x0;
+  }
+
+  //! Like `vmask()`, but cells are given as separate planes of `covers` and
+  //! `areas` (the SoA layout, see `Rasterizer::kOptionSoA`).
+  template<bool NonZero, bool ResetCells = true>
+  ALWAYS_INLINE uint32_t vmaskSoA(uint32_t* dst, size_t x0, size_t x1, int* covers, int* areas, int& cover) {
+    while (x0 < x1) {
+      cover += covers[x0];
+      uint32_t mask = CompositeUtils::calcMask<NonZero>(cover - (areas[x0] >> 9));
+      if (ResetCells) {
+        covers[x0] = 0;
+        areas[x0] = 0;
+      }
+
+      if (mask == 255)
+        overwrite(&dst[x0]);
+      else
+        composite(&dst[x0], mask);
+      x0++;
+    }
+    return x0;
+  }
+
+  template<bool NonZero>
+  ALWAYS_INLINE uint32_t fmask(uint32_t* dst, size_t x0, size_t x1, float* acc, float& cover) {
+    while (x0 < x1) {
+      cover += acc[x0];
+      uint32_t mask = CompositeUtils::calcMaskF<NonZero>(cover);
+      acc[x0] = 0.0f;
 
       if (mask == 255)
         overwrite(&dst[x0]);
@@ -107,25 +164,57 @@ public:
   }
 
   ALWAYS_INLINE uint32_t cmask(uint32_t* dst, size_t x0, size_t x1, uint32_t mask) noexcept {
-    size_t i = (x1 - x0) / 4;
+    // Process pixels one by one until `dst + x0` is 16-byte aligned, so the
+    // main loops can use aligned loads and stores.
+    size_t head = std::min<size_t>(((16 - (uintptr_t(dst + x0) & 15)) & 15) / 4, x1 - x0);
+
     if (mask == 255) {
-      while (i >= 8) {
-        SIMD::vstorei128u(dst + x0 +  0, _p32);
-        SIMD::vstorei128u(dst + x0 +  4, _p32);
-        SIMD::vstorei128u(dst + x0 +  8, _p32);
-        SIMD::vstorei128u(dst + x0 + 12, _p32);
-        SIMD::vstorei128u(dst + x0 + 16, _p32);
-        SIMD::vstorei128u(dst + x0 + 20, _p32);
-        SIMD::vstorei128u(dst + x0 + 24, _p32);
-        SIMD::vstorei128u(dst + x0 + 28, _p32);
-        x0 += 32;
-        i -= 8;
+      while (head) {
+        overwrite(dst + x0);
+        x0++;
+        head--;
       }
 
-      while (i) {
-        SIMD::vstorei128u(dst + x0, _p32);
-        x0 += 4;
-        i--;
+      size_t i = (x1 - x0) / 4;
+      if (i * 4 >= CompositeUtils::kNonTemporalThreshold) {
+        // Long opaque runs bypass the cache, they would only evict data that
+        // is going to be used again (cells, other rows being composited).
+        while (i >= 4) {
+          SIMD::vstreami128(dst + x0 +  0, _p32);
+          SIMD::vstreami128(dst + x0 +  4, _p32);
+          SIMD::vstreami128(dst + x0 +  8, _p32);
+          SIMD::vstreami128(dst + x0 + 12, _p32);
+          x0 += 16;
+          i -= 4;
+        }
+
+        while (i) {
+          SIMD::vstreami128(dst + x0, _p32);
+          x0 += 4;
+          i--;
+        }
+
+        SIMD::vsfence();
+      }
+      else {
+        while (i >= 8) {
+          SIMD::vstorei128a(dst + x0 +  0, _p32);
+          SIMD::vstorei128a(dst + x0 +  4, _p32);
+          SIMD::vstorei128a(dst + x0 +  8, _p32);
+          SIMD::vstorei128a(dst + x0 + 12, _p32);
+          SIMD::vstorei128a(dst + x0 + 16, _p32);
+          SIMD::vstorei128a(dst + x0 + 20, _p32);
+          SIMD::vstorei128a(dst + x0 + 24, _p32);
+          SIMD::vstorei128a(dst + x0 + 28, _p32);
+          x0 += 32;
+          i -= 8;
+        }
+
+        while (i) {
+          SIMD::vstorei128a(dst + x0, _p32);
+          x0 += 4;
+          i--;
+        }
       }
 
       while (x0 < x1) {
@@ -134,6 +223,13 @@ public:
       }
     }
     else {
+      while (head) {
+        composite(dst + x0, mask);
+        x0++;
+        head--;
+      }
+
+      size_t i = (x1 - x0) / 4;
       SIMD::I128 mVal = SIMD::vswizi32<0, 0, 0, 0>(SIMD::vswizli16<0, 0, 0, 0>(SIMD::vcvti32i128(mask)));
       SIMD::I128 mPix = SIMD::vmulu16(_u32, mVal);
       SIMD::I128 mInv = SIMD::vxor(mVal, SIMD::u16_00FF_128.i128);
@@ -142,8 +238,8 @@ public:
         SIMD::I128 s0, s1;
         SIMD::I128 s2, s3;
 
-        s0 = SIMD::vloadi128u(dst + x0 + 0);
-        s2 = SIMD::vloadi128u(dst + x0 + 4);
+        s0 = SIMD::vloadi128a(dst + x0 + 0);
+        s2 = SIMD::vloadi128a(dst + x0 + 4);
 
         s1 = SIMD::vmovhi64u8u16(s0);
         s3 = SIMD::vmovhi64u8u16(s2);
@@ -172,8 +268,8 @@ public:
         s0 = SIMD::vpacki16u8(s0, s1);
         s2 = SIMD::vpacki16u8(s2, s3);
 
-        SIMD::vstorei128u(dst + x0 + 0, s0);
-        SIMD::vstorei128u(dst + x0 + 4, s2);
+        SIMD::vstorei128a(dst + x0 + 0, s0);
+        SIMD::vstorei128a(dst + x0 + 4, s2);
         x0 += 8;
         i -= 2;
       }
@@ -181,8 +277,7 @@ public:
       if (i) {
         SIMD::I128 s0, s1;
 
-        s0 = SIMD::vloadi128u(dst + x0 + 0);
-        s1 = SIMD::vloadi128u(dst + x0 + 4);
+        s0 = SIMD::vloadi128a(dst + x0);
         s1 = SIMD::vmovhi64u8u16(s0);
         s0 = SIMD::vmovli64u8u16(s0);
         s1 = SIMD::vmulu16(s1, mInv);
@@ -193,7 +288,7 @@ public:
         s0 = SIMD::vdiv255u16(s0);
         s0 = SIMD::vpacki16u8(s0, s1);
 
-        SIMD::vstorei128u(dst + x0, s0);
+        SIMD::vstorei128a(dst + x0, s0);
         x0 += 4;
       }
 
@@ -214,13 +309,69 @@ public:
     return x0;
   }
 
-  template<bool NonZero>
+  //! Composites pixels `[x0, x1)` of `vmask()` one by one, `coverXmm` holds
+  //! the cover in its first lane.
+  template<bool NonZero, bool ResetCells>
+  ALWAYS_INLINE size_t _vmaskPixels(uint32_t* dst, size_t x0, size_t x1, Cell* cell, SIMD::I128& coverXmm) noexcept {
+    SIMD_DEF_I128_1xI32(u32_01FF_128, 0x000001FF);
+
+    while (x0 < x1) {
+      SIMD::I128 m0;
+      SIMD::I128 s0;
+      SIMD::I128 t0;
+
+      t0 = SIMD::vloadi128_32(&cell[x0].cover);
+      m0 = SIMD::vloadi128_32(&cell[x0].area);
+
+      coverXmm = SIMD::vaddi32(coverXmm, t0);
+      if (ResetCells)
+        cell[x0].reset();
+      m0 = SIMD::vsrai32<9>(m0);
+      m0 = SIMD::vsubi32(coverXmm, m0);
+
+      if (NonZero) {
+        m0 = SIMD::vabsi32(m0);
+        m0 = SIMD::vpacki32i16(m0, m0);
+        m0 = SIMD::vmini16(m0, SIMD::u16_00FF_128.i128);
+      }
+      else {
+        m0 = SIMD::vand(m0, u32_01FF_128.i128);
+        m0 = SIMD::vpacki32i16(m0, m0);
+        t0 = SIMD::vsubi32(u32_01FF_128.i128, m0);
+        m0 = SIMD::vmini16(m0, t0);
+      }
+
+      s0 = SIMD::vloadi128_32(dst + x0);
+      m0 = SIMD::vswizli16<0, 0, 0, 0>(m0);
+
+      s0 = SIMD::vmovli64u8u16(s0);
+      t0 = SIMD::vmulu16(m0, _u32);
+      m0 = SIMD::vxor(m0, SIMD::u16_00FF_128.i128);
+      s0 = SIMD::vmulu16(s0, m0);
+      s0 = SIMD::vaddi16(s0, t0);
+      s0 = SIMD::vdiv255u16(s0);
+      s0 = SIMD::vpacki16u8(s0, s0);
+
+      SIMD::vstorei32(dst + x0, s0);
+      x0++;
+    }
+
+    return x0;
+  }
+
+  template<bool NonZero, bool ResetCells = true>
   ALWAYS_INLINE uint32_t vmask(uint32_t* dst, size_t x0, size_t x1, Cell* cell, int& cover) noexcept {
     SIMD_DEF_I128_1xI32(u32_01FF_128, 0x000001FF);
     SIMD_DEF_I128_1xI32(u16_01FF_128, 0x01FF01FF);
 
     SIMD::I128 coverXmm = SIMD::vcvti32i128(cover);
 
+    // Process pixels one by one until `dst + x0` is 16-byte aligned, so the
+    // main loop can use aligned loads and stores of pixels (cells are loaded
+    // unaligned, they are 8 bytes each).
+    size_t head = std::min<size_t>(((16 - (uintptr_t(dst + x0) & 15)) & 15) / 4, x1 - x0);
+    x0 = _vmaskPixels<NonZero, ResetCells>(dst, x0, x0 + head, cell, coverXmm);
+
     size_t i = (x1 - x0) / 4;
     if (i) {
       coverXmm = SIMD::vswizi32<0, 0, 0, 0>(coverXmm);
@@ -364,8 +515,10 @@ public:
         m0 = SIMD::vaddi32(m0, t0);                            // [c3:c2|c2:c1|c1:c0|  c0 ]
 
         t0 = SIMD::vzeroi128();                                // [  0  |  0  |  0  |  0  ]
-        SIMD::vstorei128u(&cell[x0 + 0], t0);
-        SIMD::vstorei128u(&cell[x0 + 2], t0);
+        if (ResetCells) {
+          SIMD::vstorei128u(&cell[x0 + 0], t0);
+          SIMD::vstorei128u(&cell[x0 + 2], t0);
+        }
         t0 = SIMD::vunpackli64(t0, m0);                        // [c1:c0|  c0 |  0  |  0  ]
 
         m1 = SIMD::vsrai32<9>(m1);
@@ -391,7 +544,7 @@ public:
         m1 = SIMD::vswizi32<3, 3, 2, 2>(m0);
         m0 = SIMD::vswizi32<1, 1, 0, 0>(m0);
 
-        s0 = SIMD::vloadi128u(dst + x0);
+        s0 = SIMD::vloadi128a(dst + x0);
         s1 = SIMD::vmovhi64u8u16(s0);
         s0 = SIMD::vmovli64u8u16(s0);
 
@@ -407,22 +560,36 @@ public:
         s1 = SIMD::vdiv255u16(s1);
         s0 = SIMD::vpacki16u8(s0, s1);
 
-        SIMD::vstorei128u(dst + x0, s0);
+        SIMD::vstorei128a(dst + x0, s0);
         x0 += 4;
         i--;
       }
     }
 
+    x0 = _vmaskPixels<NonZero, ResetCells>(dst, x0, x1, cell, coverXmm);
+    cover = SIMD::vcvti128i32(coverXmm);
+    return x0;
+  }
+
+  //! Composites pixels `[x0, x1)` of `vmaskSoA()` one by one, `coverXmm`
+  //! holds the cover in its first lane.
+  template<bool NonZero, bool ResetCells>
+  ALWAYS_INLINE size_t _vmaskSoAPixels(uint32_t* dst, size_t x0, size_t x1, int* covers, int* areas, SIMD::I128& coverXmm) noexcept {
+    SIMD_DEF_I128_1xI32(u32_01FF_128, 0x000001FF);
+
     while (x0 < x1) {
       SIMD::I128 m0;
       SIMD::I128 s0;
       SIMD::I128 t0;
 
-      t0 = SIMD::vloadi128_32(&cell[x0].cover);
-      m0 = SIMD::vloadi128_32(&cell[x0].area);
+      t0 = SIMD::vcvti32i128(covers[x0]);
+      m0 = SIMD::vcvti32i128(areas[x0]);
 
       coverXmm = SIMD::vaddi32(coverXmm, t0);
-      cell[x0].reset();
+      if (ResetCells) {
+        covers[x0] = 0;
+        areas[x0] = 0;
+      }
       m0 = SIMD::vsrai32<9>(m0);
       m0 = SIMD::vsubi32(coverXmm, m0);
 
@@ -453,10 +620,188 @@ public:
       x0++;
     }
 
+    return x0;
+  }
+
+  //! Like `vmask()`, but cells are given as separate planes of `covers` and
+  //! `areas` (the SoA layout, see `Rasterizer::kOptionSoA`). Covers and areas
+  //! of 4 pixels are loaded directly, without de-interleaving `Cell` pairs.
+  template<bool NonZero, bool ResetCells = true>
+  ALWAYS_INLINE uint32_t vmaskSoA(uint32_t* dst, size_t x0, size_t x1, int* covers, int* areas, int& cover) noexcept {
+    SIMD_DEF_I128_1xI32(u32_01FF_128, 0x000001FF);
+    SIMD_DEF_I128_1xI32(u16_01FF_128, 0x01FF01FF);
+
+    SIMD::I128 coverXmm = SIMD::vcvti32i128(cover);
+
+    // Aligned pixels like `vmask()`, the planes are loaded unaligned.
+    size_t head = std::min<size_t>(((16 - (uintptr_t(dst + x0) & 15)) & 15) / 4, x1 - x0);
+    x0 = _vmaskSoAPixels<NonZero, ResetCells>(dst, x0, x0 + head, covers, areas, coverXmm);
+
+    size_t i = (x1 - x0) / 4;
+    if (i) {
+      coverXmm = SIMD::vswizi32<0, 0, 0, 0>(coverXmm);
+
+      while (i) {
+        SIMD::I128 m0, m1;
+        SIMD::I128 s0, s1;
+        SIMD::I128 t0, t1;
+
+        m0 = SIMD::vloadi128u(covers + x0);                    // [  c3 |  c2 |  c1 |  c0 ]
+        m1 = SIMD::vloadi128u(areas + x0);                     // [  a3 |  a2 |  a1 |  a0 ]
+
+        t0 = SIMD::vslli128b<4>(m0);                           // [  c2 |  c1 |  c0 |  0  ]
+        m0 = SIMD::vaddi32(m0, t0);                            // [c3:c2|c2:c1|c1:c0|  c0 ]
+        t0 = SIMD::vslli128b<8>(m0);                           // [c1:c0|  c0 |  0  |  0  ]
+
+        if (ResetCells) {
+          SIMD::vstorei128u(covers + x0, SIMD::vzeroi128());
+          SIMD::vstorei128u(areas + x0, SIMD::vzeroi128());
+        }
+
+        m1 = SIMD::vsrai32<9>(m1);
+        m0 = SIMD::vaddi32(m0, t0);                            // [c3:c0|c2:c0|c1:c0|  c0 ]
+        coverXmm = SIMD::vaddi32(coverXmm, m0);
+        m1 = SIMD::vsubi32(coverXmm, m1);
+
+        if (NonZero) {
+          m0 = SIMD::vabsi32(m1);
+          m0 = SIMD::vpacki32i16(m0, m0);
+          m0 = SIMD::vmini16(m0, SIMD::u16_00FF_128.i128);
+        }
+        else {
+          m1 = SIMD::vand(m1, u32_01FF_128.i128);
+          m1 = SIMD::vpacki32i16(m1, m1);
+          m0 = SIMD::vsubi32(u16_01FF_128.i128, m1);
+          m0 = SIMD::vmini16(m0, m1);
+        }
+
+        m0 = SIMD::vunpackli16(m0, m0);
+        coverXmm = SIMD::vswizi32<3, 3, 3, 3>(coverXmm);
+
+        m1 = SIMD::vswizi32<3, 3, 2, 2>(m0);
+        m0 = SIMD::vswizi32<1, 1, 0, 0>(m0);
+
+        s0 = SIMD::vloadi128a(dst + x0);
+        s1 = SIMD::vmovhi64u8u16(s0);
+        s0 = SIMD::vmovli64u8u16(s0);
+
+        t0 = SIMD::vmulu16(_u32, m0);
+        t1 = SIMD::vmulu16(_u32, m1);
+        m0 = SIMD::vxor(m0, SIMD::u16_00FF_128.i128);
+        m1 = SIMD::vxor(m1, SIMD::u16_00FF_128.i128);
+        s0 = SIMD::vmulu16(s0, m0);
+        s1 = SIMD::vmulu16(s1, m1);
+        s0 = SIMD::vaddi16(s0, t0);
+        s1 = SIMD::vaddi16(s1, t1);
+        s0 = SIMD::vdiv255u16(s0);
+        s1 = SIMD::vdiv255u16(s1);
+        s0 = SIMD::vpacki16u8(s0, s1);
+
+        SIMD::vstorei128a(dst + x0, s0);
+        x0 += 4;
+        i--;
+      }
+    }
+
+    x0 = _vmaskSoAPixels<NonZero, ResetCells>(dst, x0, x1, covers, areas, coverXmm);
     cover = SIMD::vcvti128i32(coverXmm);
     return x0;
   }
 
+  template<bool NonZero>
+  ALWAYS_INLINE uint32_t fmask(uint32_t* dst, size_t x0, size_t x1, float* acc, float& cover) noexcept {
+    SIMD_DEF_I128_1xI32(u32_7FFFFFFF_128, 0x7FFFFFFF);
+    SIMD_DEF_F128_1xF32(f32_0_5_128, 0.5f);
+    SIMD_DEF_F128_1xF32(f32_1_0_128, 1.0f);
+    SIMD_DEF_F128_1xF32(f32_2_0_128, 2.0f);
+    SIMD_DEF_F128_1xF32(f32_255_0_128, 255.0f);
+
+    // Aligned pixels like `vmask()`, the accumulation buffer is loaded
+    // unaligned.
+    size_t head = std::min<size_t>(((16 - (uintptr_t(dst + x0) & 15)) & 15) / 4, x1 - x0);
+    x0 = _fmaskPixels<NonZero>(dst, x0, x0 + head, acc, cover);
+
+    SIMD::F128 coverXmm = SIMD::vsetf128(cover);
+    SIMD::F128 zero = SIMD::vzerof128();
+
+    size_t i = (x1 - x0) / 4;
+    while (i) {
+      SIMD::F128 a0, t0;
+      SIMD::I128 m0, m1;
+      SIMD::I128 s0, s1;
+      SIMD::I128 u0, u1;
+
+      // Prefix sum of 4 area deltas, then add the coverage carried so far.
+      a0 = SIMD::vloadf128u(acc + x0);                         // [  a3 |  a2 |  a1 |  a0 ]
+      SIMD::vstoref128u(acc + x0, zero);
+
+      t0 = SIMD::vcast<SIMD::F128>(SIMD::vslli128b<4>(SIMD::vcast<SIMD::I128>(a0)));
+      a0 = SIMD::vaddps(a0, t0);                               // [a3:a2|a2:a1|a1:a0|  a0 ]
+      t0 = SIMD::vcast<SIMD::F128>(SIMD::vslli128b<8>(SIMD::vcast<SIMD::I128>(a0)));
+      a0 = SIMD::vaddps(a0, t0);                               // [a3:a0|a2:a0|a1:a0|  a0 ]
+      a0 = SIMD::vaddps(a0, coverXmm);
+      coverXmm = SIMD::vswizf32<3, 3, 3, 3>(a0);
+
+      a0 = SIMD::vand(a0, u32_7FFFFFFF_128.f128);
+      if (NonZero) {
+        a0 = SIMD::vminps(a0, f32_1_0_128.f128);
+      }
+      else {
+        t0 = SIMD::vcvti128f128(SIMD::vcvttf128i128(SIMD::vmulps(a0, f32_0_5_128.f128)));
+        a0 = SIMD::vsubps(a0, SIMD::vaddps(t0, t0));
+        a0 = SIMD::vminps(a0, SIMD::vsubps(f32_2_0_128.f128, a0));
+      }
+
+      a0 = SIMD::vmulps(a0, f32_255_0_128.f128);
+      m0 = SIMD::vcvttf128i128(SIMD::vaddps(a0, f32_0_5_128.f128));
+      m0 = SIMD::vpacki32i16(m0, m0);
+      m0 = SIMD::vunpackli16(m0, m0);
+
+      m1 = SIMD::vswizi32<3, 3, 2, 2>(m0);
+      m0 = SIMD::vswizi32<1, 1, 0, 0>(m0);
+
+      s0 = SIMD::vloadi128a(dst + x0);
+      s1 = SIMD::vmovhi64u8u16(s0);
+      s0 = SIMD::vmovli64u8u16(s0);
+
+      u0 = SIMD::vmulu16(_u32, m0);
+      u1 = SIMD::vmulu16(_u32, m1);
+      m0 = SIMD::vxor(m0, SIMD::u16_00FF_128.i128);
+      m1 = SIMD::vxor(m1, SIMD::u16_00FF_128.i128);
+      s0 = SIMD::vmulu16(s0, m0);
+      s1 = SIMD::vmulu16(s1, m1);
+      s0 = SIMD::vaddi16(s0, u0);
+      s1 = SIMD::vaddi16(s1, u1);
+      s0 = SIMD::vdiv255u16(s0);
+      s1 = SIMD::vdiv255u16(s1);
+      s0 = SIMD::vpacki16u8(s0, s1);
+
+      SIMD::vstorei128a(dst + x0, s0);
+      x0 += 4;
+      i--;
+    }
+
+    cover = SIMD::vcvtf128f32(coverXmm);
+    return _fmaskPixels<NonZero>(dst, x0, x1, acc, cover);
+  }
+
+  //! Composites pixels `[x0, x1)` of `fmask()` one by one.
+  template<bool NonZero>
+  ALWAYS_INLINE size_t _fmaskPixels(uint32_t* dst, size_t x0, size_t x1, float* acc, float& cover) noexcept {
+    while (x0 < x1) {
+      cover += acc[x0];
+      acc[x0] = 0.0f;
+
+      uint32_t mask = CompositeUtils::calcMaskF<NonZero>(cover);
+      if (mask == 255)
+        overwrite(&dst[x0]);
+      else
+        composite(&dst[x0], mask);
+      x0++;
+    }
+    return x0;
+  }
+
   __m128i _p32;
   __m128i _u32;
 };
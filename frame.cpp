@@ -0,0 +1,131 @@
+#include "./frame.h"
+
+// ============================================================================
+// [FrameRenderer - Construction / Destruction]
+// ============================================================================
+
+FrameRenderer::FrameRenderer(Image& dst, uint32_t options, uint32_t background, ThreadPool* pool) noexcept
+  : _dst(&dst),
+    _renderer(dst, options, TileRenderer::kDefaultTileSize, pool),
+    _background(background),
+    _fullDamage(true),
+    _tilesX(0),
+    _tilesY(0) {
+  _renderer.setBackground(background);
+}
+
+FrameRenderer::~FrameRenderer() noexcept {}
+
+// ============================================================================
+// [FrameRenderer - Damage]
+// ============================================================================
+
+void FrameRenderer::invalidate() noexcept {
+  _fullDamage = true;
+}
+
+void FrameRenderer::invalidateRect(int x, int y, int w, int h) noexcept {
+  if (!_fullDamage)
+    _damage(x, y, x + w, y + h);
+}
+
+void FrameRenderer::_damage(int x0, int y0, int x1, int y1) noexcept {
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, _dst->width());
+  y1 = std::min(y1, _dst->height());
+
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  uint32_t ts = _renderer.tileSize();
+  uint32_t tx0 = uint32_t(x0) / ts;
+  uint32_t ty0 = uint32_t(y0) / ts;
+  uint32_t tx1 = uint32_t(x1 - 1) / ts;
+  uint32_t ty1 = uint32_t(y1 - 1) / ts;
+
+  for (uint32_t ty = ty0; ty <= ty1; ty++)
+    std::memset(_dirty.data() + size_t(ty) * _tilesX + tx0, 1, tx1 - tx0 + 1);
+}
+
+// ============================================================================
+// [FrameRenderer - Render]
+// ============================================================================
+
+bool FrameRenderer::render(const Scene& scene) noexcept {
+  uint32_t ts = _renderer.tileSize();
+  uint32_t tilesX = (uint32_t(_dst->width()) + ts - 1) / ts;
+  uint32_t tilesY = (uint32_t(_dst->height()) + ts - 1) / ts;
+  size_t tileCount = size_t(tilesX) * tilesY;
+
+  if (_tilesX != tilesX || _tilesY != tilesY || _dirty.size() != tileCount) {
+    if (!_dirty.resize(tileCount))
+      return false;
+
+    std::memset(_dirty.data(), 0, tileCount);
+    _tilesX = tilesX;
+    _tilesY = tilesY;
+    _fullDamage = true;
+  }
+
+  size_t count = scene.shapeCount();
+  if (!_shapes.resize(count)) {
+    _fullDamage = true;
+    return false;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const Scene::Shape& shape = scene.shapeAt(i);
+    ShapeState& state = _shapes[i];
+
+    state.hash = scene.shapeHash(i);
+    state.x0 = shape.x0;
+    state.y0 = shape.y0;
+    state.x1 = shape.x1;
+    state.y1 = shape.y1;
+  }
+
+  if (_fullDamage) {
+    std::memset(_dirty.data(), 1, tileCount);
+  }
+  else {
+    // Shapes are matched by their index, a shape inserted in the middle of the
+    // frame damages all shapes after it, which is conservative, but correct.
+    size_t prevCount = _prevShapes.size();
+    size_t n = std::max(prevCount, count);
+
+    for (size_t i = 0; i < n; i++) {
+      const ShapeState* prev = i < prevCount ? &_prevShapes[i] : nullptr;
+      const ShapeState* cur = i < count ? &_shapes[i] : nullptr;
+
+      if (prev && cur && prev->hash == cur->hash &&
+          prev->x0 == cur->x0 && prev->y0 == cur->y0 && prev->x1 == cur->x1 && prev->y1 == cur->y1)
+        continue;
+
+      if (prev) _damage(prev->x0, prev->y0, prev->x1, prev->y1);
+      if (cur) _damage(cur->x0, cur->y0, cur->x1, cur->y1);
+    }
+  }
+
+  _dirtyList.clear();
+  if (!_dirtyList.reserve(tileCount)) {
+    _fullDamage = true;
+    return false;
+  }
+
+  for (size_t i = 0; i < tileCount; i++) {
+    if (_dirty[i]) {
+      _dirtyList.append(uint32_t(i));
+      _dirty[i] = 0;
+    }
+  }
+
+  if (!_dirtyList.empty() && !_renderer.renderTiles(scene, _dirtyList.data(), uint32_t(_dirtyList.size()))) {
+    _fullDamage = true;
+    return false;
+  }
+
+  _prevShapes.swap(_shapes);
+  _fullDamage = false;
+  return true;
+}
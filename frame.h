@@ -0,0 +1,70 @@
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include "./globals.h"
+#include "./scene.h"
+
+// ============================================================================
+// [FrameRenderer]
+// ============================================================================
+
+//! Incremental renderer of a sequence of frames (scenes) into the same image.
+//!
+//! Each shape of a frame is recorded by its pixel bounds and a hash of its
+//! content. Before rendering a frame the shapes are compared index by index
+//! with the previous frame - bounds of every shape that was added, removed or
+//! changed (both its old and new bounds) are damaged. Only tiles touched by
+//! the damage are then filled by the background and re-rendered, the rest of
+//! the image is kept from the previous frame.
+//!
+//! Damage is tracked at the tile granularity of the `TileRenderer` the frame
+//! is rendered by, so rasterizers clip to damaged tiles for free.
+class FrameRenderer {
+public:
+  struct ShapeState {
+    uint64_t hash;
+    int x0, y0, x1, y1;
+  };
+
+  FrameRenderer(Image& dst, uint32_t options, uint32_t background, ThreadPool* pool = nullptr) noexcept;
+  ~FrameRenderer() noexcept;
+
+  FrameRenderer(const FrameRenderer& other) noexcept = delete;
+  FrameRenderer& operator=(const FrameRenderer& other) noexcept = delete;
+
+  inline TileRenderer& tileRenderer() noexcept { return _renderer; }
+
+  //! Damages the whole image, the next frame is rendered completely.
+  void invalidate() noexcept;
+  //! Damages a rectangle, for example if the image was modified externally.
+  void invalidateRect(int x, int y, int w, int h) noexcept;
+
+  //! Renders `scene` as the next frame.
+  bool render(const Scene& scene) noexcept;
+
+  //! Number of tiles rendered by the last `render()`.
+  inline uint32_t damagedTileCount() const noexcept { return uint32_t(_dirtyList.size()); }
+  //! Number of all tiles of the image.
+  inline uint32_t tileCount() const noexcept { return _tilesX * _tilesY; }
+
+  void _damage(int x0, int y0, int x1, int y1) noexcept;
+
+  Image* _dst;
+  TileRenderer _renderer;
+  uint32_t _background;
+  bool _fullDamage;
+
+  uint32_t _tilesX;
+  uint32_t _tilesY;
+
+  //! Shapes of the previous and the current frame.
+  PodArray<ShapeState> _prevShapes;
+  PodArray<ShapeState> _shapes;
+
+  //! One byte per tile, non-zero if the tile is damaged.
+  PodArray<uint8_t> _dirty;
+  //! Indexes of damaged tiles passed to `TileRenderer::renderTiles()`.
+  PodArray<uint32_t> _dirtyList;
+};
+
+#endif // _FRAME_H
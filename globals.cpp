@@ -0,0 +1,122 @@
+#include "./compositor.h"
+#include "./globals.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #define RAS_HAS_MMAP 1
+#else
+  #define RAS_HAS_MMAP 0
+#endif
+
+// ============================================================================
+// [Image - Fill]
+// ============================================================================
+
+void Image::fillRect(int x, int y, int w, int h, uint32_t argb32) noexcept {
+  int x0 = x;
+  int y0 = y;
+  int x1 = x + w;
+  int y1 = y + h;
+
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > _width) x1 = _width;
+  if (y1 > _height) y1 = _height;
+
+  if (x0 >= x1)
+    return;
+
+  uint8_t* scanline = _data + intptr_t(y0) * _stride;
+  CompositorSIMD compositor(argb32);
+
+  while (y0 < y1) {
+    compositor.cmask(reinterpret_cast<uint32_t*>(scanline), size_t(x0), size_t(x1), 255);
+    scanline += _stride;
+    y0++;
+  }
+}
+
+// ============================================================================
+// [MappedFile]
+// ============================================================================
+
+bool MappedFile::open(const char* fileName) noexcept {
+  reset();
+
+#if RAS_HAS_MMAP
+  int fd = ::open(fileName, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 0) {
+    ::close(fd);
+    return false;
+  }
+
+  // Mapping an empty file fails.
+  if (st.st_size == 0) {
+    ::close(fd);
+    return true;
+  }
+
+  void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (p == MAP_FAILED)
+    return false;
+
+  _data = static_cast<const uint8_t*>(p);
+  _size = size_t(st.st_size);
+  _mapped = true;
+  return true;
+#else
+  std::FILE* f = std::fopen(fileName, "rb");
+  if (!f)
+    return false;
+
+  long size = -1;
+  if (std::fseek(f, 0, SEEK_END) == 0)
+    size = std::ftell(f);
+
+  if (size < 0 || std::fseek(f, 0, SEEK_SET) != 0) {
+    std::fclose(f);
+    return false;
+  }
+
+  if (size == 0) {
+    std::fclose(f);
+    return true;
+  }
+
+  uint8_t* data = static_cast<uint8_t*>(std::malloc(size_t(size)));
+  if (!data || std::fread(data, 1, size_t(size), f) != size_t(size)) {
+    std::free(data);
+    std::fclose(f);
+    return false;
+  }
+
+  std::fclose(f);
+  _data = data;
+  _size = size_t(size);
+  return true;
+#endif
+}
+
+void MappedFile::reset() noexcept {
+  if (_data) {
+#if RAS_HAS_MMAP
+    if (_mapped)
+      munmap(const_cast<uint8_t*>(_data), _size);
+    else
+#endif
+      std::free(const_cast<uint8_t*>(_data));
+  }
+
+  _data = nullptr;
+  _size = 0;
+  _mapped = false;
+}
@@ -25,10 +25,13 @@
 // Function attributes.
 #if defined(__GNUC__)
   #define ALWAYS_INLINE inline __attribute__((always_inline))
+  #define NOINLINE __attribute__((noinline))
 #elif defined(_MSC_VER)
   #define ALWAYS_INLINE __forceinline
+  #define NOINLINE __declspec(noinline)
 #else
   #define ALWAYS_INLINE inline
+  #define NOINLINE
 #endif
 
 // ============================================================================
@@ -48,8 +51,13 @@ struct Bounds {
     end = 0;
   }
 
+  inline void reset(int a, int b) noexcept {
+    start = a;
+    end = b;
+  }
+
   inline bool empty() const noexcept {
-    return end == 0;
+    return start > end;
   }
 
   inline void mergeStart(int x) noexcept { start = std::min(start, x); }
@@ -78,6 +86,95 @@ struct Cell {
   int32_t area;
 };
 
+// ============================================================================
+// [PodArray]
+// ============================================================================
+
+//! Minimal growable array of trivially copyable items.
+//!
+//! Used by code that records data of unknown size (scenes, bins, traces). It
+//! never throws, functions that allocate return `false` on failure instead.
+template<typename T>
+class PodArray {
+public:
+  inline PodArray() noexcept
+    : _data(nullptr),
+      _size(0),
+      _capacity(0) {}
+
+  inline ~PodArray() noexcept { reset(); }
+
+  PodArray(const PodArray& other) noexcept = delete;
+  PodArray& operator=(const PodArray& other) noexcept = delete;
+
+  inline void reset() noexcept {
+    if (_data)
+      std::free(_data);
+    _data = nullptr;
+    _size = 0;
+    _capacity = 0;
+  }
+
+  inline void clear() noexcept { _size = 0; }
+
+  inline bool empty() const noexcept { return _size == 0; }
+  inline size_t size() const noexcept { return _size; }
+  inline size_t capacity() const noexcept { return _capacity; }
+
+  inline T* data() noexcept { return _data; }
+  inline const T* data() const noexcept { return _data; }
+
+  inline T& operator[](size_t i) noexcept { assert(i < _size); return _data[i]; }
+  inline const T& operator[](size_t i) const noexcept { assert(i < _size); return _data[i]; }
+
+  bool reserve(size_t n) noexcept {
+    if (n <= _capacity)
+      return true;
+
+    size_t capacity = std::max<size_t>(std::max<size_t>(n, _capacity * 2), 16);
+    T* data = static_cast<T*>(std::realloc(_data, capacity * sizeof(T)));
+
+    if (!data)
+      return false;
+
+    _data = data;
+    _capacity = capacity;
+    return true;
+  }
+
+  inline bool resize(size_t n) noexcept {
+    if (!reserve(n))
+      return false;
+    _size = n;
+    return true;
+  }
+
+  inline bool append(const T& item) noexcept {
+    if (_size == _capacity && !reserve(_size + 1))
+      return false;
+    _data[_size++] = item;
+    return true;
+  }
+
+  inline bool append(const T* items, size_t n) noexcept {
+    if (!reserve(_size + n))
+      return false;
+    std::memcpy(_data + _size, items, n * sizeof(T));
+    _size += n;
+    return true;
+  }
+
+  inline void swap(PodArray& other) noexcept {
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+    std::swap(_capacity, other._capacity);
+  }
+
+  T* _data;
+  size_t _size;
+  size_t _capacity;
+};
+
 // ============================================================================
 // [Random]
 // ============================================================================
@@ -238,7 +335,17 @@ namespace PixelUtils {
 
 #pragma pack(push, 1)
 struct BmpHeader {
-  void init(int w, int h) {
+  //! File and image sizes are 32-bit, so the image can have at most this many
+  //! bytes (the file also contains 54 bytes of headers).
+  static constexpr uint64_t kMaxImageSize = uint64_t(0xFFFFFFFFu) - 54u;
+
+  //! Initializes the header of a `w` x `h` 32-bit image, returns `false` if
+  //! the image is larger than `kMaxImageSize`.
+  bool init(int w, int h) {
+    uint64_t size = uint64_t(uint32_t(w)) * uint64_t(uint32_t(h)) * 4u;
+    if (size > kMaxImageSize)
+      return false;
+
     std::memset(this, 0, sizeof(BmpHeader));
 
     signature[0]    = 'B';
@@ -250,12 +357,13 @@ struct BmpHeader {
     planes          = 1;
     bitsPerPixel    = 32;
     compression     = 0;
-    imageSize       = w * h * 4;
+    imageSize       = uint32_t(size);
     colorsUsed      = 0;
     colorsImportant = 0;
 
     imageOffset     = 14 + headerSize;
     fileSize        = imageOffset + imageSize;
+    return true;
   }
 
   uint8_t padding[2];
@@ -282,61 +390,120 @@ struct BmpHeader {
 // ============================================================================
 
 // 32-bit ARGB image.
+//
+// Rows are 64-byte aligned (the stride is a multiple of 64) so SIMD kernels
+// can use aligned loads and stores after a short scalar head.
+//
+// An image can also be a non-owning view of external pixels or of a part of
+// another image. `data()` always points to the top row and the stride can be
+// negative (bottom-up buffers like BMP or OpenGL readbacks).
 class Image {
 public:
+  enum : uint32_t {
+    kRowAlignment = 64
+  };
+
   inline Image() noexcept :
     _width(0),
     _height(0),
     _stride(0),
-    _data(nullptr) {}
+    _data(nullptr),
+    _buffer(nullptr) {}
 
   inline Image(Image&& other) noexcept :
     _width(other._width),
     _height(other._height),
     _stride(other._stride),
-    _data(other._data) { other._data = nullptr; }
+    _data(other._data),
+    _buffer(other._buffer) {
+    other._data = nullptr;
+    other._buffer = nullptr;
+  }
 
   inline ~Image() noexcept {
-    if (_data)
-      std::free(_data);
+    if (_buffer)
+      std::free(_buffer);
   }
 
   Image(const Image& other) noexcept = delete;
   Image& operator=(const Image& other) noexcept = delete;
 
   void reset() noexcept {
-    if (_data) {
-      std::free(_data);
-      _width = 0;
-      _height = 0;
-      _stride = 0;
-      _data = nullptr;
-    }
+    if (_buffer)
+      std::free(_buffer);
+
+    _width = 0;
+    _height = 0;
+    _stride = 0;
+    _data = nullptr;
+    _buffer = nullptr;
   }
 
-  bool create(int w, int h) noexcept {
-    if (_data)
-      std::free(_data);
+  //! Creates a `w` x `h` image, `stridePadding` bytes are added to each row
+  //! before aligning the stride to `kRowAlignment`. Padding is useful to avoid
+  //! cache set conflicts of power-of-two strides.
+  bool create(int w, int h, int stridePadding = 0) noexcept {
+    reset();
+
+    if (w <= 0 || h <= 0)
+      return true;
 
-    bool ok = true;
-    if (w > 0 && h > 0) {
-      _width = w;
-      _height = h;
-      _stride = w * 4;
-      _data = static_cast<uint8_t*>(std::malloc(size_t(_stride * h)));
+    size_t stride = (size_t(w) * 4 + size_t(std::max(stridePadding, 0)) + kRowAlignment - 1) & ~size_t(kRowAlignment - 1);
+    _buffer = std::malloc(stride * size_t(h) + kRowAlignment - 1);
 
-      ok = _data != nullptr;
-      if (ok) return ok;
+    if (!_buffer)
+      return false;
+
+    _width = w;
+    _height = h;
+    _stride = intptr_t(stride);
+    _data = reinterpret_cast<uint8_t*>((uintptr_t(_buffer) + kRowAlignment - 1) & ~uintptr_t(kRowAlignment - 1));
+    return true;
+  }
+
+  //! Makes the image a non-owning view of `w` x `h` pixels, `data` points to
+  //! the top row and `stride` can be negative.
+  void attach(uint8_t* data, int w, int h, intptr_t stride) noexcept {
+    reset();
+
+    if (!data || w <= 0 || h <= 0)
+      return;
+
+    _width = w;
+    _height = h;
+    _stride = stride;
+    _data = data;
+  }
+
+  //! Makes the image a non-owning view of a rectangle of `src` (clipped to it),
+  //! returns `false` if the rectangle is empty.
+  bool attachRect(const Image& src, int x, int y, int w, int h) noexcept {
+    int x0 = std::max(x, 0);
+    int y0 = std::max(y, 0);
+    int x1 = std::min(x + w, src._width);
+    int y1 = std::min(y + h, src._height);
+
+    if (x0 >= x1 || y0 >= y1) {
+      reset();
+      return false;
     }
 
-    _width = 0;
-    _height = 0;
-    _stride = 0;
-    _data = nullptr;
+    attach(src._data + intptr_t(y0) * src._stride + intptr_t(x0) * 4, x1 - x0, y1 - y0, src._stride);
+    return true;
+  }
 
-    return ok;
+  //! Makes the image a non-owning, vertically flipped view of `src`.
+  void attachFlipped(const Image& src) noexcept {
+    if (!src._data) {
+      reset();
+      return;
+    }
+
+    attach(src._data + intptr_t(src._height - 1) * src._stride, src._width, src._height, -src._stride);
   }
 
+  inline bool isView() const noexcept { return _data != nullptr && _buffer == nullptr; }
+
   inline int width() const noexcept { return _width; }
   inline int height() const noexcept { return _height; }
   inline intptr_t stride() const noexcept { return _stride; }
@@ -344,48 +511,33 @@ public:
   template<typename T = uint8_t>
   inline T* data() const noexcept { return reinterpret_cast<T*>(_data); }
 
+  //! Returns the lowest address of pixel data, which is the bottom row if the
+  //! stride is negative (some libraries like AGG expect this pointer).
+  inline uint8_t* lowestAddress() const noexcept {
+    return _stride >= 0 || !_data ? _data : _data + intptr_t(_height - 1) * _stride;
+  }
+
   void fillAll(uint32_t argb32) noexcept {
     fillRect(0, 0, int(_width), int(_height), argb32);
   }
 
-  void fillRect(int x, int y, int w, int h, uint32_t argb32) noexcept {
-    int x0 = x;
-    int y0 = y;
-    int x1 = x + w;
-    int y1 = y + h;
-
-    if (x0 < 0) x0 = 0;
-    if (y0 < 0) y0 = 0;
-    if (x1 > _width) x1 = _width;
-    if (y1 > _height) y1 = _height;
-
-    if (x0 >= x1)
-      return;
-
-    uint8_t* scanline = _data + intptr_t(y0) * _stride + x0 * 4;
-    size_t width = size_t(x1 - x0);
-
-    uint32_t prgb32 = PixelUtils::premultiply(argb32);
-    while (y0 < y1) {
-      uint32_t* p = reinterpret_cast<uint32_t*>(scanline);
-      for (size_t i = 0; i < width; i++)
-        p[i] = prgb32;
-
-      scanline += _stride;
-      y0++;
-    }
-  }
+  //! Fills a rectangle by the SIMD `cmask()` kernel (see `globals.cpp`).
+  void fillRect(int x, int y, int w, int h, uint32_t argb32) noexcept;
 
   bool writeBmp(const char* fileName) const noexcept {
     BmpHeader bmp;
-    bmp.init(_width, _height);
+    if (!bmp.init(_width, _height))
+      return false;
 
     std::FILE* f = std::fopen(fileName, "wb");
     if (!f)
       return false;
 
+    // Rows can be padded or bottom-up, write them one by one.
     std::fwrite(&bmp.signature, sizeof(BmpHeader) - 2, 1, f);
-    std::fwrite(_data, _stride * _height, 1, f);
+    for (int y = 0; y < _height; y++)
+      std::fwrite(_data + intptr_t(y) * _stride, size_t(_width) * 4, 1, f);
+
     std::fclose(f);
     return true;
   }
@@ -394,6 +546,41 @@ public:
   int _height;
   intptr_t _stride;
   uint8_t* _data;
+  void* _buffer;
+};
+
+// ============================================================================
+// [MappedFile]
+// ============================================================================
+
+//! Read-only view of a whole file.
+//!
+//! The file is mapped where `mmap()` is available, otherwise it's read into a
+//! buffer allocated by `malloc()`. Either way the data is at least 8-byte
+//! aligned and is not NUL terminated.
+class MappedFile {
+public:
+  inline MappedFile() noexcept :
+    _data(nullptr),
+    _size(0),
+    _mapped(false) {}
+
+  inline ~MappedFile() noexcept { reset(); }
+
+  MappedFile(const MappedFile& other) noexcept = delete;
+  MappedFile& operator=(const MappedFile& other) noexcept = delete;
+
+  //! Maps `fileName`, returns `false` if it cannot be opened or read. Empty
+  //! files are valid, `data()` is `nullptr` in that case.
+  bool open(const char* fileName) noexcept;
+  void reset() noexcept;
+
+  inline const uint8_t* data() const noexcept { return _data; }
+  inline size_t size() const noexcept { return _size; }
+
+  const uint8_t* _data;
+  size_t _size;
+  bool _mapped;
 };
 
 #endif // _GLOBALS_H
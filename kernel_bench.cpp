@@ -0,0 +1,1402 @@
+#include "./band.h"
+#include "./cmdline.h"
+#include "./compositor.h"
+#include "./globals.h"
+#include "./intutils.h"
+#include "./perfcounters.h"
+#include "./performance.h"
+#include "./rasterizer.h"
+#include "./retained.h"
+#include "./scene.h"
+
+#include <ctype.h>
+
+#if !defined(_MSC_VER) && (defined(__i386__) || defined(__x86_64__))
+  #include <x86intrin.h>
+  #define KERNEL_BENCH_HAS_TSC 1
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+  #define KERNEL_BENCH_HAS_TSC 1
+#else
+  #define KERNEL_BENCH_HAS_TSC 0
+#endif
+
+// ============================================================================
+// [KernelConfig]
+// ============================================================================
+
+//! Number of pixels (or bits) a timed sample processes at most, kernels are
+//! called repeatedly on short spans until a sample reaches this size.
+static constexpr size_t kSamplePixels = 65536;
+
+//! Number of cells all rows of a `vmask()` sample can use (512kB).
+static constexpr size_t kSampleCells = 65536;
+
+//! Number of BitWords all rows of a `bitVectorFill()` sample can use.
+static constexpr size_t kSampleWords = 65536;
+
+//! Number of masks `cmask()` samples cycle through (must be a power of 2).
+static constexpr size_t kMaskCount = 1024;
+
+//! Pixels before and after each span, `kGuardPixels * 4` must be a multiple
+//! of 16 so an offset of zero means an aligned span.
+static constexpr size_t kGuardPixels = 8;
+
+static constexpr uint32_t kMaxLength = 1u << 20;
+static constexpr uint32_t kMaxListSize = 64;
+
+static const uint32_t defaultLengths[] = { 1, 3, 4, 7, 16, 64, 256, 1024, 4096 };
+static const uint32_t defaultPixelOffsets[] = { 0, 1, 2, 3 };
+static const uint32_t defaultBitOffsets[] = { 0, 1, 13, IntUtils::kBitWordBits - 1 };
+
+static const char* const maskDistributions[] = { "opaque", "alpha", "mixed" };
+static const char* const cellDistributions[] = { "solid", "sparse", "dense" };
+static const char* const bitDistributions[] = { "sparse", "runs", "dense" };
+
+struct KernelConfig {
+  enum Format : uint32_t {
+    kFormatText = 0,
+    kFormatCsv = 1
+  };
+
+  uint32_t repeats;
+  uint32_t format;
+  //! Only cross-checks kernels, doesn't time them.
+  bool checkOnly;
+  //! Hardware performance counters (cycles), null if not used.
+  PerfCounters* counters;
+
+  //! Comma separated filters, null means everything.
+  const char* kernels;
+  const char* distributions;
+  const char* variants;
+
+  //! Comma separated sweeps, null means defaults.
+  const char* lengths;
+  const char* offsets;
+};
+
+// Returns `true` if the comma separated `list` contains `name` (ignoring case)
+// or if there is no list at all.
+static bool listContains(const char* list, const char* name) {
+  if (!list)
+    return true;
+
+  size_t nameSize = strlen(name);
+  for (;;) {
+    const char* end = strchr(list, ',');
+    size_t size = end ? size_t(end - list) : strlen(list);
+
+    if (size == nameSize) {
+      size_t i = 0;
+      while (i < size && tolower((unsigned char)list[i]) == tolower((unsigned char)name[i]))
+        i++;
+      if (i == size)
+        return true;
+    }
+
+    if (!end)
+      return false;
+    list = end + 1;
+  }
+}
+
+// Parses a comma separated `list` of numbers into `out` (copies `defaults` if
+// there is no list), returns the number of numbers stored.
+static size_t parseList(const char* list, const uint32_t* defaults, size_t defaultCount, uint32_t* out) {
+  size_t count = 0;
+
+  if (!list) {
+    while (count < defaultCount && count < kMaxListSize) {
+      out[count] = defaults[count];
+      count++;
+    }
+    return count;
+  }
+
+  while (*list && count < kMaxListSize) {
+    char* end;
+    long value = strtol(list, &end, 10);
+    if (end == list)
+      break;
+
+    if (value >= 0)
+      out[count++] = uint32_t(std::min<long>(value, long(kMaxLength)));
+    list = *end == ',' ? end + 1 : end;
+  }
+  return count;
+}
+
+// Keeps results of kernels alive.
+static volatile uint32_t kernelSink;
+
+// ============================================================================
+// [KernelTimer]
+// ============================================================================
+
+//! Measures cycles and nanoseconds of samples.
+//!
+//! Core cycles are read from the performance counters when available, the
+//! time-stamp counter (which ticks at a constant reference frequency) is used
+//! otherwise. The overhead of the timer itself is measured once and subtracted
+//! from all samples, otherwise it would dominate samples of short spans.
+class KernelTimer {
+public:
+  explicit inline KernelTimer(PerfCounters* counters) noexcept
+    : _counters(counters),
+      _tsc(0),
+      _ns(0),
+      _cycleOverhead(0),
+      _nsOverhead(0) {}
+
+  static inline bool hasTsc() noexcept { return KERNEL_BENCH_HAS_TSC != 0; }
+
+  static inline uint64_t readTsc() noexcept {
+#if KERNEL_BENCH_HAS_TSC
+    return uint64_t(__rdtsc());
+#else
+    return 0;
+#endif
+  }
+
+  inline bool hasCycles() const noexcept { return _counters || hasTsc(); }
+
+  inline const char* cyclesSource() const noexcept {
+    return _counters ? "perf (core cycles)" : hasTsc() ? "tsc (reference cycles)" : "n/a";
+  }
+
+  void calibrate() noexcept {
+    uint64_t cycleSamples[64];
+    uint64_t nsSamples[64];
+
+    _cycleOverhead = 0;
+    _nsOverhead = 0;
+
+    for (uint32_t i = 0; i < 64; i++) {
+      start();
+      stop(cycleSamples[i], nsSamples[i]);
+    }
+
+    PerformanceStats cycles;
+    PerformanceStats ns;
+
+    cycles.compute(cycleSamples, 64);
+    ns.compute(nsSamples, 64);
+
+    _cycleOverhead = uint64_t(cycles.median);
+    _nsOverhead = uint64_t(ns.median);
+  }
+
+  inline void start() noexcept {
+    _ns = Performance::getTimeNs();
+    if (_counters)
+      _counters->start();
+    else
+      _tsc = readTsc();
+  }
+
+  inline void stop(uint64_t& cycles, uint64_t& ns) noexcept {
+    if (_counters) {
+      PerfCounters::Values values;
+      _counters->stop(values);
+      cycles = values.value[PerfCounters::kCycles];
+    }
+    else {
+      cycles = readTsc() - _tsc;
+    }
+    ns = Performance::getTimeNs() - _ns;
+
+    cycles = cycles > _cycleOverhead ? cycles - _cycleOverhead : 0;
+    ns = ns > _nsOverhead ? ns - _nsOverhead : 0;
+  }
+
+  PerfCounters* _counters;
+  uint64_t _tsc;
+  uint64_t _ns;
+  uint64_t _cycleOverhead;
+  uint64_t _nsOverhead;
+};
+
+// ============================================================================
+// [KernelResult]
+// ============================================================================
+
+struct KernelResult {
+  const char* kernel;
+  const char* variant;
+  const char* distribution;
+  uint32_t length;
+  uint32_t offset;
+
+  //! Pixels (bits) processed by a single sample.
+  size_t pixels;
+  PerformanceStats cycles;
+  PerformanceStats ns;
+};
+
+static void printResultHeader(const KernelConfig& config, const KernelTimer& timer) {
+  if (config.format == KernelConfig::kFormatCsv)
+    printf("kernel,variant,distribution,length,offset,repeats,"
+           "cycles_per_px_min,cycles_per_px_median,ns_per_px_min,ns_per_px_median\n");
+  else
+    printf("Cycles: %s\n", timer.cyclesSource());
+}
+
+static void printResult(const KernelConfig& config, const KernelTimer& timer, const KernelResult& r) {
+  double px = double(r.pixels);
+
+  if (config.format == KernelConfig::kFormatCsv) {
+    printf("%s,%s,%s,%u,%u,%u,", r.kernel, r.variant, r.distribution, r.length, r.offset, unsigned(r.ns.count));
+    if (timer.hasCycles())
+      printf("%.4f,%.4f,", r.cycles.min / px, r.cycles.median / px);
+    else
+      printf(",,");
+    printf("%.4f,%.4f\n", r.ns.min / px, r.ns.median / px);
+  }
+  else {
+    char label[64];
+    if (r.variant[0])
+      snprintf(label, sizeof(label), "%s_%s [%s]", r.kernel, r.variant, r.distribution);
+    else
+      snprintf(label, sizeof(label), "%s [%s]", r.kernel, r.distribution);
+
+    printf("%-28s [len=%-5u off=%-2u]", label, r.length, r.offset);
+    if (timer.hasCycles())
+      printf(" [min=%8.3f cyc/px] [med=%8.3f cyc/px]", r.cycles.min / px, r.cycles.median / px);
+    printf(" [med=%8.3f ns/px]\n", r.ns.median / px);
+  }
+}
+
+// Times `config.repeats` samples of `bench` and prints the result. `prepare()`
+// is called before each sample (untimed) and `run()` is the sample itself.
+template<typename Bench>
+static void timeKernel(const KernelConfig& config, KernelTimer& timer, KernelResult& r, Bench& bench) {
+  PodArray<uint64_t> cycleSamples;
+  PodArray<uint64_t> nsSamples;
+
+  if (!cycleSamples.reserve(config.repeats) || !nsSamples.reserve(config.repeats))
+    return;
+
+  // Warm up caches and branch predictors.
+  bench.prepare();
+  bench.run();
+
+  for (uint32_t i = 0; i < config.repeats; i++) {
+    uint64_t cycles, ns;
+
+    bench.prepare();
+    timer.start();
+    bench.run();
+    timer.stop(cycles, ns);
+
+    cycleSamples.append(cycles);
+    nsSamples.append(ns);
+  }
+
+  r.pixels = bench.pixels();
+  r.cycles.compute(cycleSamples.data(), cycleSamples.size());
+  r.ns.compute(nsSamples.data(), nsSamples.size());
+  printResult(config, timer, r);
+}
+
+// ============================================================================
+// [KernelData]
+// ============================================================================
+
+// Fills `masks` by masks of the distribution `dist` (see `maskDistributions`),
+// zero is never used as callers skip fully transparent spans.
+static void generateMasks(uint32_t* masks, uint32_t dist, Random& rnd) noexcept {
+  for (size_t i = 0; i < kMaskCount; i++) {
+    uint32_t alpha = 1 + rnd.nextUInt32() % 254;
+    switch (dist) {
+      case 0 : masks[i] = 255; break;
+      case 1 : masks[i] = alpha; break;
+      default: masks[i] = (rnd.nextUInt32() & 1) ? 255 : alpha; break;
+    }
+  }
+}
+
+// Fills `cells` of pixels [x0, x1) of the distribution `dist` (see
+// `cellDistributions`) the way rasterizers do - the accumulated cover stays
+// within [0, 256] and the area of each cell puts its mask between the masks
+// of its neighbors.
+static void generateCells(Cell* cells, size_t x0, size_t x1, uint32_t dist, Random& rnd) noexcept {
+  int prev = 0;
+  int cur = 0;
+
+  for (size_t x = x0; x < x1; x++) {
+    switch (dist) {
+      case 0 : cur = 256; break;
+      case 1 : if (((x - x0) & 15) == 0) cur = int(rnd.nextUInt32() % 257); break;
+      default: cur = int(rnd.nextUInt32() % 257); break;
+    }
+
+    int delta = cur - prev;
+    cells[x].cover = delta;
+    cells[x].area = delta * int(rnd.nextUInt32() & 511);
+    prev = cur;
+  }
+}
+
+// Fills `nBits` of `bits` by the distribution `dist` (see `bitDistributions`).
+static void generateBits(IntUtils::BitWord* bits, size_t nBits, uint32_t dist, Random& rnd) noexcept {
+  std::memset(bits, 0, IntUtils::nBitWordsForNBits(nBits) * sizeof(IntUtils::BitWord));
+
+  size_t i = 0;
+  while (i < nBits) {
+    size_t runStart, runSize;
+    switch (dist) {
+      case 0 : runStart = i + 128 + rnd.nextUInt32() % 256; runSize = 1 + rnd.nextUInt32() % 8; break;
+      case 1 : runStart = i + 1 + rnd.nextUInt32() % 32; runSize = 1 + rnd.nextUInt32() % 32; break;
+      default: runStart = i + (rnd.nextUInt32() & 1); runSize = 1; break;
+    }
+
+    runStart = std::min(runStart, nBits);
+    runSize = std::min(runSize, nBits - runStart);
+
+    for (size_t bit = runStart; bit < runStart + runSize; bit++)
+      IntUtils::bitVectorSetBit(bits, bit, true);
+    i = runStart + runSize + 1;
+  }
+}
+
+// ============================================================================
+// [CMaskBench]
+// ============================================================================
+
+template<class Compositor>
+struct CMaskBench {
+  inline CMaskBench(uint32_t* dst, const uint32_t* masks, size_t x0, size_t length) noexcept
+    : dst(dst),
+      masks(masks),
+      x0(x0),
+      x1(x0 + length),
+      calls(std::max<size_t>(kSamplePixels / length, 1)) {}
+
+  inline size_t pixels() const noexcept { return calls * (x1 - x0); }
+
+  inline void prepare() noexcept {}
+
+  NOINLINE void run() noexcept {
+    Compositor compositor(0xFF3060C0u);
+    for (size_t i = 0; i < calls; i++)
+      compositor.cmask(dst, x0, x1, masks[i & (kMaskCount - 1)]);
+  }
+
+  uint32_t* dst;
+  const uint32_t* masks;
+  size_t x0, x1;
+  size_t calls;
+};
+
+// ============================================================================
+// [VMaskBench]
+// ============================================================================
+
+//! Each call of `vmask()` uses its own row of cells, because cells are reset.
+//! Rows are restored by `prepare()`.
+template<class Compositor, bool NonZero>
+struct VMaskBench {
+  inline VMaskBench(uint32_t* dst, Cell* cells, const Cell* source, size_t cellStride, size_t x0, size_t length) noexcept
+    : dst(dst),
+      cells(cells),
+      source(source),
+      cellStride(cellStride),
+      x0(x0),
+      x1(x0 + length),
+      calls(std::max<size_t>(std::min(kSamplePixels / length, kSampleCells / cellStride), 1)) {}
+
+  inline size_t pixels() const noexcept { return calls * (x1 - x0); }
+
+  inline void prepare() noexcept {
+    std::memcpy(cells, source, calls * cellStride * sizeof(Cell));
+  }
+
+  NOINLINE void run() noexcept {
+    Compositor compositor(0xFF3060C0u);
+    int coverSum = 0;
+
+    for (size_t i = 0; i < calls; i++) {
+      int cover = 0;
+      compositor.template vmask<NonZero>(dst, x0, x1, cells + i * cellStride, cover);
+      coverSum += cover;
+    }
+    kernelSink = uint32_t(coverSum);
+  }
+
+  uint32_t* dst;
+  Cell* cells;
+  const Cell* source;
+  size_t cellStride;
+  size_t x0, x1;
+  size_t calls;
+};
+
+//! `vmaskSoA()` variant of `VMaskBench`, rows of cells are in the layout of
+//! `CellLayoutSoA` - `cellStride` covers followed by `cellStride` areas.
+template<class Compositor, bool NonZero>
+struct VMaskSoABench {
+  inline VMaskSoABench(uint32_t* dst, Cell* cells, const Cell* source, size_t cellStride, size_t x0, size_t length) noexcept
+    : dst(dst),
+      cells(cells),
+      source(source),
+      cellStride(cellStride),
+      x0(x0),
+      x1(x0 + length),
+      calls(std::max<size_t>(std::min(kSamplePixels / length, kSampleCells / cellStride), 1)) {}
+
+  inline size_t pixels() const noexcept { return calls * (x1 - x0); }
+
+  inline void prepare() noexcept {
+    std::memcpy(cells, source, calls * cellStride * sizeof(Cell));
+  }
+
+  NOINLINE void run() noexcept {
+    Compositor compositor(0xFF3060C0u);
+    int coverSum = 0;
+
+    for (size_t i = 0; i < calls; i++) {
+      Cell* row = cells + i * cellStride;
+      int cover = 0;
+      compositor.template vmaskSoA<NonZero>(dst, x0, x1, CellLayoutSoA::covers(row), CellLayoutSoA::areas(row, cellStride), cover);
+      coverSum += cover;
+    }
+    kernelSink = uint32_t(coverSum);
+  }
+
+  uint32_t* dst;
+  Cell* cells;
+  const Cell* source;
+  size_t cellStride;
+  size_t x0, x1;
+  size_t calls;
+};
+
+// ============================================================================
+// [BitFillBench]
+// ============================================================================
+
+//! Each call fills its own row of bits (like rows of `RasterizerA3`), filling
+//! the same bits again would be a no-op the compiler could see through.
+struct BitFillBench {
+  inline BitFillBench(IntUtils::BitWord* bits, size_t index, size_t count) noexcept
+    : bits(bits),
+      index(index),
+      count(count),
+      stride(IntUtils::nBitWordsForNBits(index + count)),
+      calls(std::max<size_t>(std::min(kSamplePixels / count, kSampleWords / stride), 1)) {}
+
+  inline size_t pixels() const noexcept { return calls * count; }
+
+  inline void prepare() noexcept {
+    std::memset(bits, 0, calls * stride * sizeof(IntUtils::BitWord));
+  }
+
+  NOINLINE void run() noexcept {
+    for (size_t i = 0; i < calls; i++)
+      IntUtils::bitVectorFill(bits + i * stride, index, count);
+  }
+
+  IntUtils::BitWord* bits;
+  size_t index;
+  size_t count;
+  size_t stride;
+  size_t calls;
+};
+
+// ============================================================================
+// [BitScanBench]
+// ============================================================================
+
+// Scans `nWords` of `bits` the way `RasterizerA3` does and returns a checksum
+// of all runs of ones found (runs are split at BitWord boundaries).
+static ALWAYS_INLINE uint32_t bitScanFlip(const IntUtils::BitWord* bits, size_t nWords) noexcept {
+  uint32_t sum = 0;
+  size_t xOffset = 0;
+
+  for (size_t i = 0; i < nWords; i++) {
+    IntUtils::BitWordFlipIterator<IntUtils::BitWord> it(bits[i]);
+    while (it.hasNext()) {
+      size_t start = xOffset + it.nextAndFlip();
+      size_t end = it.hasNext() ? xOffset + it.nextAndFlip() : xOffset + IntUtils::kBitWordBits;
+      sum = sum * 31u + uint32_t(start * 7u + end);
+    }
+    xOffset += IntUtils::kBitWordBits;
+  }
+  return sum;
+}
+
+// Reference of `bitScanFlip()` that tests bits one by one.
+static uint32_t bitScanReference(const IntUtils::BitWord* bits, size_t nWords) noexcept {
+  uint32_t sum = 0;
+  size_t nBits = nWords * IntUtils::kBitWordBits;
+  size_t x = 0;
+
+  while (x < nBits) {
+    if (!IntUtils::bitVectorGetBit(bits, x)) {
+      x++;
+      continue;
+    }
+
+    size_t start = x;
+    size_t wordEnd = (x / IntUtils::kBitWordBits + 1) * IntUtils::kBitWordBits;
+    while (x < wordEnd && IntUtils::bitVectorGetBit(bits, x))
+      x++;
+    sum = sum * 31u + uint32_t(start * 7u + x);
+  }
+  return sum;
+}
+
+struct BitScanBench {
+  inline BitScanBench(const IntUtils::BitWord* bits, size_t nBits) noexcept
+    : bits(bits),
+      nWords(IntUtils::nBitWordsForNBits(nBits)),
+      calls(std::max<size_t>(kSamplePixels / nBits, 1)),
+      nBits(nBits) {}
+
+  inline size_t pixels() const noexcept { return calls * nBits; }
+
+  inline void prepare() noexcept {}
+
+  NOINLINE void run() noexcept {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < calls; i++)
+      sum += bitScanFlip(bits, nWords);
+    kernelSink = sum;
+  }
+
+  const IntUtils::BitWord* bits;
+  size_t nWords;
+  size_t calls;
+  size_t nBits;
+};
+
+// ============================================================================
+// [KernelBench]
+// ============================================================================
+
+class KernelBench {
+public:
+  KernelBench(KernelConfig& config, KernelTimer& timer) noexcept
+    : _config(config),
+      _timer(timer),
+      _rnd(0x1234),
+      _mismatches(0) {}
+
+  bool init(size_t maxLength) noexcept {
+    size_t rowSize = maxLength + 4 + kGuardPixels * 2;
+    size_t cellCount = std::max(rowSize, kSampleCells);
+    size_t wordCount = std::max(IntUtils::nBitWordsForNBits(maxLength + IntUtils::kBitWordBits * 2), kSampleWords);
+
+    if (!_row.create(int(rowSize), 1) || !_rowRef.create(int(rowSize), 1))
+      return false;
+
+    return _cells.resize(cellCount) &&
+           _cellsRef.resize(cellCount) &&
+           _cellSource.resize(cellCount) &&
+           _cellSourceSoA.resize(cellCount) &&
+           _bits.resize(wordCount) &&
+           _bitsRef.resize(wordCount) &&
+           _masks.resize(kMaskCount);
+  }
+
+  inline uint32_t* row() noexcept { return reinterpret_cast<uint32_t*>(_row.data()); }
+  inline uint32_t* rowRef() noexcept { return reinterpret_cast<uint32_t*>(_rowRef.data()); }
+  inline size_t rowSize() const noexcept { return size_t(_row.width()); }
+
+  inline uint32_t mismatches() const noexcept { return _mismatches; }
+
+  // Fills both rows by the same random pixels.
+  void randomizeRows() noexcept {
+    uint32_t* a = row();
+    uint32_t* b = rowRef();
+    for (size_t i = 0; i < rowSize(); i++)
+      a[i] = b[i] = _rnd.nextUInt32();
+  }
+
+  bool compareRows(size_t& index) noexcept {
+    const uint32_t* a = row();
+    const uint32_t* b = rowRef();
+    for (size_t i = 0; i < rowSize(); i++) {
+      if (a[i] != b[i]) {
+        index = i;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void reportMismatch(const char* kernel, const char* dist, uint32_t length, uint32_t offset, const char* what) noexcept {
+    fprintf(stderr, "MISMATCH: %s [%s] [len=%u off=%u] %s\n", kernel, dist, length, offset, what);
+    _mismatches++;
+  }
+
+  // --------------------------------------------------------------------------
+  // [CMask]
+  // --------------------------------------------------------------------------
+
+  void runCMask(uint32_t dist, uint32_t length, uint32_t offset) noexcept {
+    const char* distName = maskDistributions[dist];
+    generateMasks(_masks.data(), dist, _rnd);
+
+    size_t x0 = kGuardPixels + offset;
+    size_t x1 = x0 + length;
+
+    // Cross-check - the whole row must be the same, including guard pixels.
+    for (uint32_t i = 0; i < 8; i++) {
+      uint32_t mask = _masks.data()[i];
+      randomizeRows();
+
+      CompositorSIMD simd(0xFF3060C0u);
+      CompositorScalar scalar(0xFF3060C0u);
+
+      size_t r0 = simd.cmask(row(), x0, x1, mask);
+      size_t r1 = scalar.cmask(rowRef(), x0, x1, mask);
+
+      size_t index;
+      char what[128];
+
+      if (r0 != r1) {
+        snprintf(what, sizeof(what), "returned %u, scalar returned %u (mask=%u)", unsigned(r0), unsigned(r1), mask);
+        reportMismatch("cmask", distName, length, offset, what);
+        break;
+      }
+
+      if (!compareRows(index)) {
+        snprintf(what, sizeof(what), "pixel %d is %08X, scalar %08X (mask=%u)",
+          int(index) - int(x0), row()[index], rowRef()[index], mask);
+        reportMismatch("cmask", distName, length, offset, what);
+        break;
+      }
+    }
+
+    if (_config.checkOnly)
+      return;
+
+    KernelResult r;
+    r.kernel = "cmask";
+    r.distribution = distName;
+    r.length = length;
+    r.offset = offset;
+
+    if (listContains(_config.variants, "simd")) {
+      CMaskBench<CompositorSIMD> bench(row(), _masks.data(), x0, length);
+      r.variant = "simd";
+      timeKernel(_config, _timer, r, bench);
+    }
+
+    if (listContains(_config.variants, "scalar")) {
+      CMaskBench<CompositorScalar> bench(row(), _masks.data(), x0, length);
+      r.variant = "scalar";
+      timeKernel(_config, _timer, r, bench);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // [VMask]
+  // --------------------------------------------------------------------------
+
+  template<bool NonZero>
+  void runVMask(uint32_t dist, uint32_t length, uint32_t offset) noexcept {
+    const char* kernel = NonZero ? "vmask_nz" : "vmask_eo";
+    const char* distName = cellDistributions[dist];
+
+    size_t x0 = kGuardPixels + offset;
+    size_t x1 = x0 + length;
+    size_t cellStride = (x1 + kGuardPixels + 3) & ~size_t(3);
+    size_t rowCount = std::max<size_t>(std::min(kSamplePixels / length, kSampleCells / cellStride), 1);
+
+    Cell* source = _cellSource.data();
+    std::memset(source, 0, rowCount * cellStride * sizeof(Cell));
+    for (size_t i = 0; i < rowCount; i++)
+      generateCells(source + i * cellStride, x0, x1, dist, _rnd);
+
+    // Cross-check - pixels, the resulting cover, and cells (which are reset)
+    // must be the same.
+    for (size_t i = 0; i < std::min<size_t>(rowCount, 8); i++) {
+      randomizeRows();
+      std::memcpy(_cells.data(), source + i * cellStride, cellStride * sizeof(Cell));
+      std::memcpy(_cellsRef.data(), source + i * cellStride, cellStride * sizeof(Cell));
+
+      CompositorSIMD simd(0xFF3060C0u);
+      CompositorScalar scalar(0xFF3060C0u);
+
+      int cover0 = 0;
+      int cover1 = 0;
+      size_t r0 = simd.template vmask<NonZero>(row(), x0, x1, _cells.data(), cover0);
+      size_t r1 = scalar.template vmask<NonZero>(rowRef(), x0, x1, _cellsRef.data(), cover1);
+
+      size_t index;
+      char what[128];
+
+      if (r0 != r1 || cover0 != cover1) {
+        snprintf(what, sizeof(what), "returned %u (cover=%d), scalar returned %u (cover=%d)",
+          unsigned(r0), cover0, unsigned(r1), cover1);
+        reportMismatch(kernel, distName, length, offset, what);
+        break;
+      }
+
+      if (!compareRows(index)) {
+        snprintf(what, sizeof(what), "pixel %d is %08X, scalar %08X",
+          int(index) - int(x0), row()[index], rowRef()[index]);
+        reportMismatch(kernel, distName, length, offset, what);
+        break;
+      }
+
+      if (std::memcmp(_cells.data(), _cellsRef.data(), cellStride * sizeof(Cell)) != 0) {
+        reportMismatch(kernel, distName, length, offset, "cells differ after compositing");
+        break;
+      }
+    }
+
+    // The same rows in the SoA layout, `vmaskSoA()` of both compositors must
+    // match `vmask()` of `CompositorScalar`.
+    Cell* sourceSoA = _cellSourceSoA.data();
+    for (size_t i = 0; i < rowCount; i++) {
+      const Cell* src = source + i * cellStride;
+      Cell* row = sourceSoA + i * cellStride;
+      for (size_t x = 0; x < cellStride; x++) {
+        CellLayoutSoA::covers(row)[x] = src[x].cover;
+        CellLayoutSoA::areas(row, cellStride)[x] = src[x].area;
+      }
+    }
+
+    for (size_t i = 0; i < std::min<size_t>(rowCount, 8); i++) {
+      for (uint32_t variant = 0; variant < 2; variant++) {
+        randomizeRows();
+        std::memcpy(_cells.data(), sourceSoA + i * cellStride, cellStride * sizeof(Cell));
+        std::memcpy(_cellsRef.data(), source + i * cellStride, cellStride * sizeof(Cell));
+
+        Cell* cells = _cells.data();
+        int* covers = CellLayoutSoA::covers(cells);
+        int* areas = CellLayoutSoA::areas(cells, cellStride);
+
+        CompositorSIMD simd(0xFF3060C0u);
+        CompositorScalar scalar(0xFF3060C0u);
+
+        int cover0 = 0;
+        int cover1 = 0;
+        size_t r0 = variant == 0 ? simd.template vmaskSoA<NonZero>(row(), x0, x1, covers, areas, cover0)
+                                 : scalar.template vmaskSoA<NonZero>(row(), x0, x1, covers, areas, cover0);
+        size_t r1 = scalar.template vmask<NonZero>(rowRef(), x0, x1, _cellsRef.data(), cover1);
+
+        const char* variantName = variant == 0 ? "simd_soa" : "scalar_soa";
+        size_t index;
+        char what[128];
+
+        if (r0 != r1 || cover0 != cover1) {
+          snprintf(what, sizeof(what), "%s returned %u (cover=%d), scalar returned %u (cover=%d)",
+            variantName, unsigned(r0), cover0, unsigned(r1), cover1);
+          reportMismatch(kernel, distName, length, offset, what);
+          break;
+        }
+
+        if (!compareRows(index)) {
+          snprintf(what, sizeof(what), "%s pixel %d is %08X, scalar %08X",
+            variantName, int(index) - int(x0), row()[index], rowRef()[index]);
+          reportMismatch(kernel, distName, length, offset, what);
+          break;
+        }
+
+        bool cellsMatch = true;
+        for (size_t x = 0; x < cellStride; x++)
+          cellsMatch &= covers[x] == _cellsRef.data()[x].cover && areas[x] == _cellsRef.data()[x].area;
+
+        if (!cellsMatch) {
+          snprintf(what, sizeof(what), "%s cells differ after compositing", variantName);
+          reportMismatch(kernel, distName, length, offset, what);
+          break;
+        }
+      }
+    }
+
+    if (_config.checkOnly)
+      return;
+
+    KernelResult r;
+    r.kernel = kernel;
+    r.distribution = distName;
+    r.length = length;
+    r.offset = offset;
+
+    if (listContains(_config.variants, "simd")) {
+      VMaskBench<CompositorSIMD, NonZero> bench(row(), _cells.data(), source, cellStride, x0, length);
+      r.variant = "simd";
+      timeKernel(_config, _timer, r, bench);
+    }
+
+    if (listContains(_config.variants, "scalar")) {
+      VMaskBench<CompositorScalar, NonZero> bench(row(), _cells.data(), source, cellStride, x0, length);
+      r.variant = "scalar";
+      timeKernel(_config, _timer, r, bench);
+    }
+
+    if (listContains(_config.variants, "simd_soa")) {
+      VMaskSoABench<CompositorSIMD, NonZero> bench(row(), _cells.data(), sourceSoA, cellStride, x0, length);
+      r.variant = "simd_soa";
+      timeKernel(_config, _timer, r, bench);
+    }
+
+    if (listContains(_config.variants, "scalar_soa")) {
+      VMaskSoABench<CompositorScalar, NonZero> bench(row(), _cells.data(), sourceSoA, cellStride, x0, length);
+      r.variant = "scalar_soa";
+      timeKernel(_config, _timer, r, bench);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // [BitFill]
+  // --------------------------------------------------------------------------
+
+  void runBitFill(uint32_t length, uint32_t offset) noexcept {
+    IntUtils::BitWord* bits = _bits.data();
+    IntUtils::BitWord* bitsRef = _bitsRef.data();
+    size_t nWords = IntUtils::nBitWordsForNBits(size_t(offset) + length + IntUtils::kBitWordBits);
+
+    // Cross-check - bits outside of the filled range must be preserved.
+    for (uint32_t i = 0; i < 4; i++) {
+      for (size_t w = 0; w < nWords; w++)
+        bits[w] = bitsRef[w] = (IntUtils::BitWord(_rnd.nextUInt32()) << (IntUtils::kBitWordBits - 32)) ^ IntUtils::BitWord(_rnd.nextUInt32());
+
+      IntUtils::bitVectorFill(bits, offset, length);
+      for (size_t bit = offset; bit < size_t(offset) + length; bit++)
+        IntUtils::bitVectorSetBit(bitsRef, bit, true);
+
+      if (std::memcmp(bits, bitsRef, nWords * sizeof(IntUtils::BitWord)) != 0) {
+        reportMismatch("bitfill", "fill", length, offset, "bits differ from bit by bit reference");
+        break;
+      }
+    }
+
+    if (_config.checkOnly)
+      return;
+
+    KernelResult r;
+    r.kernel = "bitfill";
+    r.variant = "";
+    r.distribution = "fill";
+    r.length = length;
+    r.offset = offset;
+
+    BitFillBench bench(bits, offset, length);
+    timeKernel(_config, _timer, r, bench);
+  }
+
+  // --------------------------------------------------------------------------
+  // [BitScan]
+  // --------------------------------------------------------------------------
+
+  void runBitScan(uint32_t dist, uint32_t length) noexcept {
+    const char* distName = bitDistributions[dist];
+    IntUtils::BitWord* bits = _bits.data();
+
+    generateBits(bits, length, dist, _rnd);
+    size_t nWords = IntUtils::nBitWordsForNBits(length);
+
+    if (bitScanFlip(bits, nWords) != bitScanReference(bits, nWords))
+      reportMismatch("bitscan", distName, length, 0, "runs differ from bit by bit reference");
+
+    if (_config.checkOnly)
+      return;
+
+    KernelResult r;
+    r.kernel = "bitscan";
+    r.variant = "";
+    r.distribution = distName;
+    r.length = length;
+    r.offset = 0;
+
+    BitScanBench bench(bits, length);
+    timeKernel(_config, _timer, r, bench);
+  }
+
+  // --------------------------------------------------------------------------
+  // [Rasterizers]
+  // --------------------------------------------------------------------------
+
+  // Renders shapes that touch borders of the canvas by all rasterizers and
+  // compares them to `RasterizerA1`, it's not timed (see `checkShape()`). The
+  // same is done with shapes at the right end of a 65000 pixels wide canvas
+  // (L1 packs `x` into 16 bits), where a float has only 8 fractional bits.
+  // `BandRenderer` splits lines at band edges, which changes pixels crossed by
+  // a clipped edge by up to 2 levels (see `TileRasterizer::_addClippedLine()`),
+  // so it can be off by `kTileTolerance` where two clipped edges meet.
+  void runRasterizers() noexcept {
+    static constexpr int kWidth = 200;
+    static constexpr int kHeight = 130;
+    static constexpr int kWideWidth = 65000;
+    static constexpr int kWideHeight = 24;
+    static constexpr uint32_t kTileTolerance = 4;
+
+    double w = kWidth;
+    double h = kHeight;
+
+    // Edges that end at `x == 0` and `x == w` and rows at both borders.
+    const Point shape0[] = { { 0, 0 }, { w - 0.01, 0 }, { w - 0.01, h - 0.01 }, { 0, h - 0.01 }, { w / 2, h / 2 }, { 0, 0 } };
+    const Point shape1[] = { { w, 0 }, { w, h }, { 0.3, h * 0.7 }, { w * 0.4, h * 0.1 }, { w, 0 } };
+    const Point shape2[] = { { 0, h / 3 }, { w * 0.6, 0 }, { w, h * 0.6 }, { w * 0.3, h }, { 0, h / 3 } };
+
+    const Point* shapes[] = { shape0, shape1, shape2 };
+    const size_t counts[] = { ARRAY_SIZE(shape0), ARRAY_SIZE(shape1), ARRAY_SIZE(shape2) };
+
+    double ww = kWideWidth;
+    double wh = kWideHeight;
+
+    // Steep edges near `x == ww`, and an edge that crosses the whole canvas.
+    const Point wide0[] = { { ww - 40.3, 0.2 }, { ww, wh * 0.45 }, { ww - 3.1, wh }, { ww - 70.55, wh * 0.6 }, { ww - 40.3, 0.2 } };
+    const Point wide1[] = { { 0.5, 1.25 }, { ww, wh - 0.5 }, { ww - 17.8, wh }, { ww - 25.15, 0.6 }, { 0.5, 1.25 } };
+
+    const Point* wideShapes[] = { wide0, wide1 };
+    const size_t wideCounts[] = { ARRAY_SIZE(wide0), ARRAY_SIZE(wide1) };
+
+    // Heights of bands rendered by `BandRenderer`, which splits lines at band
+    // edges and is compared with `kTileTolerance`.
+    const int bandHeights[] = { 7, 64 };
+
+    Image ref;
+    Image img;
+
+    if (!ref.create(kWidth, kHeight) || !img.create(kWidth, kHeight)) {
+      reportMismatch("rasterizers", "border", 0, 0, "out of memory");
+      return;
+    }
+
+    for (uint32_t fillMode = 0; fillMode < 2; fillMode++) {
+      for (size_t shapeIndex = 0; shapeIndex < ARRAY_SIZE(shapes); shapeIndex++) {
+        checkShape(ref, img, "border", fillMode, uint32_t(shapeIndex), shapes[shapeIndex], counts[shapeIndex]);
+
+        for (size_t i = 0; i < ARRAY_SIZE(bandHeights); i++) {
+          for (uint32_t options = 0; options <= Rasterizer::kOptionSIMD; options += Rasterizer::kOptionSIMD) {
+            ImageBandWriter writer;
+            if (!renderBands(writer, kWidth, kHeight, bandHeights[i], options, fillMode, shapes[shapeIndex], counts[shapeIndex])) {
+              reportMismatch("bands", "border", uint32_t(shapeIndex), fillMode, "out of memory");
+              continue;
+            }
+
+            uint32_t diff = maxChannelDiff(ref, writer.image());
+            if (diff > kTileTolerance) {
+              char what[128];
+              std::snprintf(what, ARRAY_SIZE(what), "bands of %d rows differ from A1 by %u (tolerance %u)", bandHeights[i], diff, kTileTolerance);
+              reportMismatch(options ? "bands-simd" : "bands", "border", uint32_t(shapeIndex), fillMode, what);
+            }
+          }
+        }
+      }
+
+      for (uint32_t options = 0; options <= Rasterizer::kOptionSIMD; options += Rasterizer::kOptionSIMD)
+        checkRetained(ref, img, fillMode, options);
+
+      for (size_t shapeIndex = 0; shapeIndex < ARRAY_SIZE(shapes); shapeIndex++)
+        checkViews(img, fillMode, uint32_t(shapeIndex), shapes[shapeIndex], counts[shapeIndex]);
+    }
+
+    Image wideRef;
+    Image wideImg;
+
+    if (!wideRef.create(kWideWidth, kWideHeight) || !wideImg.create(kWideWidth, kWideHeight)) {
+      reportMismatch("rasterizers", "wide", 0, 0, "out of memory");
+      return;
+    }
+
+    for (uint32_t fillMode = 0; fillMode < 2; fillMode++)
+      for (size_t shapeIndex = 0; shapeIndex < ARRAY_SIZE(wideShapes); shapeIndex++)
+        checkShape(wideRef, wideImg, "wide", fillMode, uint32_t(shapeIndex), wideShapes[shapeIndex], wideCounts[shapeIndex]);
+  }
+
+  // Renders `poly` by `RasterizerA1` into `ref` and by all other rasterizers
+  // into `img`, cell rasterizers must be exact.
+  //
+  // `RasterizerF1` is compared with `kF1Tolerance`, which is the sum of:
+  //
+  //   - 1 level of converting the coverage `c` to a mask, A1 truncates
+  //     `256 * c` (clamped to 255) and F1 rounds `255 * c`, which can't be
+  //     more than 1 apart,
+  //   - 2 levels of A1 truncating vertices to 24.8 fixed point, which moves an
+  //     edge by less than 1/256 of a pixel in both directions and the area it
+  //     covers in a pixel by less than 2/256 (the edge is at most sqrt(2) long
+  //     within the pixel and moves less than sqrt(2)/256 perpendicular to it),
+  //   - 1 level of A1 rounding cover and area of the cells a line crosses to
+  //     integers, and of F1 rounding floats, which F1 keeps independent of the
+  //     canvas width by computing each line relative to its top-left pixel.
+  //
+  // A pixel crossed by a single edge stays within 3 levels, 4 are reached near
+  // vertices, where the rounded cells of two edges end up in the same pixel.
+  void checkShape(Image& ref, Image& img, const char* distName, uint32_t fillMode, uint32_t shapeIndex, const Point* poly, size_t count) noexcept {
+    static constexpr uint32_t kF1Tolerance = 4;
+
+    renderShape(ref, Rasterizer::kIdA1, 0, fillMode, poly, count);
+
+    for (uint32_t id = Rasterizer::kIdA2; id < Rasterizer::kIdCount; id++) {
+      for (uint32_t options = 0; options <= Rasterizer::kOptionSIMD; options += Rasterizer::kOptionSIMD) {
+        const char* name = renderShape(img, id, options, fillMode, poly, count);
+        if (!name) {
+          reportMismatch("rasterizers", distName, shapeIndex, fillMode, "out of memory");
+          continue;
+        }
+
+        // `RasterizerAuto` can select `RasterizerF1`.
+        uint32_t tolerance = id == Rasterizer::kIdF1 || id == Rasterizer::kIdAuto ? kF1Tolerance : 0u;
+        uint32_t diff = maxChannelDiff(ref, img);
+
+        if (diff > tolerance) {
+          char what[128];
+          std::snprintf(what, ARRAY_SIZE(what), "differs from A1 by %u (tolerance %u)", diff, tolerance);
+          reportMismatch(name, distName, shapeIndex, fillMode, what);
+        }
+      }
+    }
+  }
+
+  // Renders `poly` by all rasterizers into a view of a rectangle of a larger
+  // image and into a vertically flipped (negative stride) view, both must be
+  // the same as rendering into `img`. The rectangle starts at an unaligned
+  // pixel and its width is not a multiple of 32 pixels (one bit of A3x32), so
+  // pixels around it are guards of compositing past the end of a row.
+  void checkViews(Image& img, uint32_t fillMode, uint32_t shapeIndex, const Point* poly, size_t count) noexcept {
+    static constexpr int kPadding = 3;
+    static constexpr uint32_t kGuard = 0xFF00FF00u;
+
+    int w = img.width();
+    int h = img.height();
+
+    Image parent;
+    Image flipped;
+    Image rectView;
+    Image flippedView;
+
+    if (!parent.create(w + kPadding * 2, h + kPadding * 2) || !flipped.create(w, h)) {
+      reportMismatch("rasterizers", "views", shapeIndex, fillMode, "out of memory");
+      return;
+    }
+
+    rectView.attachRect(parent, kPadding, kPadding, w, h);
+    flippedView.attachFlipped(flipped);
+
+    for (uint32_t id = 0; id < Rasterizer::kIdCount; id++) {
+      for (uint32_t options = 0; options <= Rasterizer::kOptionSIMD; options += Rasterizer::kOptionSIMD) {
+        parent.fillAll(kGuard);
+
+        if (!renderShape(rectView, id, options, fillMode, poly, count) ||
+            !renderShape(flippedView, id, options, fillMode, poly, count)) {
+          reportMismatch("rasterizers", "views", shapeIndex, fillMode, "out of memory");
+          return;
+        }
+
+        const char* name = renderShape(img, id, options, fillMode, poly, count);
+        if (!name) {
+          reportMismatch("rasterizers", "views", shapeIndex, fillMode, "out of memory");
+          return;
+        }
+
+        char what[128];
+        uint32_t rectDiff = maxChannelDiff(img, rectView);
+        uint32_t flippedDiff = maxChannelDiff(img, flippedView);
+
+        if (rectDiff != 0) {
+          std::snprintf(what, ARRAY_SIZE(what), "sub-rectangle view differs by %u", rectDiff);
+          reportMismatch(name, "views", shapeIndex, fillMode, what);
+        }
+
+        if (flippedDiff != 0) {
+          std::snprintf(what, ARRAY_SIZE(what), "flipped view differs by %u", flippedDiff);
+          reportMismatch(name, "views", shapeIndex, fillMode, what);
+        }
+
+        for (int y = 0; y < parent.height(); y++) {
+          const uint32_t* line = reinterpret_cast<const uint32_t*>(parent.data() + intptr_t(y) * parent.stride());
+          bool inside = y >= kPadding && y < kPadding + h;
+
+          for (int x = 0; x < parent.width(); x++) {
+            if (inside && x >= kPadding && x < kPadding + w)
+              continue;
+
+            if (line[x] != kGuard) {
+              std::snprintf(what, ARRAY_SIZE(what), "wrote pixel [%d, %d] outside of the view", x - kPadding, y - kPadding);
+              reportMismatch(name, "views", shapeIndex, fillMode, what);
+              y = parent.height();
+              break;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Animates a closed polygon by `RetainedRasterizer::updatePoly()`, which
+  // only rasterizes edges that moved, and compares each frame with the same
+  // polygon rendered from scratch by `RasterizerA1`. Removing the polygon at
+  // the end must leave all cells zero.
+  void checkRetained(Image& ref, Image& img, uint32_t fillMode, uint32_t options) noexcept {
+    static constexpr uint32_t kFrameCount = 40;
+    static constexpr size_t kPointCount = 12;
+
+    int w = img.width();
+    int h = img.height();
+    const char* name = options ? "retained-simd" : "retained";
+
+    Image background;
+    RetainedRasterizer ras(img, options);
+
+    if (!background.create(w, h) || !ras.init(w, h)) {
+      reportMismatch(name, "frames", 0, fillMode, "out of memory");
+      return;
+    }
+
+    background.fillAll(0xFF000000u);
+    img.fillAll(0xFF000000u);
+    ras.setBackground(&background);
+    ras.setFillMode(fillMode);
+
+    Point poly[kPointCount + 1];
+    Point prev[kPointCount + 1];
+
+    for (size_t i = 0; i < kPointCount; i++) {
+      poly[i].x = _rnd.nextDouble() * double(w);
+      poly[i].y = _rnd.nextDouble() * double(h);
+    }
+    poly[kPointCount] = poly[0];
+    ras.addPoly(poly, kPointCount + 1);
+
+    for (uint32_t frame = 0; frame < kFrameCount; frame++) {
+      // Move one to three vertices, some of them onto the borders.
+      if (frame != 0) {
+        std::memcpy(prev, poly, sizeof(poly));
+
+        uint32_t moves = 1 + _rnd.nextUInt32() % 3;
+        for (uint32_t m = 0; m < moves; m++) {
+          size_t i = _rnd.nextUInt32() % kPointCount;
+          poly[i].x = (frame % 5 == 0) ? double(w) : _rnd.nextDouble() * double(w);
+          poly[i].y = (frame % 7 == 0) ? 0.0 : _rnd.nextDouble() * double(h);
+        }
+        poly[kPointCount] = poly[0];
+        ras.updatePoly(prev, poly, kPointCount + 1);
+      }
+
+      ras.render(0xFFFFFFFFu);
+      renderShape(ref, Rasterizer::kIdA1, 0, fillMode, poly, kPointCount + 1);
+
+      uint32_t diff = maxChannelDiff(ref, img);
+      if (diff != 0) {
+        char what[128];
+        std::snprintf(what, ARRAY_SIZE(what), "frame %u differs from A1 by %u", frame, diff);
+        reportMismatch(name, "frames", frame, fillMode, what);
+        return;
+      }
+    }
+
+    ras.removePoly(poly, kPointCount + 1);
+    for (size_t i = 0; i < size_t(h) * ras._cellStride; i++) {
+      if (ras._cells[i].cover != 0 || ras._cells[i].area != 0) {
+        reportMismatch(name, "frames", kFrameCount, fillMode, "cells not zero after removePoly()");
+        return;
+      }
+    }
+  }
+
+  // Renders `poly` on black by `BandRenderer` into the image of `writer`.
+  static bool renderBands(ImageBandWriter& writer, int w, int h, int bandHeight, uint32_t options, uint32_t fillMode, const Point* poly, size_t count) noexcept {
+    Scene scene;
+    if (!scene.addPoly(poly, count) || !scene.fill(0xFFFFFFFFu, fillMode))
+      return false;
+
+    BandRenderer renderer(w, h, options, bandHeight);
+    return renderer.render(scene, 0xFF000000u, writer);
+  }
+
+  // Renders `poly` to `dst` cleared to black, returns the name of the
+  // rasterizer or null if it couldn't be created. A second `render()` in a
+  // different color follows, which must not composite anything, as nothing
+  // was added after the first one.
+  const char* renderShape(Image& dst, uint32_t id, uint32_t options, uint32_t fillMode, const Point* poly, size_t count) noexcept {
+    static char name[32];
+
+    Rasterizer* ras = Rasterizer::newById(dst, id, options);
+    if (!ras)
+      return nullptr;
+
+    dst.fillAll(0xFF000000u);
+    ras->setFillMode(fillMode);
+    ras->addPoly(poly, count);
+    ras->render(0xFFFFFFFFu);
+    ras->render(0xFF0000FFu);
+
+    std::snprintf(name, ARRAY_SIZE(name), "%s", ras->name());
+    delete ras;
+    return name;
+  }
+
+  static uint32_t maxChannelDiff(const Image& a, const Image& b) noexcept {
+    uint32_t diff = 0;
+    for (int y = 0; y < a.height(); y++) {
+      const uint8_t* aLine = a.data() + intptr_t(y) * a.stride();
+      const uint8_t* bLine = b.data() + intptr_t(y) * b.stride();
+
+      for (size_t i = 0; i < size_t(a.width()) * 4; i++)
+        diff = std::max<uint32_t>(diff, uint32_t(std::abs(int(aLine[i]) - int(bLine[i]))));
+    }
+    return diff;
+  }
+
+  KernelConfig& _config;
+  KernelTimer& _timer;
+  Random _rnd;
+  uint32_t _mismatches;
+
+  Image _row;
+  Image _rowRef;
+  PodArray<Cell> _cells;
+  PodArray<Cell> _cellsRef;
+  PodArray<Cell> _cellSource;
+  PodArray<Cell> _cellSourceSoA;
+  PodArray<IntUtils::BitWord> _bits;
+  PodArray<IntUtils::BitWord> _bitsRef;
+  PodArray<uint32_t> _masks;
+};
+
+// ============================================================================
+// [Main]
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+  CmdLine cmd(argc, argv);
+
+  if (cmd.hasKey("--help")) {
+    printf("Usage: kernel_bench [options]\n");
+    printf("\n");
+    printf("Benchmarks compositor and bit-vector kernels in isolation and cross-checks\n");
+    printf("them against their scalar (bit by bit) references. Times are per pixel, or\n");
+    printf("per bit of bit-vector kernels.\n");
+    printf("\n");
+    printf("  --kernels=K,...        Kernels to run - cmask, vmask_nz, vmask_eo, bitfill,\n");
+    printf("                         bitscan, and rasterizers (only cross-checks shapes\n");
+    printf("                         touching borders against RasterizerA1) (default all)\n");
+    printf("  --distributions=D,...  Mask distributions of cmask (opaque, alpha, mixed),\n");
+    printf("                         cells of vmask (solid, sparse, dense), or bits of\n");
+    printf("                         bitscan (sparse, runs, dense)\n");
+    printf("  --variants=V,...       Compositors to time - simd, scalar, and simd_soa,\n");
+    printf("                         scalar_soa (vmask of cells stored as cover and\n");
+    printf("                         area planes, see CellLayoutSoA)\n");
+    printf("  --lengths=N,...        Span lengths (default 1,3,4,7,16,64,256,1024,4096)\n");
+    printf("  --offsets=N,...        Alignment offsets in pixels (default 0,1,2,3), or\n");
+    printf("                         in bits of bitfill (default 0,1,13,%u)\n", unsigned(IntUtils::kBitWordBits - 1));
+    printf("  --repeats=N            Number of timed samples (default 15)\n");
+    printf("  --format=F             Output format - text or csv\n");
+    printf("  --counters             Core cycles from performance counters instead of\n");
+    printf("                         the time-stamp counter (Linux, if permitted)\n");
+    printf("  --check                Only cross-check kernels, exits with 1 on mismatch\n");
+    return 0;
+  }
+
+  KernelConfig config;
+  config.repeats = cmd.hasKey("--repeats") ? uint32_t(std::max(cmd.intValueOf("--repeats"), 1)) : 15u;
+  config.format = KernelConfig::kFormatText;
+  config.checkOnly = cmd.hasKey("--check");
+  config.counters = nullptr;
+  config.kernels = cmd.hasKey("--kernels") ? cmd.valueOf("--kernels") : nullptr;
+  config.distributions = cmd.hasKey("--distributions") ? cmd.valueOf("--distributions") : nullptr;
+  config.variants = cmd.hasKey("--variants") ? cmd.valueOf("--variants") : nullptr;
+  config.lengths = cmd.hasKey("--lengths") ? cmd.valueOf("--lengths") : nullptr;
+  config.offsets = cmd.hasKey("--offsets") ? cmd.valueOf("--offsets") : nullptr;
+
+  if (cmd.hasKey("--format")) {
+    const char* format = cmd.valueOf("--format");
+    if (strcmp(format, "csv") == 0) {
+      config.format = KernelConfig::kFormatCsv;
+    }
+    else if (strcmp(format, "text") != 0) {
+      printf("Invalid format '%s'\n", format);
+      return 1;
+    }
+  }
+
+  PerfCounters counters;
+  if (cmd.hasKey("--counters")) {
+    if (counters.open() && counters.isAvailable(PerfCounters::kCycles))
+      config.counters = &counters;
+    else
+      fprintf(stderr, "Cycle counter is not available (see /proc/sys/kernel/perf_event_paranoid), using the time-stamp counter\n");
+  }
+
+  uint32_t lengths[kMaxListSize];
+  uint32_t pixelOffsets[kMaxListSize];
+  uint32_t bitOffsets[kMaxListSize];
+
+  size_t lengthCount = parseList(config.lengths, defaultLengths, ARRAY_SIZE(defaultLengths), lengths);
+  size_t pixelOffsetCount = parseList(config.offsets, defaultPixelOffsets, ARRAY_SIZE(defaultPixelOffsets), pixelOffsets);
+  size_t bitOffsetCount = parseList(config.offsets, defaultBitOffsets, ARRAY_SIZE(defaultBitOffsets), bitOffsets);
+
+  // Zero length spans are never composited, pixel offsets are within 16 bytes.
+  size_t maxLength = 1;
+  size_t n = 0;
+  for (size_t i = 0; i < lengthCount; i++)
+    if (lengths[i] != 0)
+      maxLength = std::max<size_t>(maxLength, (lengths[n++] = lengths[i]));
+  lengthCount = n;
+
+  n = 0;
+  for (size_t i = 0; i < pixelOffsetCount; i++)
+    if (pixelOffsets[i] < 4)
+      pixelOffsets[n++] = pixelOffsets[i];
+  pixelOffsetCount = n;
+
+  n = 0;
+  for (size_t i = 0; i < bitOffsetCount; i++)
+    if (bitOffsets[i] < 1024)
+      bitOffsets[n++] = bitOffsets[i];
+  bitOffsetCount = n;
+
+  KernelTimer timer(config.counters);
+  KernelBench bench(config, timer);
+
+  if (!bench.init(maxLength + 1024)) {
+    printf("Failed to allocate buffers\n");
+    return 1;
+  }
+
+  timer.calibrate();
+  if (!config.checkOnly)
+    printResultHeader(config, timer);
+
+  if (listContains(config.kernels, "cmask"))
+    for (uint32_t dist = 0; dist < ARRAY_SIZE(maskDistributions); dist++)
+      if (listContains(config.distributions, maskDistributions[dist]))
+        for (size_t i = 0; i < lengthCount; i++)
+          for (size_t j = 0; j < pixelOffsetCount; j++)
+            bench.runCMask(dist, lengths[i], pixelOffsets[j]);
+
+  if (listContains(config.kernels, "vmask_nz"))
+    for (uint32_t dist = 0; dist < ARRAY_SIZE(cellDistributions); dist++)
+      if (listContains(config.distributions, cellDistributions[dist]))
+        for (size_t i = 0; i < lengthCount; i++)
+          for (size_t j = 0; j < pixelOffsetCount; j++)
+            bench.runVMask<true>(dist, lengths[i], pixelOffsets[j]);
+
+  if (listContains(config.kernels, "vmask_eo"))
+    for (uint32_t dist = 0; dist < ARRAY_SIZE(cellDistributions); dist++)
+      if (listContains(config.distributions, cellDistributions[dist]))
+        for (size_t i = 0; i < lengthCount; i++)
+          for (size_t j = 0; j < pixelOffsetCount; j++)
+            bench.runVMask<false>(dist, lengths[i], pixelOffsets[j]);
+
+  if (listContains(config.kernels, "bitfill"))
+    for (size_t i = 0; i < lengthCount; i++)
+      for (size_t j = 0; j < bitOffsetCount; j++)
+        bench.runBitFill(lengths[i], bitOffsets[j]);
+
+  if (listContains(config.kernels, "bitscan"))
+    for (uint32_t dist = 0; dist < ARRAY_SIZE(bitDistributions); dist++)
+      if (listContains(config.distributions, bitDistributions[dist]))
+        for (size_t i = 0; i < lengthCount; i++)
+          bench.runBitScan(dist, lengths[i]);
+
+  if (listContains(config.kernels, "rasterizers"))
+    bench.runRasterizers();
+
+  if (bench.mismatches()) {
+    fprintf(stderr, "%u mismatch(es) found\n", bench.mismatches());
+    return 1;
+  }
+
+  if (config.checkOnly)
+    printf("All kernels match their references\n");
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include "./perfcounters.h"
+
+#if defined(__linux__)
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <string.h>
+  #include <unistd.h>
+#endif
+
+// ============================================================================
+// [PerfCounters - Construction / Destruction]
+// ============================================================================
+
+PerfCounters::PerfCounters() noexcept
+  : _availableCount(0) {
+  for (uint32_t i = 0; i < kCounterCount; i++)
+    _fd[i] = -1;
+}
+
+PerfCounters::~PerfCounters() noexcept {
+  close();
+}
+
+const char* PerfCounters::nameOf(uint32_t counter) noexcept {
+  static const char* const names[kCounterCount] = {
+    "cycles",
+    "instructions",
+    "l1d_misses",
+    "llc_misses",
+    "branch_misses"
+  };
+  return counter < kCounterCount ? names[counter] : "unknown";
+}
+
+// ============================================================================
+// [PerfCounters - Open / Close]
+// ============================================================================
+
+bool PerfCounters::open() noexcept {
+  close();
+
+#if defined(__linux__)
+  static const uint32_t types[kCounterCount] = {
+    PERF_TYPE_HARDWARE,
+    PERF_TYPE_HARDWARE,
+    PERF_TYPE_HW_CACHE,
+    PERF_TYPE_HARDWARE,
+    PERF_TYPE_HARDWARE
+  };
+
+  static const uint64_t configs[kCounterCount] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  for (uint32_t i = 0; i < kCounterCount; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // The calling thread on any CPU.
+    int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    if (fd >= 0) {
+      _fd[i] = fd;
+      _availableCount++;
+    }
+  }
+#endif
+
+  return _availableCount != 0;
+}
+
+void PerfCounters::close() noexcept {
+  for (uint32_t i = 0; i < kCounterCount; i++) {
+#if defined(__linux__)
+    if (_fd[i] >= 0)
+      ::close(_fd[i]);
+#endif
+    _fd[i] = -1;
+  }
+  _availableCount = 0;
+}
+
+// ============================================================================
+// [PerfCounters - Start / Stop]
+// ============================================================================
+
+void PerfCounters::start() noexcept {
+#if defined(__linux__)
+  for (uint32_t i = 0; i < kCounterCount; i++) {
+    if (_fd[i] >= 0) {
+      ioctl(_fd[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+}
+
+void PerfCounters::stop(Values& out) noexcept {
+  out.reset();
+
+#if defined(__linux__)
+  for (uint32_t i = 0; i < kCounterCount; i++)
+    if (_fd[i] >= 0)
+      ioctl(_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+  for (uint32_t i = 0; i < kCounterCount; i++) {
+    if (_fd[i] < 0)
+      continue;
+
+    // Value, time enabled, and time running.
+    uint64_t data[3];
+    if (read(_fd[i], data, sizeof(data)) != ssize_t(sizeof(data)) || data[2] == 0)
+      continue;
+
+    if (data[2] < data[1])
+      out.value[i] = uint64_t(double(data[0]) * double(data[1]) / double(data[2]));
+    else
+      out.value[i] = data[0];
+  }
+#else
+  (void)out;
+#endif
+}
@@ -0,0 +1,64 @@
+#ifndef _PERFCOUNTERS_H
+#define _PERFCOUNTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// [PerfCounters]
+// ============================================================================
+
+//! Hardware performance counters of the calling thread (Linux `perf_event_open`).
+//!
+//! Each counter is opened separately, so a counter not supported by the CPU
+//! (or a virtual machine) doesn't disable the others. If `perf_event_open` is
+//! not available at all (other platforms, `perf_event_paranoid` too high) all
+//! counters are simply unavailable and `start()` / `stop()` do nothing.
+//! Counts are scaled by the time the counter was actually running in case the
+//! kernel multiplexes them.
+class PerfCounters {
+public:
+  enum Counter : uint32_t {
+    kCycles = 0,
+    kInstructions,
+    kL1DMisses,
+    kLLCMisses,
+    kBranchMisses,
+    kCounterCount
+  };
+
+  struct Values {
+    inline void reset() noexcept {
+      for (uint32_t i = 0; i < kCounterCount; i++)
+        value[i] = 0;
+    }
+
+    uint64_t value[kCounterCount];
+  };
+
+  PerfCounters() noexcept;
+  ~PerfCounters() noexcept;
+
+  PerfCounters(const PerfCounters& other) noexcept = delete;
+  PerfCounters& operator=(const PerfCounters& other) noexcept = delete;
+
+  //! Opens all counters, returns `true` if at least one is available.
+  bool open() noexcept;
+  void close() noexcept;
+
+  inline bool isAvailable(uint32_t counter) const noexcept { return _fd[counter] >= 0; }
+  inline bool isAnyAvailable() const noexcept { return _availableCount != 0; }
+
+  static const char* nameOf(uint32_t counter) noexcept;
+
+  //! Resets and starts all counters.
+  void start() noexcept;
+  //! Stops all counters and stores their (scaled) values to `out`, values of
+  //! unavailable counters are zero.
+  void stop(Values& out) noexcept;
+
+  int _fd[kCounterCount];
+  uint32_t _availableCount;
+};
+
+#endif // _PERFCOUNTERS_H
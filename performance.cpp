@@ -1,5 +1,8 @@
 #include "./performance.h"
 
+#include <algorithm>
+#include <cmath>
+
 #if defined(_WIN32)
   #include <atomic>
 #elif defined(__APPLE__)
@@ -84,3 +87,92 @@ uint32_t Performance::getTickCount() noexcept {
   return 0;
 }
 #endif
+
+// ============================================================================
+// [Performance - GetTimeNs]
+// ============================================================================
+
+#if defined(_WIN32)
+
+uint64_t Performance::getTimeNs() noexcept {
+  static volatile double _nsPerTick(0);
+
+  LARGE_INTEGER now, qpf;
+  double nsPerTick = _nsPerTick;
+
+  if (nsPerTick == 0) {
+    if (!::QueryPerformanceFrequency(&qpf))
+      return uint64_t(::GetTickCount()) * 1000000;
+    nsPerTick = 1e9 / double(qpf.QuadPart);
+    _nsPerTick = nsPerTick;
+  }
+
+  ::QueryPerformanceCounter(&now);
+  return uint64_t(double(now.QuadPart) * nsPerTick);
+}
+
+#elif defined(__APPLE__)
+
+uint64_t Performance::getTimeNs() noexcept {
+  static mach_timebase_info_data_t _machTime;
+  if (_machTime.denom == 0 && mach_timebase_info(&_machTime) != KERN_SUCCESS)
+    return 0;
+
+  return mach_absolute_time() * _machTime.numer / _machTime.denom;
+}
+
+#elif defined(_POSIX_MONOTONIC_CLOCK) && _POSIX_MONOTONIC_CLOCK >= 0
+
+uint64_t Performance::getTimeNs() noexcept {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+    return 0;
+
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+#else
+
+uint64_t Performance::getTimeNs() noexcept {
+  return uint64_t(getTickCount()) * 1000000;
+}
+#endif
+
+// ============================================================================
+// [PerformanceStats - Compute]
+// ============================================================================
+
+void PerformanceStats::compute(uint64_t* samples, size_t count) noexcept {
+  reset();
+  if (!count)
+    return;
+
+  std::sort(samples, samples + count);
+
+  double sum = 0.0;
+  for (size_t i = 0; i < count; i++)
+    sum += double(samples[i]);
+
+  double mean = sum / double(count);
+  double variance = 0.0;
+
+  // Sample variance, a single sample has none.
+  if (count > 1) {
+    for (size_t i = 0; i < count; i++) {
+      double d = double(samples[i]) - mean;
+      variance += d * d;
+    }
+    variance /= double(count - 1);
+  }
+
+  // Nearest-rank percentile.
+  size_t p95Index = (count * 95 + 99) / 100 - 1;
+
+  this->count = count;
+  this->min = double(samples[0]);
+  this->median = (count & 1) ? double(samples[count / 2])
+                             : (double(samples[count / 2 - 1]) + double(samples[count / 2])) * 0.5;
+  this->p95 = double(samples[p95Index]);
+  this->mean = mean;
+  this->stddev = std::sqrt(variance);
+}
@@ -24,9 +24,35 @@ public:
   }
 
   static uint32_t getTickCount() noexcept;
+  //! Returns a monotonic time in nanoseconds.
+  static uint64_t getTimeNs() noexcept;
 
   uint32_t tick;
   uint32_t best;
 };
 
+//! Statistics of timing samples (in nanoseconds).
+struct PerformanceStats {
+  inline PerformanceStats() noexcept { reset(); }
+
+  inline void reset() noexcept {
+    count = 0;
+    min = 0.0;
+    median = 0.0;
+    p95 = 0.0;
+    mean = 0.0;
+    stddev = 0.0;
+  }
+
+  //! Computes statistics of `count` samples, which are sorted in place.
+  void compute(uint64_t* samples, size_t count) noexcept;
+
+  size_t count;
+  double min;
+  double median;
+  double p95;
+  double mean;
+  double stddev;
+};
+
 #endif // _PERFORMANCE_H
@@ -5,6 +5,13 @@
 // [RasterizerA1]
 // ============================================================================
 
+//! Rasterizer that composites all rows of the canvas cell by cell.
+//!
+//! Rows are cleared lazily by epochs - a row whose `_rowEpochs[y]` differs
+//! from `_epoch` has stale cells and is treated as empty. The first
+//! `_mergeCell()` to a stale row zeroes it, `render()` skips stale rows and
+//! doesn't reset cells, and `clear()` just starts a new epoch, so neither
+//! `clear()` nor `init()` touches the `W*H` cells.
 class RasterizerA1 : public CellRasterizer {
 public:
   RasterizerA1(Image& dst, uint32_t options) noexcept;
@@ -16,16 +23,30 @@ public:
   virtual void clear() noexcept override;
   virtual bool addPoly(const Point* poly, size_t count) noexcept override;
 
-  template<typename Fixed>
-  void _addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept;
+  //! Starts a new epoch, which makes all rows stale.
+  inline void _nextEpoch() noexcept {
+    // Rows can keep any epoch but the current one, so when the counter wraps
+    // around they are reset to zero, which is never used as an epoch.
+    if (++_epoch == 0) {
+      std::memset(_rowEpochs, 0, size_t(_height) * sizeof(uint32_t));
+      _epoch = 1;
+    }
+  }
 
   inline void _mergeCell(int x, int y, int cover, int area) noexcept{
-    assert(x >= 0 && x < _width);
+    assert(x >= 0 && x <= _width);
     assert(y >= 0 && y < _height);
 
-    Cell& cell = _cells[y * _cellStride + x];
+    Cell* row = _cells + y * _cellStride;
+    if (_rowEpochs[y] != _epoch) {
+      _rowEpochs[y] = _epoch;
+      std::memset(row, 0, _cellStride * sizeof(Cell));
+    }
+
+    Cell& cell = row[x];
     cell.cover += cover;
     cell.area  += area;
+    RAS_STATS_ADD(_stats, cellsMerged, 1);
   }
 
   template<class Compositor, bool NonZero>
@@ -35,6 +56,10 @@ public:
 
   size_t _cellStride;
   Cell* _cells;
+
+  //! Current epoch and the epoch in which each row was last zeroed.
+  uint32_t _epoch;
+  uint32_t* _rowEpochs;
 };
 
 // ============================================================================
@@ -44,7 +69,9 @@ public:
 RasterizerA1::RasterizerA1(Image& dst, uint32_t options) noexcept
   : CellRasterizer(dst, options),
     _cellStride(0),
-    _cells(nullptr) {
+    _cells(nullptr),
+    _epoch(1),
+    _rowEpochs(nullptr) {
   std::snprintf(_name, ARRAY_SIZE(_name), "A1");
   addOptionsToName();
   init(dst.width(), dst.height());
@@ -60,8 +87,8 @@ RasterizerA1::~RasterizerA1() noexcept {
 
 bool RasterizerA1::init(int w, int h) noexcept {
   if (_width != w || _height != h) {
-    if (_cells)
-      std::free(_cells);
+    if (_cells) std::free(_cells);
+    if (_rowEpochs) std::free(_rowEpochs);
 
     _width = w;
     _height = h;
@@ -69,25 +96,32 @@ bool RasterizerA1::init(int w, int h) noexcept {
     if (w == 0 || h == 0) {
       _cellStride = 0;
       _cells = nullptr;
+      _rowEpochs = nullptr;
       return true;
     }
 
     _cellStride = w + 1;
+    _cells = static_cast<Cell*>(std::malloc(h * _cellStride * sizeof(Cell)));
+    _rowEpochs = static_cast<uint32_t*>(std::malloc(h * sizeof(uint32_t)));
 
-    size_t size = h * _cellStride * sizeof(Cell);
-    _cells = static_cast<Cell*>(std::malloc(size));
+    if (!_cells || !_rowEpochs) {
+      if (_cells) std::free(_cells);
+      if (_rowEpochs) std::free(_rowEpochs);
 
-    if (!_cells) {
       _width = 0;
       _height = 0;
       _cellStride = 0;
+      _cells = nullptr;
+      _rowEpochs = nullptr;
       return false;
     }
-  }
 
-  if (_cells) {
-    size_t size = h * _cellStride * sizeof(Cell);
-    std::memset(_cells, 0, size);
+    // Cells are not initialized, all rows are stale until merged into.
+    std::memset(_rowEpochs, 0, h * sizeof(uint32_t));
+    _epoch = 1;
+  }
+  else if (_cells) {
+    _nextEpoch();
   }
 
   return true;
@@ -96,18 +130,21 @@ bool RasterizerA1::init(int w, int h) noexcept {
 void RasterizerA1::reset() noexcept {
   if (isInitialized()) {
     std::free(_cells);
+    std::free(_rowEpochs);
+
     _width = 0;
     _height = 0;
     _cellStride = 0;
     _cells = nullptr;
+    _rowEpochs = nullptr;
   }
 }
 
 void RasterizerA1::clear() noexcept {
-  if (isInitialized()) {
-    size_t size = _height * _cellStride * sizeof(Cell);
-    std::memset(_cells, 0, size);
-  }
+  PhaseScope scope(*this, PhaseTimers::kPhaseClear);
+
+  if (isInitialized())
+    _nextEpoch();
 }
 
 // ============================================================================
@@ -115,6 +152,8 @@ void RasterizerA1::clear() noexcept {
 // ============================================================================
 
 bool RasterizerA1::addPoly(const Point* poly, size_t count) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseAddPoly);
+
   assert(isInitialized());
 
   if (count < 2)
@@ -128,7 +167,7 @@ bool RasterizerA1::addPoly(const Point* poly, size_t count) noexcept {
     int y1 = static_cast<int>(poly[i].y * 256);
 
     if (x0 != x1 || y0 != y1)
-      _addLine<int64_t>(x0, y0, x1, y1);
+      addLineT<RasterizerA1, int64_t>(*this, x0, y0, x1, y1);
 
     x0 = x1;
     y0 = y1;
@@ -137,320 +176,6 @@ bool RasterizerA1::addPoly(const Point* poly, size_t count) noexcept {
   return true;
 }
 
-template<typename Fixed>
-void RasterizerA1::_addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept {
-  Fixed dx = x1 - x0;
-  Fixed dy = y1 - y0;
-
-  if (dy == Fixed(0))
-    return;
-
-  int cover = int(dy);
-  int area;
-
-  if (dx < 0) dx = -dx;
-  if (dy < 0) dy = -dy;
-
-  int yInc = 1;
-  int coverSign = 1;
-
-  // Fix RIGHT-TO-LEFT direction:
-  //   - swap coordinates,
-  //   - invert cover-sign.
-  if (x0 > x1) {
-    std::swap(x0, x1);
-    std::swap(y0, y1);
-    coverSign = -coverSign;
-  }
-
-  // Fix BOTTOM-TO-TOP direction:
-  //   - invert fractional parts of y0 and y1,
-  //   - invert cover-sign.
-  if (y0 > y1) {
-    y0 ^= kA8Mask;
-    y0 += int(y0 & kA8Mask) == kA8Mask ? 1 - kA8Scale * 2 : 1;
-    y1  = y0 + dy;
-
-    yInc = -1;
-    coverSign = -coverSign;
-  }
-
-  // Extract the raster and fractional coordinates.
-  int ex0 = int(x0 >> kA8Shift);
-  int fx0 = int(x0 & kA8Mask);
-
-  int ey0 = int(y0 >> kA8Shift);
-  int fy0 = int(y0 & kA8Mask);
-
-  int ex1 = int(x1 >> kA8Shift);
-  int fy1 = int(y1 & kA8Mask);
-
-  // NOTE: Variable `i` is just a loop counter. We need to make sure to handle
-  // the start and end points of the line, which use the same loop body, but
-  // require special handling.
-  //
-  //   - `i` - How many Y iterations to do now.
-  //   - `j` - How many Y iterations to do next.
-  int i = 1;
-  int j = int(y1 >> kA8Shift) - ey0;
-
-  // Single-Cell.
-  if ((j | ((fx0 + int(dx)) > 256)) == 0) {
-    _mergeCell(ex0, ey0, cover, (fx0 * 2 + int(dx)) * cover);
-    return;
-  }
-
-  uint32_t ey1 = ey0 + (j + (fy1 != 0)) * yInc;
-
-  // Strictly horizontal line (always one cell per scanline).
-  if (dx == 0) {
-    if (j > 0)
-      cover = (kA8Scale - fy0) * coverSign;
-
-    fy0  = coverSign << kA8Shift;
-    fy1 *= coverSign;
-    fx0 *= 2;
-
-    for (;;) {
-      area = fx0 * cover;
-      do {
-        _mergeCell(ex0, ey0, cover, area);
-        ey0 += yInc;
-      } while (--i);
-
-      if (ey0 == ey1)
-        break;
-
-      cover = fy1;
-      i = j;
-      j = 1;
-
-      if (i <= 1)
-        continue;
-
-      cover = fy0;
-      i--;
-    }
-
-    return;
-  }
-
-  Fixed xErr = -dy / 2, xBase, xLift, xRem, xDlt = dx;
-  Fixed yErr = -dx / 2, yBase, yLift, yRem, yDlt = dy;
-
-  xBase = dx * kA8Scale;
-  xLift = xBase / dy;
-  xRem  = xBase % dy;
-
-  yBase = dy * kA8Scale;
-  yLift = yBase / dx;
-  yRem  = yBase % dx;
-
-  if (j != 0) {
-    Fixed p = Fixed(kA8Scale - fy0) * dx;
-    xDlt  = p / dy;
-    xErr += p % dy;
-    fy1 = kA8Scale;
-  }
-
-  if (ex0 != ex1) {
-    Fixed p = Fixed(kA8Scale - fx0) * dy;
-    yDlt = p / dx;
-    yErr += p % dx;
-  }
-
-  // Vertical direction -> One/Two cells per scanline.
-  if (dy >= dx) {
-    int yAcc = int(y0) + int(yDlt);
-
-    goto VertSkip;
-    for (;;) {
-      do {
-        xDlt = xLift;
-        xErr += xRem;
-        if (xErr >= 0) { xErr -= dy; xDlt++; }
-
-VertSkip:
-        area = fx0;
-        fx0 += int(xDlt);
-
-        if (fx0 <= 256) {
-          cover = (fy1 - fy0) * coverSign;
-          area  = (area + fx0) * cover;
-          _mergeCell(ex0, ey0, cover, area);
-
-          if (fx0 == 256) {
-            ex0++;
-            fx0 = 0;
-            goto VertAdvance;
-          }
-        }
-        else {
-          yAcc &= 0xFF;
-          fx0  &= kA8Mask;
-
-          cover = (yAcc - fy0) * coverSign;
-          area  = (area + kA8Scale) * cover;
-
-          _mergeCell(ex0, ey0, cover, area);
-          ex0++;
-
-          cover = (fy1 - yAcc) * coverSign;
-          area  = fx0 * cover;
-          _mergeCell(ex0, ey0, cover, area);
-
-VertAdvance:
-          yAcc += int(yLift);
-          yErr += yRem;
-          if (yErr >= 0) { yErr -= dx; yAcc++; }
-        }
-
-        ey0 += yInc;
-      } while (--i);
-
-      if (ey0 == ey1)
-        break;
-
-      i = j;
-      j = 1;
-
-      if (i > 1) {
-        fy0 = 0;
-        fy1 = kA8Scale;
-        i--;
-      }
-      else {
-        fy0 = 0;
-        fy1 = int(y1 & kA8Mask);
-
-        xDlt = x1 - (ex0 << 8) - fx0;
-        goto VertSkip;
-      }
-    }
-
-    return;
-  }
-  // Horizontal direction -> Two or more cells per scanline.
-  else {
-    int fx1;
-    int coverAcc = fy0;
-
-    cover = int(yDlt);
-    coverAcc += cover;
-
-    if (j != 0)
-      fy1 = kA8Scale;
-
-    if (fx0 + int(xDlt) > 256)
-      goto HorzInside;
-
-    x0 += xDlt;
-
-    cover = (fy1 - fy0) * coverSign;
-    area = (fx0 * 2 + int(xDlt)) * cover;
-
-HorzSingle:
-    _mergeCell(ex0, ey0, cover, area);
-
-    ey0 += yInc;
-    if (ey0 == ey1)
-      return;
-
-    if (fx0 + int(xDlt) == 256) {
-      coverAcc += int(yLift);
-      yErr += yRem;
-      if (yErr >= 0) { yErr -= dx; coverAcc++; }
-    }
-
-    if (--i == 0)
-      goto HorzAfter;
-
-    for (;;) {
-      do {
-        xDlt = xLift;
-        xErr += xRem;
-        if (xErr >= 0) { xErr -= dy; xDlt++; }
-
-        ex0 = int(x0 >> kA8Shift);
-        fx0 = int(x0 & kA8Mask);
-
-HorzSkip:
-        coverAcc -= 256;
-        cover = coverAcc;
-        assert(cover >= 0 && cover <= 256);
-
-HorzInside:
-        x0 += xDlt;
-
-        ex1 = int(x0 >> kA8Shift);
-        fx1 = int(x0 & kA8Mask);
-        assert(ex0 != ex1);
-
-        if (fx1 == 0)
-          fx1 = kA8Scale;
-        else
-          ex1++;
-
-        area = (fx0 + kA8Scale) * cover;
-        while (ex0 != ex1 - 1) {
-          _mergeCell(ex0, ey0, cover * coverSign, area * coverSign);
-
-          cover = int(yLift);
-          yErr += yRem;
-          if (yErr >= 0) { yErr -= dx; cover++; }
-
-          coverAcc += cover;
-          area  = kA8Scale * cover;
-
-          ex0++;
-        }
-
-        cover += fy1 - coverAcc;
-        area   = fx1 * cover;
-        _mergeCell(ex0, ey0, cover * coverSign, area * coverSign);
-
-        if (fx1 == kA8Scale) {
-          coverAcc += int(yLift);
-          yErr += yRem;
-          if (yErr >= 0) { yErr -= dx; coverAcc++; }
-        }
-
-        ey0 += yInc;
-      } while (--i);
-
-      if (ey0 == ey1)
-        break;
-
-HorzAfter:
-      i = j;
-      j = 1;
-
-      if (i > 1) {
-        fy1 = kA8Scale;
-        i--;
-      }
-      else {
-        fy1 = int(y1 & kA8Mask);
-        xDlt = x1 - x0;
-
-        ex0 = int(x0 >> kA8Shift);
-        fx0 = int(x0 & kA8Mask);
-
-        if (fx0 + int(xDlt) <= 256) {
-          cover = fy1 * coverSign;
-          area = (fx0 * 2 + int(xDlt)) * cover;
-          goto HorzSingle;
-        }
-        else {
-          goto HorzSkip;
-        }
-      }
-    }
-
-    return;
-  }
-}
-
 // ============================================================================
 // [RasterizerA1 - Render]
 // ============================================================================
@@ -464,17 +189,34 @@ inline void RasterizerA1::_renderImpl(uint32_t argb32) noexcept {
   intptr_t stride = _dst->stride();
 
   Compositor compositor(argb32);
+  size_t rowsRendered = 0;
+
   for (int y = 0; y < h; y++, dstLine += stride) {
+    // A1 has no bounds, every row merged into in this epoch is composited as
+    // a whole, cells are left as is and become stale by `_nextEpoch()`.
+    if (_rowEpochs[y] != _epoch)
+      continue;
+
     uint32_t* dstPix = reinterpret_cast<uint32_t*>(dstLine);
     Cell* cell = &_cells[y * _cellStride];
 
     size_t x0 = 0;
     int cover = 0;
-    compositor.template vmask<NonZero>(dstPix, x0, w, cell, cover);
+    compositor.template vmask<NonZero, false>(dstPix, x0, w, cell, cover);
+    rowsRendered++;
   }
+
+  _nextEpoch();
+
+  RAS_STATS_ADD(_stats, renderCalls, 1);
+  RAS_STATS_ADD(_stats, vmaskSpans, rowsRendered);
+  RAS_STATS_ADD(_stats, vmaskPixels, uint64_t(w) * rowsRendered);
+  RAS_STATS_ADD(_stats, rowsRendered, rowsRendered);
+  RAS_STATS_ADD(_stats, rowsSkipped, size_t(h) - rowsRendered);
 }
 
 void RasterizerA1::render(uint32_t argb32) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseRender);
   doRender(*this, argb32);
 }
 
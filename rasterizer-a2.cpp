@@ -5,6 +5,9 @@
 // [RasterizerA2]
 // ============================================================================
 
+//! Rasterizer that keeps `[xMin..xMax]` bounds of each scanline, cells of a
+//! row are stored as given by `CellLayout` (`CellLayoutAoS` or `CellLayoutSoA`).
+template<class CellLayout>
 class RasterizerA2 : public CellRasterizer {
 public:
   RasterizerA2(Image& dst, uint32_t options) noexcept;
@@ -20,12 +23,18 @@ public:
   void _addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept;
 
   inline void _mergeCell(int x, int y, int cover, int area) noexcept{
-    assert(x >= 0 && x < _width);
+    assert(x >= 0 && x <= _width);
     assert(y >= 0 && y < _height);
 
-    Cell& cell = _cells[y * _cellStride + x];
-    cell.cover += cover;
-    cell.area  += area;
+    CellLayout::merge(_cells + y * _cellStride, _cellStride, size_t(x), cover, area);
+    RAS_STATS_ADD(_stats, cellsMerged, 1);
+  }
+
+  //! Called by `CellBlock::spillTo()` for each non-zero cell of `_block`.
+  inline void _spillCell(int x, int y, int cover, int area) noexcept {
+    _xBounds[y].union_(x, x);
+    _yBounds.union_(y, y);
+    _mergeCell(x, y, cover, area);
   }
 
   template<class Compositor, bool NonZero>
@@ -37,13 +46,15 @@ public:
   Cell* _cells;
   Bounds* _xBounds;
   Bounds _yBounds;
+  CellBlock _block;
 };
 
 // ============================================================================
 // [RasterizerA2 - Construction / Destruction]
 // ============================================================================
 
-RasterizerA2::RasterizerA2(Image& dst, uint32_t options) noexcept
+template<class CellLayout>
+RasterizerA2<CellLayout>::RasterizerA2(Image& dst, uint32_t options) noexcept
   : CellRasterizer(dst, options),
     _cellStride(0),
     _cells(nullptr),
@@ -54,7 +65,8 @@ RasterizerA2::RasterizerA2(Image& dst, uint32_t options) noexcept
   init(dst.width(), dst.height());
 }
 
-RasterizerA2::~RasterizerA2() noexcept {
+template<class CellLayout>
+RasterizerA2<CellLayout>::~RasterizerA2() noexcept {
   reset();
 }
 
@@ -62,7 +74,8 @@ RasterizerA2::~RasterizerA2() noexcept {
 // [RasterizerA2 - Basics]
 // ============================================================================
 
-bool RasterizerA2::init(int w, int h) noexcept {
+template<class CellLayout>
+bool RasterizerA2<CellLayout>::init(int w, int h) noexcept {
   if (_width != w || _height != h) {
     if (_cells) std::free(_cells);
     if (_xBounds) std::free(_xBounds);
@@ -109,7 +122,8 @@ bool RasterizerA2::init(int w, int h) noexcept {
   return true;
 }
 
-void RasterizerA2::reset() noexcept {
+template<class CellLayout>
+void RasterizerA2<CellLayout>::reset() noexcept {
   if (isInitialized()) {
     std::free(_cells);
     std::free(_xBounds);
@@ -123,7 +137,13 @@ void RasterizerA2::reset() noexcept {
   }
 }
 
-void RasterizerA2::clear() noexcept {
+template<class CellLayout>
+void RasterizerA2<CellLayout>::clear() noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseClear);
+
+  if (_block.active())
+    _block.clear();
+
   if (isInitialized()) {
     size_t y0 = size_t(_yBounds.start);
     size_t y1 = size_t(_yBounds.end);
@@ -134,8 +154,7 @@ void RasterizerA2::clear() noexcept {
       int x1 = _xBounds[y0].end;
 
       if (x0 <= x1) {
-        size_t width = size_t(x1 - x0 + 1);
-        std::memset(cellPtr + x0, 0, width * sizeof(Cell));
+        CellLayout::clear(cellPtr, _cellStride, size_t(x0), size_t(x1) + 1);
         _xBounds[y0].reset();
       }
 
@@ -151,12 +170,22 @@ void RasterizerA2::clear() noexcept {
 // [RasterizerA2 - AddPoly / AddLine]
 // ============================================================================
 
-bool RasterizerA2::addPoly(const Point* poly, size_t count) noexcept {
+template<class CellLayout>
+bool RasterizerA2<CellLayout>::addPoly(const Point* poly, size_t count) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseAddPoly);
+
   assert(isInitialized());
 
   if (count < 2)
     return true;
 
+  // Tiny shapes go to `_block` while all cells fit in it.
+  if (_block.addPoly(poly, count, _yBounds.empty()))
+    return true;
+
+  if (_block.active())
+    _block.spillTo(*this);
+
   int x0 = static_cast<int>(poly[0].x * 256);
   int y0 = static_cast<int>(poly[0].y * 256);
 
@@ -174,8 +203,9 @@ bool RasterizerA2::addPoly(const Point* poly, size_t count) noexcept {
   return true;
 }
 
+template<class CellLayout>
 template<typename Fixed>
-void RasterizerA2::_addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept {
+void RasterizerA2<CellLayout>::_addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept {
   Fixed dx = x1 - x0;
   Fixed dy = y1 - y0;
 
@@ -239,11 +269,13 @@ void RasterizerA2::_addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept {
     return;
   }
 
+  // `ey1` is the first row past the line in the direction of `yInc`, which
+  // can be `-1` or `_height`, and must not get to `_yBounds`.
   uint32_t ey1 = ey0 + (j + (fy1 != 0)) * yInc;
-  if (ey0 <= ey1)
-    _yBounds.union_(ey0, ey1);
+  if (int(ey0) <= int(ey1))
+    _yBounds.union_(ey0, std::min<int>(int(ey1), _height - 1));
   else
-    _yBounds.union_(ey1, ey0);
+    _yBounds.union_(std::max<int>(int(ey1), 0), ey0);
 
   // Strictly horizontal line (always one cell per scanline).
   if (dx == 0) {
@@ -507,8 +539,17 @@ HorzAfter:
 // [RasterizerA2 - Render]
 // ============================================================================
 
+template<class CellLayout>
 template<class Compositor, bool NonZero>
-inline void RasterizerA2::_renderImpl(uint32_t argb32) noexcept {
+inline void RasterizerA2<CellLayout>::_renderImpl(uint32_t argb32) noexcept {
+  // Cells are either all in `_block` or all in the rasterizer.
+  if (_block.active()) {
+    Compositor compositor(argb32);
+    _block.template render<Compositor, NonZero>(compositor, *_dst, _stats);
+    RAS_STATS_ADD(_stats, renderCalls, 1);
+    return;
+  }
+
   size_t y0 = size_t(_yBounds.start);
   size_t y1 = size_t(_yBounds.end);
 
@@ -516,6 +557,8 @@ inline void RasterizerA2::_renderImpl(uint32_t argb32) noexcept {
   uint8_t* dstLine = _dst->data() + y0 * stride;
 
   Compositor compositor(argb32);
+  size_t rowsRendered = 0;
+
   while (y0 <= y1) {
     uint32_t* dstPix = reinterpret_cast<uint32_t*>(dstLine);
     Cell* cell = &_cells[y0 * _cellStride];
@@ -526,17 +569,26 @@ inline void RasterizerA2::_renderImpl(uint32_t argb32) noexcept {
       _xBounds[y0].reset();
 
       int cover = 0;
-      compositor.template vmask<NonZero>(dstPix, size_t(x0), size_t(x1), cell, cover);
+      CellLayout::template vmask<NonZero>(compositor, dstPix, size_t(x0), size_t(x1), cell, _cellStride, cover);
+
+      RAS_STATS_ADD(_stats, vmaskSpans, 1);
+      RAS_STATS_ADD(_stats, vmaskPixels, x1 - x0);
+      rowsRendered++;
     }
 
     y0++;
     dstLine += stride;
   }
 
+  RAS_STATS_ADD(_stats, renderCalls, 1);
+  RAS_STATS_ADD(_stats, rowsRendered, rowsRendered);
+  RAS_STATS_ADD(_stats, rowsSkipped, size_t(_height) - rowsRendered);
   _yBounds.reset();
 }
 
-void RasterizerA2::render(uint32_t argb32) noexcept {
+template<class CellLayout>
+void RasterizerA2<CellLayout>::render(uint32_t argb32) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseRender);
   doRender(*this, argb32);
 }
 
@@ -545,5 +597,8 @@ void RasterizerA2::render(uint32_t argb32) noexcept {
 // ============================================================================
 
 Rasterizer* newRasterizerA2(Image& dst, uint32_t options) noexcept {
-  return new(std::nothrow) RasterizerA2(dst, options);
+  if (options & Rasterizer::kOptionSoA)
+    return new(std::nothrow) RasterizerA2<CellLayoutSoA>(dst, options);
+  else
+    return new(std::nothrow) RasterizerA2<CellLayoutAoS>(dst, options);
 }
@@ -7,7 +7,17 @@
 // [RasterizerA3]
 // ============================================================================
 
-template<uint32_t N>
+//! Rasterizer that marks cells by a bit-array per scanline, each bit covering
+//! `N` pixels.
+//!
+//! BitWords of each scanline are summarized by a second bit-array, which has
+//! a bit for each BitWord that may be non-zero. Render and clear iterate the
+//! summary and only visit occupied BitWords, so small shapes on very wide
+//! canvases don't pay for scanning empty BitWords of the whole scanline.
+//!
+//! Cells of a row are stored as given by `CellLayout` (`CellLayoutAoS` or
+//! `CellLayoutSoA`).
+template<uint32_t N, class CellLayout>
 class RasterizerA3 : public CellRasterizer {
 public:
   typedef IntUtils::BitWord BitWord;
@@ -27,13 +37,36 @@ public:
   template<typename Fixed>
   void _addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept;
 
+  //! Sets bit `bitIndex` of scanline `y` and marks its BitWord in the summary.
+  inline void _setBit(int y, size_t bitIndex) noexcept {
+    size_t wordIndex = bitIndex / kBitWordBits;
+    _bits[y * _bitStride + wordIndex] |= BitWord(1) << (bitIndex % kBitWordBits);
+    _summary[y * _summaryStride + wordIndex / kBitWordBits] |= BitWord(1) << (wordIndex % kBitWordBits);
+  }
+
+  //! Sets `count` bits of scanline `y` starting at `bitIndex` and marks their
+  //! BitWords in the summary.
+  inline void _fillBits(int y, size_t bitIndex, size_t count) noexcept {
+    size_t w0 = bitIndex / kBitWordBits;
+    size_t w1 = (bitIndex + count - 1) / kBitWordBits;
+
+    IntUtils::bitVectorFill(&_bits[y * _bitStride], bitIndex, count);
+    IntUtils::bitVectorFill(&_summary[y * _summaryStride], w0, w1 - w0 + 1);
+  }
+
   inline void _mergeCell(int x, int y, int cover, int area) noexcept{
-    assert(x >= 0 && x < _width);
+    assert(x >= 0 && x <= _width);
     assert(y >= 0 && y < _height);
 
-    Cell& cell = _cells[y * _cellStride + x];
-    cell.cover += cover;
-    cell.area  += area;
+    CellLayout::merge(_cells + y * _cellStride, _cellStride, size_t(x), cover, area);
+    RAS_STATS_ADD(_stats, cellsMerged, 1);
+  }
+
+  //! Called by `CellBlock::spillTo()` for each non-zero cell of `_block`.
+  inline void _spillCell(int x, int y, int cover, int area) noexcept {
+    _yBounds.union_(y, y);
+    _setBit(y, size_t(x) / kPixelsPerOneBit);
+    _mergeCell(x, y, cover, area);
   }
 
   template<class Compositor, bool NonZero>
@@ -46,20 +79,28 @@ public:
   size_t _bitStride;
   BitWord* _bits;
 
+  //! Bit per BitWord of `_bits`, set if the BitWord may be non-zero.
+  size_t _summaryStride;
+  BitWord* _summary;
+
   size_t _cellStride;
   Cell* _cells;
+
+  CellBlock _block;
 };
 
 // ============================================================================
 // [RasterizerA3 - Construction / Destruction]
 // ============================================================================
 
-template<uint32_t N>
-RasterizerA3<N>::RasterizerA3(Image& dst, uint32_t options) noexcept
+template<uint32_t N, class CellLayout>
+RasterizerA3<N, CellLayout>::RasterizerA3(Image& dst, uint32_t options) noexcept
   : CellRasterizer(dst, options),
     _yBounds { 0, 0 },
     _bitStride(0),
     _bits(nullptr),
+    _summaryStride(0),
+    _summary(nullptr),
     _cellStride(0),
     _cells(nullptr) {
   std::snprintf(_name, ARRAY_SIZE(_name), "A3x%u", kPixelsPerOneBit);
@@ -67,8 +108,8 @@ RasterizerA3<N>::RasterizerA3(Image& dst, uint32_t options) noexcept
   init(dst.width(), dst.height());
 }
 
-template<uint32_t N>
-RasterizerA3<N>::~RasterizerA3() noexcept {
+template<uint32_t N, class CellLayout>
+RasterizerA3<N, CellLayout>::~RasterizerA3() noexcept {
   reset();
 }
 
@@ -76,10 +117,11 @@ RasterizerA3<N>::~RasterizerA3() noexcept {
 // [RasterizerA3 - Basics]
 // ============================================================================
 
-template<uint32_t N>
-bool RasterizerA3<N>::init(int w, int h) noexcept {
+template<uint32_t N, class CellLayout>
+bool RasterizerA3<N, CellLayout>::init(int w, int h) noexcept {
   if (_width != w || _height != h) {
     if (_bits) std::free(_bits);
+    if (_summary) std::free(_summary);
     if (_cells) std::free(_cells);
 
     _width = w;
@@ -89,6 +131,8 @@ bool RasterizerA3<N>::init(int w, int h) noexcept {
       _yBounds.reset();
       _bitStride = 0;
       _bits = nullptr;
+      _summaryStride = 0;
+      _summary = nullptr;
       _cellStride = 0;
       _cells = nullptr;
       return true;
@@ -97,11 +141,15 @@ bool RasterizerA3<N>::init(int w, int h) noexcept {
     _bitStride = IntUtils::nBitWordsForNBits((size_t(w) + 1 + kPixelsPerOneBit - 1) / kPixelsPerOneBit);
     _bits = static_cast<BitWord*>(std::malloc(h * _bitStride * sizeof(BitWord)));
 
+    _summaryStride = IntUtils::nBitWordsForNBits(_bitStride);
+    _summary = static_cast<BitWord*>(std::malloc(h * _summaryStride * sizeof(BitWord)));
+
     _cellStride = w + 1;
     _cells = static_cast<Cell*>(std::malloc(h * _cellStride * sizeof(Cell)));
 
-    if (!_bits || !_cells) {
+    if (!_bits || !_summary || !_cells) {
       if (_bits) std::free(_bits);
+      if (_summary) std::free(_summary);
       if (_cells) std::free(_cells);
 
       _width = 0;
@@ -110,6 +158,8 @@ bool RasterizerA3<N>::init(int w, int h) noexcept {
 
       _bitStride = 0;
       _bits = nullptr;
+      _summaryStride = 0;
+      _summary = nullptr;
       _cellStride = 0;
       _cells = nullptr;
 
@@ -120,6 +170,7 @@ bool RasterizerA3<N>::init(int w, int h) noexcept {
 
     std::memset(_cells, 0, _height * _cellStride * sizeof(Cell));
     std::memset(_bits, 0, _height * _bitStride * sizeof(BitWord));
+    std::memset(_summary, 0, _height * _summaryStride * sizeof(BitWord));
   }
   else {
     // This is much faster, will only clear the affected area.
@@ -129,10 +180,11 @@ bool RasterizerA3<N>::init(int w, int h) noexcept {
   return true;
 }
 
-template<uint32_t N>
-void RasterizerA3<N>::reset() noexcept {
+template<uint32_t N, class CellLayout>
+void RasterizerA3<N, CellLayout>::reset() noexcept {
   if (isInitialized()) {
     std::free(_bits);
+    std::free(_summary);
     std::free(_cells);
 
     _width = 0;
@@ -142,31 +194,45 @@ void RasterizerA3<N>::reset() noexcept {
     _bitStride = 0;
     _bits = nullptr;
 
+    _summaryStride = 0;
+    _summary = nullptr;
+
     _cellStride = 0;
     _cells = nullptr;
   }
 }
 
-template<uint32_t N>
-void RasterizerA3<N>::clear() noexcept {
+template<uint32_t N, class CellLayout>
+void RasterizerA3<N, CellLayout>::clear() noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseClear);
+
+  if (_block.active())
+    _block.clear();
+
   if (isInitialized()) {
     size_t y0 = size_t(_yBounds.start);
     size_t y1 = size_t(_yBounds.end);
 
-    BitWord* bitPtr = _bits + y0 * _bitStride;
+    BitWord* bitLine = _bits + y0 * _bitStride;
+    BitWord* summaryPtr = _summary + y0 * _summaryStride;
     Cell* cellPtr = _cells + y0 * _cellStride;
 
     while (y0 <= y1) {
-      size_t i = size_t(_bitStride);
-      size_t x = 0;
+      for (size_t s = 0; s < _summaryStride; s++, summaryPtr++) {
+        IntUtils::BitWordIterator<BitWord> summaryIt(*summaryPtr);
+        *summaryPtr = 0;
 
-      do {
-        IntUtils::BitWordFlipIterator<BitWord> it(*bitPtr);
-        *bitPtr = 0;
+        while (summaryIt.hasNext()) {
+          size_t wordIndex = s * kBitWordBits + summaryIt.next();
+          BitWord* bitPtr = bitLine + wordIndex;
 
-        if (it.hasNext()) {
+          IntUtils::BitWordFlipIterator<BitWord> it(*bitPtr);
+          *bitPtr = 0;
+
+          size_t x = wordIndex * kPixelsPerBitWord;
           size_t xEnd = std::min<size_t>(_width, x + kPixelsPerBitWord);
-          do {
+
+          while (it.hasNext()) {
             size_t x0 = x + it.nextAndFlip() * kPixelsPerOneBit;
             size_t x1;
 
@@ -175,14 +241,12 @@ void RasterizerA3<N>::clear() noexcept {
             else
               x1 = std::min<size_t>(xEnd, x0 + kPixelsPerOneBit);
 
-            std::memset(cellPtr + x0, 0, (x1 - x0) * sizeof(Cell));
-          } while (it.hasNext());
+            CellLayout::clear(cellPtr, _cellStride, x0, x1);
+          }
         }
+      }
 
-        x += kPixelsPerBitWord;
-        bitPtr++;
-      } while (--i);
-
+      bitLine += _bitStride;
       cellPtr += _cellStride;
       y0++;
     }
@@ -195,13 +259,22 @@ void RasterizerA3<N>::clear() noexcept {
 // [RasterizerA3 - AddPoly / AddLine]
 // ============================================================================
 
-template<uint32_t N>
-bool RasterizerA3<N>::addPoly(const Point* poly, size_t count) noexcept {
+template<uint32_t N, class CellLayout>
+bool RasterizerA3<N, CellLayout>::addPoly(const Point* poly, size_t count) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseAddPoly);
+
   assert(isInitialized());
 
   if (count < 2)
     return true;
 
+  // Tiny shapes go to `_block` while all cells fit in it.
+  if (_block.addPoly(poly, count, _yBounds.empty()))
+    return true;
+
+  if (_block.active())
+    _block.spillTo(*this);
+
   int x0 = static_cast<int>(poly[0].x * 256);
   int y0 = static_cast<int>(poly[0].y * 256);
 
@@ -219,9 +292,9 @@ bool RasterizerA3<N>::addPoly(const Point* poly, size_t count) noexcept {
   return true;
 }
 
-template<uint32_t N>
+template<uint32_t N, class CellLayout>
 template<typename Fixed>
-void RasterizerA3<N>::_addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept {
+void RasterizerA3<N, CellLayout>::_addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept {
   Fixed dx = x1 - x0;
   Fixed dy = y1 - y0;
 
@@ -280,17 +353,19 @@ void RasterizerA3<N>::_addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept
   // Single-Cell.
   if ((j | ((fx0 + int(dx)) > 256)) == 0) {
     _yBounds.union_(ey0, ey0);
-    IntUtils::bitVectorSetBit(&_bits[ey0 * _bitStride], ex0 / kPixelsPerOneBit, true);
+    _setBit(ey0, ex0 / kPixelsPerOneBit);
 
     _mergeCell(ex0, ey0, cover, (fx0 * 2 + int(dx)) * cover);
     return;
   }
 
+  // `ey1` is the first row past the line in the direction of `yInc`, which
+  // can be `-1` or `_height`, and must not get to `_yBounds`.
   uint32_t ey1 = ey0 + (j + (fy1 != 0)) * yInc;
-  if (ey0 <= ey1)
-    _yBounds.union_(ey0, ey1);
+  if (int(ey0) <= int(ey1))
+    _yBounds.union_(ey0, std::min<int>(int(ey1), _height - 1));
   else
-    _yBounds.union_(ey1, ey0);
+    _yBounds.union_(std::max<int>(int(ey1), 0), ey0);
 
   // Strictly horizontal line (always one cell per scanline).
   if (dx == 0) {
@@ -302,13 +377,19 @@ void RasterizerA3<N>::_addLine(Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept
     fx0 *= 2;
 
     size_t bitIndex = ex0 / kPixelsPerOneBit;
-    BitWord* bitBase = _bits + (bitIndex / kBitWordBits);
+    size_t wordIndex = bitIndex / kBitWordBits;
+
+    BitWord* bitBase = _bits + wordIndex;
     BitWord bitMask = BitWord(1) << (bitIndex % kBitWordBits);
 
+    BitWord* summaryBase = _summary + (wordIndex / kBitWordBits);
+    BitWord summaryMask = BitWord(1) << (wordIndex % kBitWordBits);
+
     for (;;) {
       area = fx0 * cover;
       do {
         bitBase[ey0 * _bitStride] |= bitMask;
+        summaryBase[ey0 * _summaryStride] |= summaryMask;
         _mergeCell(ex0, ey0, cover, area);
         ey0 += yInc;
       } while (--i);
@@ -373,7 +454,7 @@ VertSkip:
           cover = (fy1 - fy0) * coverSign;
           area  = (area + fx0) * cover;
 
-          IntUtils::bitVectorSetBit(&_bits[ey0 * _bitStride], ex0 / kPixelsPerOneBit, true);
+          _setBit(ey0, ex0 / kPixelsPerOneBit);
           _mergeCell(ex0, ey0, cover, area);
 
           if (fx0 == 256) {
@@ -389,13 +470,13 @@ VertSkip:
           cover = (yAcc - fy0) * coverSign;
           area  = (area + kA8Scale) * cover;
 
-          IntUtils::bitVectorSetBit(&_bits[ey0 * _bitStride], ex0 / kPixelsPerOneBit, true);
+          _setBit(ey0, ex0 / kPixelsPerOneBit);
           _mergeCell(ex0, ey0, cover, area);
           ex0++;
 
           cover = (fy1 - yAcc) * coverSign;
           area  = fx0 * cover;
-          IntUtils::bitVectorSetBit(&_bits[ey0 * _bitStride], ex0 / kPixelsPerOneBit, true);
+          _setBit(ey0, ex0 / kPixelsPerOneBit);
           _mergeCell(ex0, ey0, cover, area);
 
 VertAdvance:
@@ -449,7 +530,7 @@ VertAdvance:
     area = (fx0 * 2 + int(xDlt)) * cover;
 
 HorzSingle:
-    IntUtils::bitVectorSetBit(&_bits[ey0 * _bitStride], ex0 / kPixelsPerOneBit, true);
+    _setBit(ey0, ex0 / kPixelsPerOneBit);
     _mergeCell(ex0, ey0, cover, area);
 
     ey0 += yInc;
@@ -492,7 +573,7 @@ HorzInside:
           ex1++;
 
         area = (fx0 + kA8Scale) * cover;
-        IntUtils::bitVectorFill(&_bits[ey0 * _bitStride], ex0 / kPixelsPerOneBit, (ex1 / kPixelsPerOneBit) - (ex0 / kPixelsPerOneBit) + 1);
+        _fillBits(ey0, ex0 / kPixelsPerOneBit, (ex1 / kPixelsPerOneBit) - (ex0 / kPixelsPerOneBit) + 1);
 
         while (ex0 != ex1 - 1) {
           _mergeCell(ex0, ey0, cover * coverSign, area * coverSign);
@@ -557,73 +638,110 @@ HorzAfter:
 // [RasterizerA3 - Render]
 // ============================================================================
 
-template<uint32_t N>
+template<uint32_t N, class CellLayout>
 template<class Compositor, bool NonZero>
-inline void RasterizerA3<N>::_renderImpl(uint32_t argb32) noexcept {
+inline void RasterizerA3<N, CellLayout>::_renderImpl(uint32_t argb32) noexcept {
+  // Cells are either all in `_block` or all in the rasterizer.
+  if (_block.active()) {
+    Compositor compositor(argb32);
+    _block.template render<Compositor, NonZero>(compositor, *_dst, _stats);
+    RAS_STATS_ADD(_stats, renderCalls, 1);
+    return;
+  }
+
   uint8_t* dstLine = _dst->data();
   intptr_t dstStride = _dst->stride();
 
   size_t y0 = size_t(_yBounds.start);
   size_t y1 = size_t(_yBounds.end);
 
-  BitWord* bitPtr = _bits + y0 * _bitStride;
+  BitWord* bitLine = _bits + y0 * _bitStride;
+  BitWord* summaryPtr = _summary + y0 * _summaryStride;
   Cell* cellLine = _cells + y0 * _cellStride;
 
   Compositor compositor(argb32);
   dstLine += y0 * dstStride;
 
-  while (y0 <= y1) {
-    size_t nBits = size_t(_bitStride);
+  // Only BitWords marked in the summary are visited, empty BitWords between
+  // them just extend the span composited by `cmask()`.
+  size_t rowsRendered = 0;
 
-    Cell* cell = cellLine;
+  while (y0 <= y1) {
     uint32_t* dstPix = reinterpret_cast<uint32_t*>(dstLine);
 
     int cover = 0;
     size_t x0 = 0;
-    size_t xOffset = 0;
-
-    do {
-      IntUtils::BitWordFlipIterator<BitWord> it(*bitPtr);
-      *bitPtr = 0;
-
-      while (it.hasNext()) {
-        size_t x1 = xOffset + it.nextAndFlip() * kPixelsPerOneBit;
-        if (x0 < x1) {
-          uint32_t mask = CompositeUtils::calcMask<NonZero>(cover);
-          if (mask)
-            compositor.cmask(dstPix, x0, x1, mask);
-          x0 = x1;
-        }
 
-        if (it.hasNext())
-          x1 = xOffset + it.nextAndFlip() * kPixelsPerOneBit;
-        else
-          x1 = std::min<size_t>(_width, xOffset + kPixelsPerBitWord);
+    for (size_t s = 0; s < _summaryStride; s++, summaryPtr++) {
+      IntUtils::BitWordIterator<BitWord> summaryIt(*summaryPtr);
+      *summaryPtr = 0;
 
-        compositor.template vmask<NonZero>(dstPix, x0, x1, cell, cover);
-        x0 = x1;
-      }
+      RAS_STATS_ADD(_stats, bitWordsScanned, 1);
+      RAS_STATS_ADD(_stats, bitWordsNonEmpty, summaryIt.hasNext());
 
-      xOffset += kPixelsPerBitWord;
-      bitPtr++;
-    } while (--nBits);
+      while (summaryIt.hasNext()) {
+        size_t wordIndex = s * kBitWordBits + summaryIt.next();
+        size_t xOffset = wordIndex * kPixelsPerBitWord;
+
+        BitWord* bitPtr = bitLine + wordIndex;
+        IntUtils::BitWordFlipIterator<BitWord> it(*bitPtr);
+        *bitPtr = 0;
+
+        RAS_STATS_ADD(_stats, bitWordsScanned, 1);
+        RAS_STATS_ADD(_stats, bitWordsNonEmpty, it.hasNext());
+
+        // A bit can represent pixels past the end of the scanline, there are no
+        // cells there, so all positions are clamped to `_width`.
+        while (it.hasNext()) {
+          size_t x1 = std::min<size_t>(_width, xOffset + it.nextAndFlip() * kPixelsPerOneBit);
+          if (x0 < x1) {
+            uint32_t mask = CompositeUtils::calcMask<NonZero>(cover);
+            if (mask) {
+              compositor.cmask(dstPix, x0, x1, mask);
+              RAS_STATS_ADD(_stats, cmaskSpans, 1);
+              RAS_STATS_ADD(_stats, cmaskPixels, x1 - x0);
+            }
+            x0 = x1;
+          }
+
+          if (it.hasNext())
+            x1 = std::min<size_t>(_width, xOffset + it.nextAndFlip() * kPixelsPerOneBit);
+          else
+            x1 = std::min<size_t>(_width, xOffset + kPixelsPerBitWord);
+
+          CellLayout::template vmask<NonZero>(compositor, dstPix, x0, x1, cellLine, _cellStride, cover);
+          RAS_STATS_ADD(_stats, vmaskSpans, 1);
+          RAS_STATS_ADD(_stats, vmaskPixels, x1 - x0);
+          x0 = x1;
+        }
+      }
+    }
 
     if (x0 < _width) {
       uint32_t mask = CompositeUtils::calcMask<NonZero>(cover);
-      if (mask)
+      if (mask) {
         compositor.cmask(dstPix, x0, _width, mask);
+        RAS_STATS_ADD(_stats, cmaskSpans, 1);
+        RAS_STATS_ADD(_stats, cmaskPixels, _width - x0);
+      }
     }
 
     dstLine += dstStride;
+    bitLine += _bitStride;
     cellLine += _cellStride;
+    rowsRendered++;
     y0++;
   }
 
+  RAS_STATS_ADD(_stats, renderCalls, 1);
+  RAS_STATS_ADD(_stats, rowsRendered, rowsRendered);
+  RAS_STATS_ADD(_stats, rowsSkipped, size_t(_height) - rowsRendered);
   _yBounds.reset();
 }
 
-template<uint32_t N>
-void RasterizerA3<N>::render(uint32_t argb32) noexcept {
+template<uint32_t N, class CellLayout>
+void RasterizerA3<N, CellLayout>::render(uint32_t argb32) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseRender);
   doRender(*this, argb32);
 }
 
@@ -631,13 +749,21 @@ void RasterizerA3<N>::render(uint32_t argb32) noexcept {
 // [RasterizerA3 - New]
 // ============================================================================
 
-Rasterizer* newRasterizerA3(Image& dst, uint32_t options, uint32_t n) noexcept {
+template<class CellLayout>
+static Rasterizer* newRasterizerA3WithLayout(Image& dst, uint32_t options, uint32_t n) noexcept {
   switch (n) {
-    case 4 : return new(std::nothrow) RasterizerA3<4>(dst, options);
-    case 8 : return new(std::nothrow) RasterizerA3<8>(dst, options);
-    case 16: return new(std::nothrow) RasterizerA3<16>(dst, options);
-    case 32: return new(std::nothrow) RasterizerA3<32>(dst, options);
+    case 4 : return new(std::nothrow) RasterizerA3<4, CellLayout>(dst, options);
+    case 8 : return new(std::nothrow) RasterizerA3<8, CellLayout>(dst, options);
+    case 16: return new(std::nothrow) RasterizerA3<16, CellLayout>(dst, options);
+    case 32: return new(std::nothrow) RasterizerA3<32, CellLayout>(dst, options);
     default:
       return nullptr;
   }
 }
+
+Rasterizer* newRasterizerA3(Image& dst, uint32_t options, uint32_t n) noexcept {
+  if (options & Rasterizer::kOptionSoA)
+    return newRasterizerA3WithLayout<CellLayoutSoA>(dst, options, n);
+  else
+    return newRasterizerA3WithLayout<CellLayoutAoS>(dst, options, n);
+}
@@ -51,7 +51,8 @@ public:
 
 RasterizerAGG::RasterizerAGG(Image& dst, uint32_t options) noexcept
   : Rasterizer(dst, options),
-    _rbuf(reinterpret_cast<unsigned char*>(dst.data()), dst.width(), dst.height(), int(dst.stride())),
+    // AGG expects the lowest address of the buffer if the stride is negative.
+    _rbuf(reinterpret_cast<unsigned char*>(dst.lowestAddress()), dst.width(), dst.height(), int(dst.stride())),
     _pixfmt(_rbuf),
     _baseRenderer(_pixfmt),
     _solidRenderer(_baseRenderer) {
@@ -79,6 +80,8 @@ void RasterizerAGG::clear() noexcept {}
 // ============================================================================
 
 bool RasterizerAGG::addPoly(const Point* poly, size_t count) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseAddPoly);
+
   if (!count)
     return true;
 
@@ -95,6 +98,7 @@ bool RasterizerAGG::addPoly(const Point* poly, size_t count) noexcept {
 // ============================================================================
 
 void RasterizerAGG::render(uint32_t argb32) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseRender);
   _solidRenderer.color(
     agg::rgba8((argb32 >> 16) & 0xFF,
                (argb32 >>  8) & 0xFF,
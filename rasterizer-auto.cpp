@@ -0,0 +1,289 @@
+#include "./rasterizer.h"
+
+// ============================================================================
+// [AutoProfile - Classes]
+// ============================================================================
+
+static inline uint32_t autoLog2Ceil(uint64_t x) noexcept {
+  uint32_t n = 0;
+  while ((uint64_t(1) << n) < x)
+    n++;
+  return n;
+}
+
+uint32_t AutoProfile::canvasClassOf(int w) noexcept {
+  uint32_t n = autoLog2Ceil(uint64_t(std::max(w, 1)));
+  return std::min<uint32_t>(n > 8 ? n - 8 : 0, kCanvasClassCount - 1);
+}
+
+uint32_t AutoProfile::sizeClassOf(int size) noexcept {
+  uint32_t n = autoLog2Ceil(uint64_t(std::max(size, 1)));
+  return std::min<uint32_t>(n > 3 ? n - 3 : 0, kSizeClassCount - 1);
+}
+
+uint32_t AutoProfile::edgeClassOf(size_t edgeCount) noexcept {
+  uint32_t n = autoLog2Ceil(uint64_t(std::max<size_t>(edgeCount, 1)));
+  return std::min<uint32_t>(n > 4 ? (n - 2) / 3 : 0, kEdgeClassCount - 1);
+}
+
+int AutoProfile::canvasOfClass(uint32_t canvasClass) noexcept { return 256 << canvasClass; }
+int AutoProfile::sizeOfClass(uint32_t sizeClass) noexcept { return 8 << sizeClass; }
+uint32_t AutoProfile::edgesOfClass(uint32_t edgeClass) noexcept { return 16u << (edgeClass * 3); }
+
+// ============================================================================
+// [AutoProfile - Default]
+// ============================================================================
+
+AutoProfile& AutoProfile::global() noexcept {
+  static AutoProfile profile = [] {
+    AutoProfile p;
+    p.resetToDefault();
+    return p;
+  }();
+  return profile;
+}
+
+void AutoProfile::resetToDefault() noexcept {
+  // Crossovers measured by `render_bench --calibrate` (SIMD compositors) -
+  // F1 wins for small shapes having few edges as its accumulation buffer is
+  // the smallest, S4 when there are many edges or the canvas is too wide for
+  // the dense cell storage of A2 and A3 to stay in cache, and A3x4 otherwise.
+  for (uint32_t c = 0; c < kCanvasClassCount; c++) {
+    for (uint32_t s = 0; s < kSizeClassCount; s++) {
+      for (uint32_t e = 0; e < kEdgeClassCount; e++) {
+        uint32_t id;
+
+        if (sizeOfClass(s) <= 32)
+          id = e < 2 ? Rasterizer::kIdF1 : canvasOfClass(c) <= 256 ? Rasterizer::kIdA2 : Rasterizer::kIdS4;
+        else if (canvasOfClass(c) > 1024)
+          id = Rasterizer::kIdS4;
+        else
+          id = Rasterizer::kIdA3x4;
+
+        ids[c][s][e] = uint8_t(id);
+      }
+    }
+  }
+}
+
+// ============================================================================
+// [AutoProfile - Load / Save]
+// ============================================================================
+
+bool AutoProfile::load(const char* fileName) noexcept {
+  std::FILE* f = std::fopen(fileName, "rb");
+  if (!f)
+    return false;
+
+  AutoProfile p = *this;
+  char line[256];
+  bool ok = true;
+
+  while (ok && std::fgets(line, sizeof(line), f)) {
+    const char* s = line;
+    while (*s == ' ' || *s == '\t')
+      s++;
+
+    if (*s == '#' || *s == '\r' || *s == '\n' || *s == '\0')
+      continue;
+
+    int canvasW, size;
+    unsigned edgeCount;
+    char name[32];
+
+    if (std::sscanf(s, "%d %d %u %31s", &canvasW, &size, &edgeCount, name) != 4) {
+      ok = false;
+      break;
+    }
+
+    uint32_t id = Rasterizer::idByName(name, strlen(name));
+    if (id >= Rasterizer::kIdAuto || canvasW <= 0 || size <= 0) {
+      ok = false;
+      break;
+    }
+
+    p.ids[canvasClassOf(canvasW)][sizeClassOf(size)][edgeClassOf(edgeCount)] = uint8_t(id);
+  }
+
+  std::fclose(f);
+  if (ok)
+    *this = p;
+  return ok;
+}
+
+bool AutoProfile::save(const char* fileName) const noexcept {
+  std::FILE* f = std::fopen(fileName, "wb");
+  if (!f)
+    return false;
+
+  std::fprintf(f, "# canvas_width shape_size edge_count rasterizer\n");
+  for (uint32_t c = 0; c < kCanvasClassCount; c++)
+    for (uint32_t s = 0; s < kSizeClassCount; s++)
+      for (uint32_t e = 0; e < kEdgeClassCount; e++)
+        std::fprintf(f, "%d %d %u %s\n", canvasOfClass(c), sizeOfClass(s), edgesOfClass(e), Rasterizer::nameOf(ids[c][s][e]));
+
+  return std::fclose(f) == 0;
+}
+
+// ============================================================================
+// [RasterizerAuto]
+// ============================================================================
+
+//! Rasterizer that selects the fastest rasterizer of `AutoProfile` for each
+//! shape.
+//!
+//! Polygons are recorded until `render()`, which classifies the shape by its
+//! bounding box and number of edges and replays it into the selected
+//! rasterizer. Rasterizers are created on first use and render into the same
+//! destination, so only storage of the selected strategies is allocated.
+class RasterizerAuto : public Rasterizer {
+public:
+  struct Contour {
+    size_t pointIndex;
+    size_t pointCount;
+  };
+
+  RasterizerAuto(Image& dst, uint32_t options) noexcept;
+  virtual ~RasterizerAuto() noexcept;
+
+  bool init(int w, int h) noexcept;
+
+  virtual void reset() noexcept override;
+  virtual void clear() noexcept override;
+  virtual bool addPoly(const Point* poly, size_t count) noexcept override;
+  virtual void render(uint32_t argb32) noexcept override;
+
+  Rasterizer* _rasterizerOf(uint32_t id) noexcept;
+
+  AutoProfile _profile;
+  Rasterizer* _rasterizers[kIdAuto];
+
+  PodArray<Point> _points;
+  PodArray<Contour> _contours;
+  double _bounds[4];
+};
+
+// ============================================================================
+// [RasterizerAuto - Construction / Destruction]
+// ============================================================================
+
+RasterizerAuto::RasterizerAuto(Image& dst, uint32_t options) noexcept
+  : Rasterizer(dst, options),
+    _profile(AutoProfile::global()) {
+  std::snprintf(_name, ARRAY_SIZE(_name), "Auto");
+  addOptionsToName();
+
+  for (uint32_t i = 0; i < kIdAuto; i++)
+    _rasterizers[i] = nullptr;
+
+  init(dst.width(), dst.height());
+}
+
+RasterizerAuto::~RasterizerAuto() noexcept {
+  reset();
+}
+
+// ============================================================================
+// [RasterizerAuto - Basics]
+// ============================================================================
+
+bool RasterizerAuto::init(int w, int h) noexcept {
+  _width = w;
+  _height = h;
+
+  clear();
+  return true;
+}
+
+void RasterizerAuto::reset() noexcept {
+  for (uint32_t i = 0; i < kIdAuto; i++) {
+    delete _rasterizers[i];
+    _rasterizers[i] = nullptr;
+  }
+
+  _points.reset();
+  _contours.reset();
+
+  _width = 0;
+  _height = 0;
+}
+
+void RasterizerAuto::clear() noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseClear);
+
+  _points.clear();
+  _contours.clear();
+
+  _bounds[0] = std::numeric_limits<double>::max();
+  _bounds[1] = std::numeric_limits<double>::max();
+  _bounds[2] = std::numeric_limits<double>::lowest();
+  _bounds[3] = std::numeric_limits<double>::lowest();
+}
+
+Rasterizer* RasterizerAuto::_rasterizerOf(uint32_t id) noexcept {
+  if (!_rasterizers[id])
+    _rasterizers[id] = Rasterizer::newById(*_dst, id, _options);
+  return _rasterizers[id];
+}
+
+// ============================================================================
+// [RasterizerAuto - AddPoly]
+// ============================================================================
+
+bool RasterizerAuto::addPoly(const Point* poly, size_t count) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseAddPoly);
+
+  if (count < 2)
+    return true;
+
+  Contour contour { _points.size(), count };
+  if (!_points.append(poly, count) || !_contours.append(contour))
+    return false;
+
+  for (size_t i = 0; i < count; i++) {
+    _bounds[0] = std::min(_bounds[0], poly[i].x);
+    _bounds[1] = std::min(_bounds[1], poly[i].y);
+    _bounds[2] = std::max(_bounds[2], poly[i].x);
+    _bounds[3] = std::max(_bounds[3], poly[i].y);
+  }
+
+  return true;
+}
+
+// ============================================================================
+// [RasterizerAuto - Render]
+// ============================================================================
+
+void RasterizerAuto::render(uint32_t argb32) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseRender);
+
+  if (_contours.empty())
+    return;
+
+  int size = int(std::max(std::ceil(_bounds[2]) - std::floor(_bounds[0]),
+                          std::ceil(_bounds[3]) - std::floor(_bounds[1])));
+
+  // Each point of a closed contour starts an edge.
+  Rasterizer* ras = _rasterizerOf(_profile.select(_width, size, _points.size()));
+  if (!ras)
+    return;
+
+  ras->resetStats();
+
+  const Point* points = _points.data();
+  for (size_t i = 0; i < _contours.size(); i++)
+    ras->addPoly(points + _contours[i].pointIndex, _contours[i].pointCount);
+
+  ras->setFillMode(_fillMode);
+  ras->render(argb32);
+  ras->clear();
+
+  _stats.add(ras->stats());
+
+  // Like other rasterizers, nothing is left to render after `render()`.
+  clear();
+}
+
+Rasterizer* newRasterizerAuto(Image& dst, uint32_t options) noexcept {
+  return new(std::nothrow) RasterizerAuto(dst, options);
+}
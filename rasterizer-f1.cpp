@@ -0,0 +1,330 @@
+#include "./compositor.h"
+#include "./rasterizer.h"
+
+// ============================================================================
+// [RasterizerF1]
+// ============================================================================
+
+//! Accumulation-buffer rasterizer (font-rs / stb_truetype style).
+//!
+//! Instead of `Cell{cover, area}` pairs, each line deposits signed area deltas
+//! into a single `float` per pixel. A prefix sum of a scanline then yields the
+//! coverage of each pixel directly, so the render step is just a vectorized
+//! prefix-sum followed by compositing.
+class RasterizerF1 : public Rasterizer {
+public:
+  RasterizerF1(Image& dst, uint32_t options) noexcept;
+  virtual ~RasterizerF1() noexcept;
+
+  bool init(int w, int h) noexcept;
+
+  virtual void reset() noexcept override;
+  virtual void clear() noexcept override;
+  virtual bool addPoly(const Point* poly, size_t count) noexcept override;
+
+  void _addLine(double x0, double y0, double x1, double y1) noexcept;
+
+  template<class Compositor, bool NonZero>
+  inline void _renderImpl(uint32_t argb32) noexcept;
+
+  virtual void render(uint32_t argb32) noexcept override;
+
+  size_t _accStride;
+  float* _acc;
+  Bounds* _xBounds;
+  Bounds _yBounds;
+};
+
+// ============================================================================
+// [RasterizerF1 - Construction / Destruction]
+// ============================================================================
+
+RasterizerF1::RasterizerF1(Image& dst, uint32_t options) noexcept
+  : Rasterizer(dst, options),
+    _accStride(0),
+    _acc(nullptr),
+    _xBounds(nullptr),
+    _yBounds { 0, 0 } {
+  std::snprintf(_name, ARRAY_SIZE(_name), "F1");
+  addOptionsToName();
+  init(dst.width(), dst.height());
+}
+
+RasterizerF1::~RasterizerF1() noexcept {
+  reset();
+}
+
+// ============================================================================
+// [RasterizerF1 - Basics]
+// ============================================================================
+
+bool RasterizerF1::init(int w, int h) noexcept {
+  if (_width != w || _height != h) {
+    if (_acc) std::free(_acc);
+    if (_xBounds) std::free(_xBounds);
+
+    _width = w;
+    _height = h;
+
+    if (w == 0 || h == 0) {
+      _accStride = 0;
+      _acc = nullptr;
+      _xBounds = nullptr;
+      _yBounds.reset();
+      return true;
+    }
+
+    // A line that ends exactly at `w` deposits into `w` and `w + 1`.
+    _accStride = w + 2;
+    _xBounds = static_cast<Bounds*>(std::malloc(h * sizeof(Bounds)));
+    _acc = static_cast<float*>(std::malloc(h * _accStride * sizeof(float)));
+
+    if (!_acc || !_xBounds) {
+      if (_acc) std::free(_acc);
+      if (_xBounds) std::free(_xBounds);
+
+      _width = 0;
+      _height = 0;
+      _accStride = 0;
+      _acc = nullptr;
+      _xBounds = nullptr;
+      _yBounds.reset();
+      return false;
+    }
+
+    std::memset(_acc, 0, h * _accStride * sizeof(float));
+    for (int y = 0; y < _height; y++)
+      _xBounds[y].reset();
+    _yBounds.reset();
+  }
+  else {
+    clear();
+  }
+
+  return true;
+}
+
+void RasterizerF1::reset() noexcept {
+  if (isInitialized()) {
+    std::free(_acc);
+    std::free(_xBounds);
+
+    _width = 0;
+    _height = 0;
+    _accStride = 0;
+    _acc = nullptr;
+    _xBounds = nullptr;
+    _yBounds.reset();
+  }
+}
+
+void RasterizerF1::clear() noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseClear);
+
+  if (isInitialized()) {
+    size_t y0 = size_t(_yBounds.start);
+    size_t y1 = size_t(_yBounds.end);
+
+    float* accPtr = _acc + y0 * _accStride;
+    while (y0 <= y1) {
+      int x0 = _xBounds[y0].start;
+      int x1 = _xBounds[y0].end;
+
+      if (x0 <= x1) {
+        size_t width = size_t(x1 - x0 + 1);
+        std::memset(accPtr + x0, 0, width * sizeof(float));
+        _xBounds[y0].reset();
+      }
+
+      accPtr += _accStride;
+      y0++;
+    }
+
+    _yBounds.reset();
+  }
+}
+
+// ============================================================================
+// [RasterizerF1 - AddPoly / AddLine]
+// ============================================================================
+
+bool RasterizerF1::addPoly(const Point* poly, size_t count) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseAddPoly);
+
+  assert(isInitialized());
+
+  if (count < 2)
+    return true;
+
+  double x0 = poly[0].x;
+  double y0 = poly[0].y;
+
+  for (size_t i = 1; i < count; i++) {
+    double x1 = poly[i].x;
+    double y1 = poly[i].y;
+
+    if (y0 != y1)
+      _addLine(x0, y0, x1, y1);
+
+    x0 = x1;
+    y0 = y1;
+  }
+
+  return true;
+}
+
+void RasterizerF1::_addLine(double x0, double y0, double x1, double y1) noexcept {
+  float dir = 1.0f;
+
+  // Always walk top-to-bottom, the direction only affects the sign.
+  if (y0 > y1) {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+    dir = -1.0f;
+  }
+
+  assert(x0 >= 0.0 && x0 <= double(_width));
+  assert(x1 >= 0.0 && x1 <= double(_width));
+  assert(y0 >= 0.0 && y1 <= double(_height));
+
+  int ey0 = int(y0);
+  int ey1 = std::min(int(std::ceil(y1)), _height);
+
+  if (ey0 >= ey1)
+    return;
+  _yBounds.union_(ey0, ey1 - 1);
+
+  // The line is walked in floats relative to the top-left pixel it touches, so
+  // the rounding error depends on the extent of the line and not on where it
+  // is on the canvas (in canvas coordinates a float has only 7 fractional bits
+  // at x = 65536, which is 2 levels of coverage).
+  int ixBase = int(std::min(x0, x1));
+  float fx0 = float(x0 - double(ixBase));
+  float fy0 = float(y0 - double(ey0));
+  float fy1 = float(y1 - double(ey0));
+  float dxdy = float((x1 - x0) / (y1 - y0));
+  float xMax = float(_width - ixBase);
+
+  float* accLine = _acc + size_t(ey0) * _accStride + size_t(ixBase);
+  float ya = fy0;
+
+  for (int y = ey0; y < ey1; y++, accLine += _accStride) {
+    float yb = std::min(float(y - ey0 + 1), fy1);
+    float dy = yb - ya;
+    float d = dy * dir;
+
+    // Both ends are computed from the start of the line, accumulating `x` row
+    // by row would add the rounding error of every row. The result can still
+    // get slightly past `0` or `_width` at the ends of the line, clamped, the
+    // deltas and `_xBounds` stay within `_accStride`.
+    float x = fx0 + dxdy * (ya - fy0);
+    float xNext = fx0 + dxdy * (yb - fy0);
+
+    float xa = std::min(std::max(std::min(x, xNext), 0.0f), xMax);
+    float xb = std::min(std::max(std::max(x, xNext), 0.0f), xMax);
+
+    float xaFloor = std::floor(xa);
+    float xbCeil = std::ceil(xb);
+
+    int ixa = int(xaFloor);
+    int ixb = int(xbCeil);
+
+    if (ixb <= ixa + 1) {
+      // The line stays within a single pixel in this scanline.
+      float xmf = 0.5f * (xa + xb) - xaFloor;
+
+      _xBounds[y].union_(ixBase + ixa, ixBase + ixa + 1);
+      accLine[ixa    ] += d - d * xmf;
+      accLine[ixa + 1] += d * xmf;
+    }
+    else {
+      // The line spans multiple pixels, distribute its area between them.
+      float s = 1.0f / (xb - xa);
+      float xaf = xa - xaFloor;
+      float a0 = 0.5f * s * (1.0f - xaf) * (1.0f - xaf);
+      float xbf = xb - xbCeil + 1.0f;
+      float am = 0.5f * s * xbf * xbf;
+
+      _xBounds[y].union_(ixBase + ixa, ixBase + ixb);
+      accLine[ixa] += d * a0;
+
+      if (ixb == ixa + 2) {
+        accLine[ixa + 1] += d * (1.0f - a0 - am);
+      }
+      else {
+        float a1 = s * (1.5f - xaf);
+        accLine[ixa + 1] += d * (a1 - a0);
+
+        for (int xi = ixa + 2; xi < ixb - 1; xi++)
+          accLine[xi] += d * s;
+
+        float a2 = a1 + float(ixb - ixa - 3) * s;
+        accLine[ixb - 1] += d * (1.0f - a2 - am);
+      }
+
+      accLine[ixb] += d * am;
+    }
+
+    ya = yb;
+  }
+}
+
+// ============================================================================
+// [RasterizerF1 - Render]
+// ============================================================================
+
+template<class Compositor, bool NonZero>
+inline void RasterizerF1::_renderImpl(uint32_t argb32) noexcept {
+  size_t y0 = size_t(_yBounds.start);
+  size_t y1 = size_t(_yBounds.end);
+
+  intptr_t stride = _dst->stride();
+  uint8_t* dstLine = _dst->data() + intptr_t(y0) * stride;
+  float* accLine = _acc + y0 * _accStride;
+
+  Compositor compositor(argb32);
+  size_t rowsRendered = 0;
+
+  while (y0 <= y1) {
+    uint32_t* dstPix = reinterpret_cast<uint32_t*>(dstLine);
+
+    if (!_xBounds[y0].empty()) {
+      int x0 = _xBounds[y0].start;
+      int xEnd = _xBounds[y0].end + 1;
+      int x1 = std::min(xEnd, _width);
+      _xBounds[y0].reset();
+
+      float cover = 0.0f;
+      compositor.template fmask<NonZero>(dstPix, size_t(x0), size_t(x1), accLine, cover);
+      RAS_STATS_ADD(_stats, vmaskSpans, 1);
+      RAS_STATS_ADD(_stats, vmaskPixels, x1 - x0);
+      rowsRendered++;
+
+      // Deltas deposited past the last pixel have nothing to composite.
+      if (x1 < xEnd)
+        std::memset(accLine + x1, 0, size_t(xEnd - x1) * sizeof(float));
+    }
+
+    y0++;
+    dstLine += stride;
+    accLine += _accStride;
+  }
+
+  RAS_STATS_ADD(_stats, renderCalls, 1);
+  RAS_STATS_ADD(_stats, rowsRendered, rowsRendered);
+  RAS_STATS_ADD(_stats, rowsSkipped, size_t(_height) - rowsRendered);
+  _yBounds.reset();
+}
+
+void RasterizerF1::render(uint32_t argb32) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseRender);
+  doRender(*this, argb32);
+}
+
+// ============================================================================
+// [RasterizerF1 - New]
+// ============================================================================
+
+Rasterizer* newRasterizerF1(Image& dst, uint32_t options) noexcept {
+  return new(std::nothrow) RasterizerF1(dst, options);
+}
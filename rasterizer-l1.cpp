@@ -0,0 +1,417 @@
+#include "./compositor.h"
+#include "./rasterizer.h"
+#include "./simd.h"
+
+// ============================================================================
+// [RasterizerL1]
+// ============================================================================
+
+//! Sorted cell-list rasterizer.
+//!
+//! Like AGG, cells are appended to a compact list instead of being merged into
+//! a dense grid, so the memory used is proportional to the number of cells the
+//! edges pass through. Each cell is stored as a 32-bit `(y << 16) | x` key and
+//! a `Cell` in two parallel arrays. During `render()` the list is sorted by an
+//! LSD radix sort - a vectorized pass over the keys finds which bytes differ at
+//! all, so only those are sorted by (usually 2 or 3 of 4 passes instead of the
+//! comparison sort of AGG). Cells of the same key are then merged and each
+//! scanline is swept from left to right - runs of adjacent cells are
+//! composited by `vmask()` and spans between them by `cmask()`.
+class RasterizerL1 : public CellRasterizer {
+public:
+  enum : uint32_t {
+    kInitialCapacity = 1024,
+    kInvalidKey = 0xFFFFFFFFU,
+
+    kRadixBits = 8,
+    kRadixSize = 1 << kRadixBits,
+    kRadixMask = kRadixSize - 1,
+    kRadixPasses = 32 / kRadixBits
+  };
+
+  static inline uint32_t cellKey(uint32_t x, uint32_t y) noexcept { return (y << 16) | x; }
+
+  RasterizerL1(Image& dst, uint32_t options) noexcept;
+  virtual ~RasterizerL1() noexcept;
+
+  bool init(int w, int h) noexcept;
+
+  virtual void reset() noexcept override;
+  virtual void clear() noexcept override;
+  virtual bool addPoly(const Point* poly, size_t count) noexcept override;
+
+  bool _grow() noexcept;
+  void _sort() noexcept;
+  size_t _merge() noexcept;
+
+  inline void _mergeCell(int x, int y, int cover, int area) noexcept {
+    assert(x >= 0 && x <= _width);
+    assert(y >= 0 && y < _height);
+
+    // Consecutive cells of a line are often the same cell, these are merged
+    // right away, the rest is merged after sorting.
+    uint32_t key = cellKey(uint32_t(x), uint32_t(y));
+    if (key != _lastKey) {
+      if (_cellCount == _cellCapacity && !_grow())
+        return;
+
+      _keys[_cellCount] = key;
+      _cells[_cellCount].reset();
+      _cellCount++;
+      _lastKey = key;
+    }
+
+    Cell& cell = _cells[_cellCount - 1];
+    cell.cover += cover;
+    cell.area  += area;
+    RAS_STATS_ADD(_stats, cellsMerged, 1);
+  }
+
+  template<class Compositor, bool NonZero>
+  inline void _renderImpl(uint32_t argb32) noexcept;
+
+  virtual void render(uint32_t argb32) noexcept override;
+
+  //! Cell keys and cells, `_tmpKeys` and `_tmpCells` are the second buffer
+  //! used by the radix sort.
+  uint32_t* _keys;
+  Cell* _cells;
+  uint32_t* _tmpKeys;
+  Cell* _tmpCells;
+
+  size_t _cellCount;
+  size_t _cellCapacity;
+
+  uint32_t _lastKey;
+  bool _outOfMemory;
+};
+
+// ============================================================================
+// [RasterizerL1 - Construction / Destruction]
+// ============================================================================
+
+RasterizerL1::RasterizerL1(Image& dst, uint32_t options) noexcept
+  : CellRasterizer(dst, options),
+    _keys(nullptr),
+    _cells(nullptr),
+    _tmpKeys(nullptr),
+    _tmpCells(nullptr),
+    _cellCount(0),
+    _cellCapacity(0),
+    _lastKey(kInvalidKey),
+    _outOfMemory(false) {
+  std::snprintf(_name, ARRAY_SIZE(_name), "L1");
+  addOptionsToName();
+  init(dst.width(), dst.height());
+}
+
+RasterizerL1::~RasterizerL1() noexcept {
+  reset();
+}
+
+// ============================================================================
+// [RasterizerL1 - Basics]
+// ============================================================================
+
+bool RasterizerL1::init(int w, int h) noexcept {
+  // Coordinates are packed into 16 bits each, cells can be at `x == w`.
+  if (uint32_t(w) >= 0xFFFFU || uint32_t(h) >= 0xFFFFU)
+    return false;
+
+  _width = w;
+  _height = h;
+
+  clear();
+  return true;
+}
+
+void RasterizerL1::reset() noexcept {
+  if (_keys) std::free(_keys);
+  if (_cells) std::free(_cells);
+  if (_tmpKeys) std::free(_tmpKeys);
+  if (_tmpCells) std::free(_tmpCells);
+
+  _width = 0;
+  _height = 0;
+  _keys = nullptr;
+  _cells = nullptr;
+  _tmpKeys = nullptr;
+  _tmpCells = nullptr;
+  _cellCount = 0;
+  _cellCapacity = 0;
+  _lastKey = kInvalidKey;
+  _outOfMemory = false;
+}
+
+void RasterizerL1::clear() noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseClear);
+
+  _cellCount = 0;
+  _lastKey = kInvalidKey;
+  _outOfMemory = false;
+}
+
+bool RasterizerL1::_grow() noexcept {
+  size_t capacity = _cellCapacity ? _cellCapacity * 2 : size_t(kInitialCapacity);
+
+  // Only `_keys` and `_cells` hold data, the temporary buffers are not copied.
+  uint32_t* keys = static_cast<uint32_t*>(std::realloc(_keys, capacity * sizeof(uint32_t)));
+  if (!keys) {
+    _outOfMemory = true;
+    return false;
+  }
+  _keys = keys;
+
+  Cell* cells = static_cast<Cell*>(std::realloc(_cells, capacity * sizeof(Cell)));
+  if (!cells) {
+    _outOfMemory = true;
+    return false;
+  }
+  _cells = cells;
+
+  // The old temporary buffers are kept on failure, they still fit all cells.
+  uint32_t* tmpKeys = static_cast<uint32_t*>(std::malloc(capacity * sizeof(uint32_t)));
+  Cell* tmpCells = static_cast<Cell*>(std::malloc(capacity * sizeof(Cell)));
+
+  if (!tmpKeys || !tmpCells) {
+    std::free(tmpKeys);
+    std::free(tmpCells);
+    _outOfMemory = true;
+    return false;
+  }
+
+  std::free(_tmpKeys);
+  std::free(_tmpCells);
+  _tmpKeys = tmpKeys;
+  _tmpCells = tmpCells;
+
+  _cellCapacity = capacity;
+  return true;
+}
+
+// ============================================================================
+// [RasterizerL1 - AddPoly / AddLine]
+// ============================================================================
+
+bool RasterizerL1::addPoly(const Point* poly, size_t count) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseAddPoly);
+
+  assert(isInitialized());
+
+  if (count < 2)
+    return true;
+
+  int x0 = static_cast<int>(poly[0].x * 256);
+  int y0 = static_cast<int>(poly[0].y * 256);
+
+  for (size_t i = 1; i < count; i++) {
+    int x1 = static_cast<int>(poly[i].x * 256);
+    int y1 = static_cast<int>(poly[i].y * 256);
+
+    if (x0 != x1 || y0 != y1)
+      addLineT<RasterizerL1, int64_t>(*this, x0, y0, x1, y1);
+
+    x0 = x1;
+    y0 = y1;
+  }
+
+  return !_outOfMemory;
+}
+
+// ============================================================================
+// [RasterizerL1 - Sort / Merge]
+// ============================================================================
+
+//! Returns bits that differ in at least one of `keys` from the first key.
+static uint32_t keyDiffBits(const uint32_t* keys, size_t count) noexcept {
+  uint32_t k0 = keys[0];
+  uint32_t diff = 0;
+  size_t i = 0;
+
+  if (count >= 8) {
+    SIMD::I128 vk = SIMD::vseti128i32(int32_t(k0));
+    SIMD::I128 d0 = SIMD::vzeroi128();
+    SIMD::I128 d1 = SIMD::vzeroi128();
+
+    for (; i + 8 <= count; i += 8) {
+      d0 = SIMD::vor(d0, SIMD::vxor(SIMD::vloadi128u(keys + i + 0), vk));
+      d1 = SIMD::vor(d1, SIMD::vxor(SIMD::vloadi128u(keys + i + 4), vk));
+    }
+
+    d0 = SIMD::vor(d0, d1);
+    d0 = SIMD::vor(d0, SIMD::vswizi32<1, 0, 3, 2>(d0));
+    d0 = SIMD::vor(d0, SIMD::vswizi32<2, 3, 0, 1>(d0));
+    diff = SIMD::vcvti128u32(d0);
+  }
+
+  for (; i < count; i++)
+    diff |= keys[i] ^ k0;
+  return diff;
+}
+
+void RasterizerL1::_sort() noexcept {
+  size_t count = _cellCount;
+  if (count < 2)
+    return;
+
+  // Bytes that are the same in all keys don't need a pass - a shape usually
+  // spans less than 256 rows and 256 columns, which leaves 2 passes of 4.
+  uint32_t diff = keyDiffBits(_keys, count);
+  uint32_t passes[kRadixPasses];
+  uint32_t passCount = 0;
+
+  for (uint32_t p = 0; p < kRadixPasses; p++)
+    if ((diff >> (p * kRadixBits)) & kRadixMask)
+      passes[passCount++] = p * kRadixBits;
+
+  if (!passCount)
+    return;
+
+  // Histograms of all passes are built by a single pass over the keys.
+  uint32_t histogram[kRadixPasses][kRadixSize];
+  std::memset(histogram, 0, passCount * sizeof(histogram[0]));
+
+  for (size_t i = 0; i < count; i++) {
+    uint32_t key = _keys[i];
+    for (uint32_t p = 0; p < passCount; p++)
+      histogram[p][(key >> passes[p]) & kRadixMask]++;
+  }
+
+  for (uint32_t p = 0; p < passCount; p++) {
+    uint32_t* offsets = histogram[p];
+    uint32_t shift = passes[p];
+
+    uint32_t sum = 0;
+    for (uint32_t j = 0; j < kRadixSize; j++) {
+      uint32_t n = offsets[j];
+      offsets[j] = sum;
+      sum += n;
+    }
+
+    const uint32_t* srcKeys = _keys;
+    const Cell* srcCells = _cells;
+
+    for (size_t i = 0; i < count; i++) {
+      uint32_t key = srcKeys[i];
+      uint32_t index = offsets[(key >> shift) & kRadixMask]++;
+
+      _tmpKeys[index] = key;
+      _tmpCells[index] = srcCells[i];
+    }
+
+    std::swap(_keys, _tmpKeys);
+    std::swap(_cells, _tmpCells);
+  }
+}
+
+size_t RasterizerL1::_merge() noexcept {
+  size_t count = _cellCount;
+  if (!count)
+    return 0;
+
+  uint32_t* keys = _keys;
+  Cell* cells = _cells;
+
+  size_t unique = 0;
+  for (size_t i = 1; i < count; i++) {
+    if (keys[i] == keys[unique]) {
+      cells[unique].cover += cells[i].cover;
+      cells[unique].area  += cells[i].area;
+    }
+    else {
+      unique++;
+      keys[unique] = keys[i];
+      cells[unique] = cells[i];
+    }
+  }
+
+  return unique + 1;
+}
+
+// ============================================================================
+// [RasterizerL1 - Render]
+// ============================================================================
+
+template<class Compositor, bool NonZero>
+inline void RasterizerL1::_renderImpl(uint32_t argb32) noexcept {
+  RAS_STATS_ADD(_stats, renderCalls, 1);
+
+  _sort();
+  size_t count = _merge();
+
+  const uint32_t* keys = _keys;
+  Cell* cells = _cells;
+
+  intptr_t stride = _dst->stride();
+  size_t w = size_t(_width);
+
+  Compositor compositor(argb32);
+  size_t rowsRendered = 0;
+  size_t i = 0;
+
+  // Each scanline starts with zero coverage, so scanlines without cells are
+  // empty and are not visited at all.
+  while (i < count) {
+    uint32_t y = keys[i] >> 16;
+    uint32_t* dstPix = reinterpret_cast<uint32_t*>(_dst->data() + intptr_t(y) * stride);
+
+    int cover = 0;
+    size_t x = 0;
+
+    do {
+      size_t runStart = i;
+      size_t xStart = keys[i] & 0xFFFFU;
+
+      // Run of cells at adjacent pixels.
+      while (++i < count && keys[i] == keys[i - 1] + 1)
+        continue;
+
+      // Solid span between the previous run and this one.
+      if (x < xStart) {
+        uint32_t mask = CompositeUtils::calcMask<NonZero>(cover);
+        if (mask) {
+          compositor.cmask(dstPix, x, xStart, mask);
+          RAS_STATS_ADD(_stats, cmaskSpans, 1);
+          RAS_STATS_ADD(_stats, cmaskPixels, xStart - x);
+        }
+      }
+
+      // A cell at `x == w` has no pixel, it only ends the scanline.
+      x = std::min<size_t>(xStart + (i - runStart), w);
+      if (xStart < x) {
+        compositor.template vmask<NonZero, false>(dstPix + xStart, 0, x - xStart, cells + runStart, cover);
+        RAS_STATS_ADD(_stats, vmaskSpans, 1);
+        RAS_STATS_ADD(_stats, vmaskPixels, x - xStart);
+      }
+    } while (i < count && (keys[i] >> 16) == y);
+
+    if (x < w) {
+      uint32_t mask = CompositeUtils::calcMask<NonZero>(cover);
+      if (mask) {
+        compositor.cmask(dstPix, x, w, mask);
+        RAS_STATS_ADD(_stats, cmaskSpans, 1);
+        RAS_STATS_ADD(_stats, cmaskPixels, w - x);
+      }
+    }
+
+    rowsRendered++;
+  }
+
+  RAS_STATS_ADD(_stats, rowsRendered, rowsRendered);
+  RAS_STATS_ADD(_stats, rowsSkipped, size_t(_height) - rowsRendered);
+
+  clear();
+}
+
+void RasterizerL1::render(uint32_t argb32) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseRender);
+  doRender(*this, argb32);
+}
+
+// ============================================================================
+// [RasterizerL1 - New]
+// ============================================================================
+
+Rasterizer* newRasterizerL1(Image& dst, uint32_t options) noexcept {
+  return new(std::nothrow) RasterizerL1(dst, options);
+}
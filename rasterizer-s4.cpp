@@ -0,0 +1,310 @@
+#include "./compositor.h"
+#include "./rasterizer.h"
+
+// ============================================================================
+// [RasterizerS4]
+// ============================================================================
+
+//! Sparse-strip rasterizer.
+//!
+//! Cells are only stored in 4x4 tiles that were touched by an edge, so the
+//! memory used is proportional to the perimeter of the rendered shape and not
+//! to the size of the canvas. During `render()` tiles are sorted by `(y, x)`,
+//! the coverage accumulated on the left of each tile (the winding backdrop) is
+//! carried from tile to tile, edge tiles are composited by `vmask()` and spans
+//! between them by `cmask()`.
+class RasterizerS4 : public CellRasterizer {
+public:
+  enum : uint32_t {
+    kTileShift = 2,
+    kTileSize = 1 << kTileShift,
+    kTileMask = kTileSize - 1,
+    kTileCells = kTileSize * kTileSize,
+
+    kInitialCapacity = 256,
+    kInvalidKey = 0xFFFFFFFFU
+  };
+
+  struct Tile {
+    uint32_t key;
+    Cell cells[kTileCells];
+  };
+
+  static inline uint32_t tileKey(uint32_t tx, uint32_t ty) noexcept { return (ty << 16) | tx; }
+
+  RasterizerS4(Image& dst, uint32_t options) noexcept;
+  virtual ~RasterizerS4() noexcept;
+
+  bool init(int w, int h) noexcept;
+
+  virtual void reset() noexcept override;
+  virtual void clear() noexcept override;
+  virtual bool addPoly(const Point* poly, size_t count) noexcept override;
+
+  bool _grow() noexcept;
+
+  inline void _mergeCell(int x, int y, int cover, int area) noexcept {
+    assert(x >= 0 && x <= _width);
+    assert(y >= 0 && y < _height);
+
+    uint32_t key = tileKey(uint32_t(x) >> kTileShift, uint32_t(y) >> kTileShift);
+    if (key != _lastKey) {
+      if (_tileCount == _tileCapacity && !_grow())
+        return;
+
+      Tile& tile = _tiles[_tileCount];
+      tile.key = key;
+      std::memset(tile.cells, 0, sizeof(tile.cells));
+
+      _lastTile = _tileCount++;
+      _lastKey = key;
+    }
+
+    Cell& cell = _tiles[_lastTile].cells[(uint32_t(y) & kTileMask) * kTileSize + (uint32_t(x) & kTileMask)];
+    cell.cover += cover;
+    cell.area  += area;
+    RAS_STATS_ADD(_stats, cellsMerged, 1);
+  }
+
+  template<class Compositor, bool NonZero>
+  inline void _renderImpl(uint32_t argb32) noexcept;
+
+  virtual void render(uint32_t argb32) noexcept override;
+
+  Tile* _tiles;
+  uint64_t* _order;
+  size_t _tileCount;
+  size_t _tileCapacity;
+
+  size_t _lastTile;
+  uint32_t _lastKey;
+  bool _outOfMemory;
+};
+
+// ============================================================================
+// [RasterizerS4 - Construction / Destruction]
+// ============================================================================
+
+RasterizerS4::RasterizerS4(Image& dst, uint32_t options) noexcept
+  : CellRasterizer(dst, options),
+    _tiles(nullptr),
+    _order(nullptr),
+    _tileCount(0),
+    _tileCapacity(0),
+    _lastTile(0),
+    _lastKey(kInvalidKey),
+    _outOfMemory(false) {
+  std::snprintf(_name, ARRAY_SIZE(_name), "S4");
+  addOptionsToName();
+  init(dst.width(), dst.height());
+}
+
+RasterizerS4::~RasterizerS4() noexcept {
+  reset();
+}
+
+// ============================================================================
+// [RasterizerS4 - Basics]
+// ============================================================================
+
+bool RasterizerS4::init(int w, int h) noexcept {
+  // Tile coordinates are packed into 16 bits each.
+  if (uint32_t(w) > (0xFFFFU << kTileShift) || uint32_t(h) > (0xFFFFU << kTileShift))
+    return false;
+
+  _width = w;
+  _height = h;
+
+  clear();
+  return true;
+}
+
+void RasterizerS4::reset() noexcept {
+  if (_tiles) std::free(_tiles);
+  if (_order) std::free(_order);
+
+  _width = 0;
+  _height = 0;
+  _tiles = nullptr;
+  _order = nullptr;
+  _tileCount = 0;
+  _tileCapacity = 0;
+  _lastTile = 0;
+  _lastKey = kInvalidKey;
+  _outOfMemory = false;
+}
+
+void RasterizerS4::clear() noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseClear);
+
+  _tileCount = 0;
+  _lastTile = 0;
+  _lastKey = kInvalidKey;
+  _outOfMemory = false;
+}
+
+bool RasterizerS4::_grow() noexcept {
+  size_t capacity = _tileCapacity ? _tileCapacity * 2 : size_t(kInitialCapacity);
+
+  Tile* tiles = static_cast<Tile*>(std::realloc(_tiles, capacity * sizeof(Tile)));
+  if (!tiles) {
+    _outOfMemory = true;
+    return false;
+  }
+  _tiles = tiles;
+
+  uint64_t* order = static_cast<uint64_t*>(std::realloc(_order, capacity * sizeof(uint64_t)));
+  if (!order) {
+    _outOfMemory = true;
+    return false;
+  }
+  _order = order;
+
+  _tileCapacity = capacity;
+  return true;
+}
+
+// ============================================================================
+// [RasterizerS4 - AddPoly / AddLine]
+// ============================================================================
+
+bool RasterizerS4::addPoly(const Point* poly, size_t count) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseAddPoly);
+
+  assert(isInitialized());
+
+  if (count < 2)
+    return true;
+
+  int x0 = static_cast<int>(poly[0].x * 256);
+  int y0 = static_cast<int>(poly[0].y * 256);
+
+  for (size_t i = 1; i < count; i++) {
+    int x1 = static_cast<int>(poly[i].x * 256);
+    int y1 = static_cast<int>(poly[i].y * 256);
+
+    if (x0 != x1 || y0 != y1)
+      addLineT<RasterizerS4, int64_t>(*this, x0, y0, x1, y1);
+
+    x0 = x1;
+    y0 = y1;
+  }
+
+  return !_outOfMemory;
+}
+
+// ============================================================================
+// [RasterizerS4 - Render]
+// ============================================================================
+
+template<class Compositor, bool NonZero>
+inline void RasterizerS4::_renderImpl(uint32_t argb32) noexcept {
+  size_t count = _tileCount;
+  RAS_STATS_ADD(_stats, renderCalls, 1);
+
+  if (!count) {
+    RAS_STATS_ADD(_stats, rowsSkipped, _height);
+    return;
+  }
+
+  // Sort tiles by `(y, x)`. The key is in the high 32 bits so the tile index
+  // in the low 32 bits doesn't affect the order of different tiles.
+  for (size_t i = 0; i < count; i++)
+    _order[i] = (uint64_t(_tiles[i].key) << 32) | uint64_t(i);
+  std::sort(_order, _order + count);
+
+  // Merge tiles that were emitted more than once (by different edges) into
+  // the first one and compact the order so each key appears only once.
+  size_t unique = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t key = uint32_t(_order[i] >> 32);
+    Tile& src = _tiles[uint32_t(_order[i])];
+
+    if (unique && uint32_t(_order[unique - 1] >> 32) == key) {
+      Tile& dst = _tiles[uint32_t(_order[unique - 1])];
+      for (uint32_t j = 0; j < kTileCells; j++) {
+        dst.cells[j].cover += src.cells[j].cover;
+        dst.cells[j].area  += src.cells[j].area;
+      }
+    }
+    else {
+      _order[unique++] = _order[i];
+    }
+  }
+
+  intptr_t stride = _dst->stride();
+  size_t w = size_t(_width);
+
+  Compositor compositor(argb32);
+  size_t rowStart = 0;
+  size_t rowsRendered = 0;
+
+  while (rowStart < unique) {
+    uint32_t ty = uint32_t(_order[rowStart] >> 48);
+    size_t rowEnd = rowStart + 1;
+
+    while (rowEnd < unique && uint32_t(_order[rowEnd] >> 48) == ty)
+      rowEnd++;
+
+    uint32_t y = ty << kTileShift;
+    uint32_t yEnd = std::min<uint32_t>(y + kTileSize, uint32_t(_height));
+
+    for (uint32_t r = 0; y < yEnd; r++, y++) {
+      uint32_t* dstPix = reinterpret_cast<uint32_t*>(_dst->data() + intptr_t(y) * stride);
+
+      int cover = 0;
+      size_t x = 0;
+
+      for (size_t i = rowStart; i < rowEnd; i++) {
+        Tile& tile = _tiles[uint32_t(_order[i])];
+        size_t tx = size_t((tile.key & 0xFFFFU) << kTileShift);
+
+        // Solid span between the previous edge tile and this one.
+        if (x < tx) {
+          uint32_t mask = CompositeUtils::calcMask<NonZero>(cover);
+          if (mask) {
+            compositor.cmask(dstPix, x, tx, mask);
+            RAS_STATS_ADD(_stats, cmaskSpans, 1);
+            RAS_STATS_ADD(_stats, cmaskPixels, tx - x);
+          }
+        }
+
+        x = std::min<size_t>(tx + kTileSize, w);
+        compositor.template vmask<NonZero>(dstPix + tx, 0, x - tx, &tile.cells[r * kTileSize], cover);
+        RAS_STATS_ADD(_stats, vmaskSpans, 1);
+        RAS_STATS_ADD(_stats, vmaskPixels, x - tx);
+      }
+
+      if (x < w) {
+        uint32_t mask = CompositeUtils::calcMask<NonZero>(cover);
+        if (mask) {
+          compositor.cmask(dstPix, x, w, mask);
+          RAS_STATS_ADD(_stats, cmaskSpans, 1);
+          RAS_STATS_ADD(_stats, cmaskPixels, w - x);
+        }
+      }
+
+      rowsRendered++;
+    }
+
+    rowStart = rowEnd;
+  }
+
+  RAS_STATS_ADD(_stats, rowsRendered, rowsRendered);
+  RAS_STATS_ADD(_stats, rowsSkipped, size_t(_height) - rowsRendered);
+
+  clear();
+}
+
+void RasterizerS4::render(uint32_t argb32) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseRender);
+  doRender(*this, argb32);
+}
+
+// ============================================================================
+// [RasterizerS4 - New]
+// ============================================================================
+
+Rasterizer* newRasterizerS4(Image& dst, uint32_t options) noexcept {
+  return new(std::nothrow) RasterizerS4(dst, options);
+}
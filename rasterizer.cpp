@@ -11,12 +11,17 @@ Rasterizer::Rasterizer(Image& dst, uint32_t options) noexcept
     _width(0),
     _height(0),
     _options(options),
-    _fillMode(kFillEvenOdd) {}
+    _fillMode(kFillEvenOdd) {
+  _phaseTimers.reset();
+  _stats.reset();
+}
 Rasterizer::~Rasterizer() noexcept {}
 
 void Rasterizer::addOptionsToName() noexcept {
   if (hasOption(kOptionSIMD))
     std::strcat(_name, "_SIMD");
+  if (hasOption(kOptionSoA))
+    std::strcat(_name, "_SoA");
 }
 
 // ============================================================================
@@ -27,8 +32,15 @@ Rasterizer* newRasterizerA1(Image& dst, uint32_t options) noexcept;
 Rasterizer* newRasterizerA2(Image& dst, uint32_t options) noexcept;
 Rasterizer* newRasterizerA3(Image& dst, uint32_t options, uint32_t n) noexcept;
 Rasterizer* newRasterizerAGG(Image& dst, uint32_t options) noexcept;
+Rasterizer* newRasterizerF1(Image& dst, uint32_t options) noexcept;
+Rasterizer* newRasterizerS4(Image& dst, uint32_t options) noexcept;
+Rasterizer* newRasterizerL1(Image& dst, uint32_t options) noexcept;
+Rasterizer* newRasterizerAuto(Image& dst, uint32_t options) noexcept;
 
 Rasterizer* Rasterizer::newById(Image& dst, uint32_t id, uint32_t options) {
+  if (id != kIdA2 && (id < kIdA3x4 || id > kIdA3x32))
+    options &= ~uint32_t(kOptionSoA);
+
   switch (id) {
     case kIdAGG  : return newRasterizerAGG(dst, options);
     case kIdA1   : return newRasterizerA1(dst, options);
@@ -37,12 +49,50 @@ Rasterizer* Rasterizer::newById(Image& dst, uint32_t id, uint32_t options) {
     case kIdA3x8 : return newRasterizerA3(dst, options, 8);
     case kIdA3x16: return newRasterizerA3(dst, options, 16);
     case kIdA3x32: return newRasterizerA3(dst, options, 32);
+    case kIdF1   : return newRasterizerF1(dst, options);
+    case kIdS4   : return newRasterizerS4(dst, options);
+    case kIdL1   : return newRasterizerL1(dst, options);
+    case kIdAuto : return newRasterizerAuto(dst, options);
 
     default:
       return nullptr;
   }
 }
 
+static const char rasterizerNames[] =
+  "AGG\0"
+  "A1\0"
+  "A2\0"
+  "A3x4\0"
+  "A3x8\0"
+  "A3x16\0"
+  "A3x32\0"
+  "F1\0"
+  "S4\0"
+  "L1\0"
+  "Auto\0";
+
+const char* Rasterizer::nameOf(uint32_t id) noexcept {
+  const char* name = rasterizerNames;
+  if (id >= kIdCount)
+    return "unknown";
+
+  while (id) {
+    name += strlen(name) + 1;
+    id--;
+  }
+  return name;
+}
+
+uint32_t Rasterizer::idByName(const char* name, size_t nameSize) noexcept {
+  for (uint32_t id = 0; id < kIdCount; id++) {
+    const char* s = nameOf(id);
+    if (strlen(s) == nameSize && memcmp(s, name, nameSize) == 0)
+      return id;
+  }
+  return kIdCount;
+}
+
 // ============================================================================
 // [CellRasterizer]
 // ============================================================================
@@ -3,6 +3,104 @@
 
 #include "./compositor.h"
 #include "./globals.h"
+#include "./intutils.h"
+#include "./performance.h"
+
+//! Accumulates time spent in `addPoly()`, `render()`, and `clear()` of each
+//! rasterizer (see `Rasterizer::phaseTimers()`). Disabled by default, reading
+//! the clock costs more than adding a small polygon.
+#ifndef RAS_PHASE_TIMERS
+  #define RAS_PHASE_TIMERS 0
+#endif
+
+//! Counts work done by rasterizers - cells merged, BitWords scanned, spans and
+//! pixels composited, and rows rendered (see `Rasterizer::stats()`). Disabled
+//! by default, when disabled `RAS_STATS_ADD()` doesn't even evaluate its
+//! arguments.
+#ifndef RAS_STATS
+  #define RAS_STATS 0
+#endif
+
+#if RAS_STATS
+  #define RAS_STATS_ADD(STATS, FIELD, N) ((STATS).FIELD += uint64_t(N))
+#else
+  #define RAS_STATS_ADD(STATS, FIELD, N) ((void)0)
+#endif
+
+// ============================================================================
+// [PhaseTimers]
+// ============================================================================
+
+//! Time accumulated in each phase of a rasterizer.
+struct PhaseTimers {
+  enum Phase : uint32_t {
+    kPhaseAddPoly = 0,
+    kPhaseRender,
+    kPhaseClear,
+    kPhaseCount
+  };
+
+  inline void reset() noexcept {
+    for (uint32_t i = 0; i < kPhaseCount; i++) {
+      ns[i] = 0;
+      calls[i] = 0;
+    }
+  }
+
+  uint64_t ns[kPhaseCount];
+  uint64_t calls[kPhaseCount];
+};
+
+// ============================================================================
+// [RasterStats]
+// ============================================================================
+
+//! Work counters of a rasterizer, accumulated over all `render()` calls until
+//! reset. Counters that don't apply to a rasterizer stay zero.
+struct RasterStats {
+  inline void reset() noexcept {
+    renderCalls = 0;
+    cellsMerged = 0;
+    bitWordsScanned = 0;
+    bitWordsNonEmpty = 0;
+    cmaskSpans = 0;
+    cmaskPixels = 0;
+    vmaskSpans = 0;
+    vmaskPixels = 0;
+    rowsRendered = 0;
+    rowsSkipped = 0;
+  }
+
+  inline void add(const RasterStats& other) noexcept {
+    renderCalls += other.renderCalls;
+    cellsMerged += other.cellsMerged;
+    bitWordsScanned += other.bitWordsScanned;
+    bitWordsNonEmpty += other.bitWordsNonEmpty;
+    cmaskSpans += other.cmaskSpans;
+    cmaskPixels += other.cmaskPixels;
+    vmaskSpans += other.vmaskSpans;
+    vmaskPixels += other.vmaskPixels;
+    rowsRendered += other.rowsRendered;
+    rowsSkipped += other.rowsSkipped;
+  }
+
+  uint64_t renderCalls;
+  //! Number of `_mergeCell()` calls.
+  uint64_t cellsMerged;
+  //! BitWords visited by `RasterizerA3` and how many of them had a bit set.
+  uint64_t bitWordsScanned;
+  uint64_t bitWordsNonEmpty;
+  //! Solid spans composited by `cmask()` and their pixels.
+  uint64_t cmaskSpans;
+  uint64_t cmaskPixels;
+  //! Spans composited cell by cell by `vmask()` (or `fmask()`) and their pixels.
+  uint64_t vmaskSpans;
+  uint64_t vmaskPixels;
+  //! Rows processed by the render loop and rows of the destination (or tile)
+  //! it skipped, either by bounds or because they were known to be empty.
+  uint64_t rowsRendered;
+  uint64_t rowsSkipped;
+};
 
 // ============================================================================
 // [Rasterizer]
@@ -19,11 +117,20 @@ public:
     kIdA3x8,
     kIdA3x16,
     kIdA3x32,
+    kIdF1,
+    kIdS4,
+    kIdL1,
+    //! Selects one of the rasterizers above per `render()` by `AutoProfile`.
+    kIdAuto,
     kIdCount
   };
 
   enum Options : uint32_t {
-    kOptionSIMD = 0x01
+    kOptionSIMD = 0x01,
+    //! Stores cells of each row as a plane of covers followed by a plane of
+    //! areas instead of `Cell` pairs (see `CellLayoutSoA`), only used by A2
+    //! and A3, `newById()` removes it from options of other rasterizers.
+    kOptionSoA = 0x02
   };
 
   enum FillMode : uint32_t {
@@ -33,6 +140,11 @@ public:
 
   static Rasterizer* newById(Image& dst, uint32_t id, uint32_t options);
 
+  //! Returns the base name (without options) of rasterizer `id`.
+  static const char* nameOf(uint32_t id) noexcept;
+  //! Returns the id of rasterizer `name` or `kIdCount` if there is no such one.
+  static uint32_t idByName(const char* name, size_t nameSize) noexcept;
+
   Rasterizer(Image& dst, uint32_t options) noexcept;
   virtual ~Rasterizer() noexcept;
 
@@ -50,6 +162,18 @@ public:
   inline uint32_t fillMode() const noexcept { return _fillMode; }
   inline void setFillMode(uint32_t fillMode) noexcept { _fillMode = fillMode; }
 
+  //! Returns `true` if phase timers are compiled in (`RAS_PHASE_TIMERS`).
+  static constexpr bool hasPhaseTimers() noexcept { return RAS_PHASE_TIMERS != 0; }
+
+  inline const PhaseTimers& phaseTimers() const noexcept { return _phaseTimers; }
+  inline void resetPhaseTimers() noexcept { _phaseTimers.reset(); }
+
+  //! Returns `true` if work counters are compiled in (`RAS_STATS`).
+  static constexpr bool hasStats() noexcept { return RAS_STATS != 0; }
+
+  inline const RasterStats& stats() const noexcept { return _stats; }
+  inline void resetStats() noexcept { _stats.reset(); }
+
   virtual void reset() noexcept = 0;
   virtual void clear() noexcept = 0;
   virtual bool addPoly(const Point* poly, size_t count) noexcept = 0;
@@ -77,6 +201,86 @@ public:
   int _height;
   uint32_t _options;
   uint32_t _fillMode;
+  PhaseTimers _phaseTimers;
+  RasterStats _stats;
+};
+
+// ============================================================================
+// [PhaseScope]
+// ============================================================================
+
+//! Adds the time between its construction and destruction to a phase of the
+//! rasterizer, does nothing unless `RAS_PHASE_TIMERS` is enabled.
+class PhaseScope {
+public:
+#if RAS_PHASE_TIMERS
+  inline PhaseScope(Rasterizer& ras, uint32_t phase) noexcept
+    : _timers(ras._phaseTimers),
+      _phase(phase),
+      _start(Performance::getTimeNs()) {}
+
+  inline ~PhaseScope() noexcept {
+    _timers.ns[_phase] += Performance::getTimeNs() - _start;
+    _timers.calls[_phase]++;
+  }
+
+  PhaseTimers& _timers;
+  uint32_t _phase;
+  uint64_t _start;
+#else
+  inline PhaseScope(Rasterizer& ras, uint32_t phase) noexcept {
+    (void)ras;
+    (void)phase;
+  }
+#endif
+};
+
+// ============================================================================
+// [AutoProfile]
+// ============================================================================
+
+//! The fastest rasterizer for each class of shapes, used by `kIdAuto`.
+//!
+//! Shapes are classified by the width of the canvas, the larger side of their
+//! bounding box, and their number of edges, each rounded up to a power of two
+//! (or a power of eight for edges). The table is either the built-in default
+//! or calibrated by `render_bench --calibrate=FILE` and loaded from the file.
+struct AutoProfile {
+  enum : uint32_t {
+    //! Canvas widths up to 256, 512, 1024, 2048, and more.
+    kCanvasClassCount = 5,
+    //! Shape sizes up to 8, 16, ..., 2048, and more.
+    kSizeClassCount = 10,
+    //! Edge counts up to 16, 128, and more.
+    kEdgeClassCount = 3
+  };
+
+  static uint32_t canvasClassOf(int w) noexcept;
+  static uint32_t sizeClassOf(int size) noexcept;
+  static uint32_t edgeClassOf(size_t edgeCount) noexcept;
+
+  //! Largest canvas width, shape size, and edge count of each class (the last
+  //! class is represented by twice the previous value).
+  static int canvasOfClass(uint32_t canvasClass) noexcept;
+  static int sizeOfClass(uint32_t sizeClass) noexcept;
+  static uint32_t edgesOfClass(uint32_t edgeClass) noexcept;
+
+  //! Profile used by `kIdAuto` rasterizers created from now on.
+  static AutoProfile& global() noexcept;
+
+  inline uint32_t select(int canvasW, int size, size_t edgeCount) const noexcept {
+    return ids[canvasClassOf(canvasW)][sizeClassOf(size)][edgeClassOf(edgeCount)];
+  }
+
+  void resetToDefault() noexcept;
+
+  //! Loads lines of `canvasWidth shapeSize edgeCount rasterizer` (see `save()`),
+  //! classes not listed keep their current rasterizer. Returns `false` if the
+  //! file cannot be read or is invalid.
+  bool load(const char* fileName) noexcept;
+  bool save(const char* fileName) const noexcept;
+
+  uint8_t ids[kCanvasClassCount][kSizeClassCount][kEdgeClassCount];
 };
 
 // ============================================================================
@@ -100,6 +304,559 @@ public:
 
     kA8MaxI32   = static_cast<int>((1U << 31) / static_cast<unsigned int>(kA8Scale_2))
   };
+
+  //! Rasterizes a line into cells by calling `self._mergeCell()` for each cell
+  //! the line passes through. Shared by rasterizers that don't need to track
+  //! anything else than what their `_mergeCell()` already does (`A1`, `S4`,
+  //! `L1`, `TileRasterizer`, `RetainedRasterizer`, and `CellBlock`).
+  template<class Self, typename Fixed>
+  static void addLineT(Self& self, Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept;
+};
+
+// ============================================================================
+// [CellLayout]
+// ============================================================================
+
+//! Cells of a row stored as `Cell` pairs of cover and area (the default).
+struct CellLayoutAoS {
+  static inline void merge(Cell* row, size_t stride, size_t x, int cover, int area) noexcept {
+    (void)stride;
+    row[x].cover += cover;
+    row[x].area  += area;
+  }
+
+  static inline void clear(Cell* row, size_t stride, size_t x0, size_t x1) noexcept {
+    (void)stride;
+    std::memset(row + x0, 0, (x1 - x0) * sizeof(Cell));
+  }
+
+  template<bool NonZero, class Compositor>
+  static ALWAYS_INLINE void vmask(Compositor& compositor, uint32_t* dst, size_t x0, size_t x1, Cell* row, size_t stride, int& cover) noexcept {
+    (void)stride;
+    compositor.template vmask<NonZero>(dst, x0, x1, row, cover);
+  }
+};
+
+//! Cells of a row stored as a plane of `stride` covers followed by a plane of
+//! `stride` areas (`Rasterizer::kOptionSoA`). A row takes the same space as
+//! in `CellLayoutAoS`, so rasterizers allocate and address rows the same way.
+//! `vmaskSoA()` of `CompositorSIMD` then loads 4 covers and 4 areas directly
+//! instead of de-interleaving them, and clearing a range is two memsets.
+struct CellLayoutSoA {
+  static inline int32_t* covers(Cell* row) noexcept { return reinterpret_cast<int32_t*>(row); }
+  static inline int32_t* areas(Cell* row, size_t stride) noexcept { return reinterpret_cast<int32_t*>(row) + stride; }
+
+  static inline void merge(Cell* row, size_t stride, size_t x, int cover, int area) noexcept {
+    covers(row)[x] += cover;
+    areas(row, stride)[x] += area;
+  }
+
+  static inline void clear(Cell* row, size_t stride, size_t x0, size_t x1) noexcept {
+    std::memset(covers(row) + x0, 0, (x1 - x0) * sizeof(int32_t));
+    std::memset(areas(row, stride) + x0, 0, (x1 - x0) * sizeof(int32_t));
+  }
+
+  template<bool NonZero, class Compositor>
+  static ALWAYS_INLINE void vmask(Compositor& compositor, uint32_t* dst, size_t x0, size_t x1, Cell* row, size_t stride, int& cover) noexcept {
+    compositor.template vmaskSoA<NonZero>(dst, x0, x1, covers(row), areas(row, stride), cover);
+  }
+};
+
+// ============================================================================
+// [CellRasterizer - AddLine]
+// ============================================================================
+
+template<class Self, typename Fixed>
+void CellRasterizer::addLineT(Self& self, Fixed x0, Fixed y0, Fixed x1, Fixed y1) noexcept {
+  Fixed dx = x1 - x0;
+  Fixed dy = y1 - y0;
+
+  if (dy == Fixed(0))
+    return;
+
+  int cover = int(dy);
+  int area;
+
+  if (dx < 0) dx = -dx;
+  if (dy < 0) dy = -dy;
+
+  int yInc = 1;
+  int coverSign = 1;
+
+  // Fix RIGHT-TO-LEFT direction:
+  //   - swap coordinates,
+  //   - invert cover-sign.
+  if (x0 > x1) {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+    coverSign = -coverSign;
+  }
+
+  // Fix BOTTOM-TO-TOP direction:
+  //   - invert fractional parts of y0 and y1,
+  //   - invert cover-sign.
+  if (y0 > y1) {
+    y0 ^= kA8Mask;
+    y0 += int(y0 & kA8Mask) == kA8Mask ? 1 - kA8Scale * 2 : 1;
+    y1  = y0 + dy;
+
+    yInc = -1;
+    coverSign = -coverSign;
+  }
+
+  // Extract the raster and fractional coordinates.
+  int ex0 = int(x0 >> kA8Shift);
+  int fx0 = int(x0 & kA8Mask);
+
+  int ey0 = int(y0 >> kA8Shift);
+  int fy0 = int(y0 & kA8Mask);
+
+  int ex1 = int(x1 >> kA8Shift);
+  int fy1 = int(y1 & kA8Mask);
+
+  // NOTE: Variable `i` is just a loop counter. We need to make sure to handle
+  // the start and end points of the line, which use the same loop body, but
+  // require special handling.
+  //
+  //   - `i` - How many Y iterations to do now.
+  //   - `j` - How many Y iterations to do next.
+  int i = 1;
+  int j = int(y1 >> kA8Shift) - ey0;
+
+  // Single-Cell.
+  if ((j | ((fx0 + int(dx)) > 256)) == 0) {
+    self._mergeCell(ex0, ey0, cover, (fx0 * 2 + int(dx)) * cover);
+    return;
+  }
+
+  uint32_t ey1 = ey0 + (j + (fy1 != 0)) * yInc;
+
+  // Strictly horizontal line (always one cell per scanline).
+  if (dx == 0) {
+    if (j > 0)
+      cover = (kA8Scale - fy0) * coverSign;
+
+    fy0  = coverSign << kA8Shift;
+    fy1 *= coverSign;
+    fx0 *= 2;
+
+    for (;;) {
+      area = fx0 * cover;
+      do {
+        self._mergeCell(ex0, ey0, cover, area);
+        ey0 += yInc;
+      } while (--i);
+
+      if (ey0 == ey1)
+        break;
+
+      cover = fy1;
+      i = j;
+      j = 1;
+
+      if (i <= 1)
+        continue;
+
+      cover = fy0;
+      i--;
+    }
+
+    return;
+  }
+
+  Fixed xErr = -dy / 2, xBase, xLift, xRem, xDlt = dx;
+  Fixed yErr = -dx / 2, yBase, yLift, yRem, yDlt = dy;
+
+  xBase = dx * kA8Scale;
+  xLift = xBase / dy;
+  xRem  = xBase % dy;
+
+  yBase = dy * kA8Scale;
+  yLift = yBase / dx;
+  yRem  = yBase % dx;
+
+  if (j != 0) {
+    Fixed p = Fixed(kA8Scale - fy0) * dx;
+    xDlt  = p / dy;
+    xErr += p % dy;
+    fy1 = kA8Scale;
+  }
+
+  if (ex0 != ex1) {
+    Fixed p = Fixed(kA8Scale - fx0) * dy;
+    yDlt = p / dx;
+    yErr += p % dx;
+  }
+
+  // Vertical direction -> One/Two cells per scanline.
+  if (dy >= dx) {
+    int yAcc = int(y0) + int(yDlt);
+
+    goto VertSkip;
+    for (;;) {
+      do {
+        xDlt = xLift;
+        xErr += xRem;
+        if (xErr >= 0) { xErr -= dy; xDlt++; }
+
+VertSkip:
+        area = fx0;
+        fx0 += int(xDlt);
+
+        if (fx0 <= 256) {
+          cover = (fy1 - fy0) * coverSign;
+          area  = (area + fx0) * cover;
+          self._mergeCell(ex0, ey0, cover, area);
+
+          if (fx0 == 256) {
+            ex0++;
+            fx0 = 0;
+            goto VertAdvance;
+          }
+        }
+        else {
+          yAcc &= 0xFF;
+          fx0  &= kA8Mask;
+
+          cover = (yAcc - fy0) * coverSign;
+          area  = (area + kA8Scale) * cover;
+
+          self._mergeCell(ex0, ey0, cover, area);
+          ex0++;
+
+          cover = (fy1 - yAcc) * coverSign;
+          area  = fx0 * cover;
+          self._mergeCell(ex0, ey0, cover, area);
+
+VertAdvance:
+          yAcc += int(yLift);
+          yErr += yRem;
+          if (yErr >= 0) { yErr -= dx; yAcc++; }
+        }
+
+        ey0 += yInc;
+      } while (--i);
+
+      if (ey0 == ey1)
+        break;
+
+      i = j;
+      j = 1;
+
+      if (i > 1) {
+        fy0 = 0;
+        fy1 = kA8Scale;
+        i--;
+      }
+      else {
+        fy0 = 0;
+        fy1 = int(y1 & kA8Mask);
+
+        xDlt = x1 - (ex0 << 8) - fx0;
+        goto VertSkip;
+      }
+    }
+
+    return;
+  }
+  // Horizontal direction -> Two or more cells per scanline.
+  else {
+    int fx1;
+    int coverAcc = fy0;
+
+    cover = int(yDlt);
+    coverAcc += cover;
+
+    if (j != 0)
+      fy1 = kA8Scale;
+
+    if (fx0 + int(xDlt) > 256)
+      goto HorzInside;
+
+    x0 += xDlt;
+
+    cover = (fy1 - fy0) * coverSign;
+    area = (fx0 * 2 + int(xDlt)) * cover;
+
+HorzSingle:
+    self._mergeCell(ex0, ey0, cover, area);
+
+    ey0 += yInc;
+    if (ey0 == ey1)
+      return;
+
+    if (fx0 + int(xDlt) == 256) {
+      coverAcc += int(yLift);
+      yErr += yRem;
+      if (yErr >= 0) { yErr -= dx; coverAcc++; }
+    }
+
+    if (--i == 0)
+      goto HorzAfter;
+
+    for (;;) {
+      do {
+        xDlt = xLift;
+        xErr += xRem;
+        if (xErr >= 0) { xErr -= dy; xDlt++; }
+
+        ex0 = int(x0 >> kA8Shift);
+        fx0 = int(x0 & kA8Mask);
+
+HorzSkip:
+        coverAcc -= 256;
+        cover = coverAcc;
+        assert(cover >= 0 && cover <= 256);
+
+HorzInside:
+        x0 += xDlt;
+
+        ex1 = int(x0 >> kA8Shift);
+        fx1 = int(x0 & kA8Mask);
+        assert(ex0 != ex1);
+
+        if (fx1 == 0)
+          fx1 = kA8Scale;
+        else
+          ex1++;
+
+        area = (fx0 + kA8Scale) * cover;
+        while (ex0 != ex1 - 1) {
+          self._mergeCell(ex0, ey0, cover * coverSign, area * coverSign);
+
+          cover = int(yLift);
+          yErr += yRem;
+          if (yErr >= 0) { yErr -= dx; cover++; }
+
+          coverAcc += cover;
+          area  = kA8Scale * cover;
+
+          ex0++;
+        }
+
+        cover += fy1 - coverAcc;
+        area   = fx1 * cover;
+        self._mergeCell(ex0, ey0, cover * coverSign, area * coverSign);
+
+        if (fx1 == kA8Scale) {
+          coverAcc += int(yLift);
+          yErr += yRem;
+          if (yErr >= 0) { yErr -= dx; coverAcc++; }
+        }
+
+        ey0 += yInc;
+      } while (--i);
+
+      if (ey0 == ey1)
+        break;
+
+HorzAfter:
+      i = j;
+      j = 1;
+
+      if (i > 1) {
+        fy1 = kA8Scale;
+        i--;
+      }
+      else {
+        fy1 = int(y1 & kA8Mask);
+        xDlt = x1 - x0;
+
+        ex0 = int(x0 >> kA8Shift);
+        fx0 = int(x0 & kA8Mask);
+
+        if (fx0 + int(xDlt) <= 256) {
+          cover = fy1 * coverSign;
+          area = (fx0 * 2 + int(xDlt)) * cover;
+          goto HorzSingle;
+        }
+        else {
+          goto HorzSkip;
+        }
+      }
+    }
+
+    return;
+  }
+}
+
+// ============================================================================
+// [CellBlock]
+// ============================================================================
+
+//! Scratch block of 32x32 cells for tiny shapes (used by A2 and A3).
+//!
+//! While a rasterizer is empty, a polygon that fits in 32x32 pixels is
+//! rasterized into the block instead of the canvas sized cells, and so are
+//! next polygons that fit in the same block. `render()` then composites the
+//! rows of the block by constant length `vmask()` calls and clears them by
+//! constant size memsets, it doesn't touch bounds, bits, and cells of the
+//! rasterizer at all. A polygon that doesn't fit moves the block into the
+//! rasterizer (see `spillTo()`) and all other polygons go the usual way.
+class CellBlock {
+public:
+  enum : uint32_t {
+    kSize = 32,
+    //! A cell right of the last pixel receives cover of edges at `x == kSize`.
+    kStride = kSize + 1
+  };
+
+  inline CellBlock() noexcept
+    : _active(false),
+      _x(0),
+      _y(0),
+      _rowMask(0),
+      _xStart(kSize),
+      _xEnd(0) {
+    std::memset(_cells, 0, sizeof(_cells));
+  }
+
+  inline bool active() const noexcept { return _active; }
+
+  inline void _mergeCell(int x, int y, int cover, int area) noexcept {
+    assert(x >= 0 && x <= int(kSize));
+    assert(y >= 0 && y < int(kSize));
+
+    Cell& cell = _cells[y][x];
+    cell.cover += cover;
+    cell.area  += area;
+    _rowMask |= 1u << y;
+  }
+
+  //! Adds `poly` to the block if all its points are within it, and returns
+  //! `false` if they are not. An inactive block is placed at the top-left
+  //! pixel of `poly` if `canStart` is true (the rasterizer has no cells).
+  inline bool addPoly(const Point* poly, size_t count, bool canStart) noexcept {
+    int xMin = std::numeric_limits<int>::max();
+    int yMin = std::numeric_limits<int>::max();
+    int xMax = 0;
+    int yMax = 0;
+
+    for (size_t i = 0; i < count; i++) {
+      int x = static_cast<int>(poly[i].x * 256);
+      int y = static_cast<int>(poly[i].y * 256);
+
+      xMin = std::min(xMin, x);
+      yMin = std::min(yMin, y);
+      xMax = std::max(xMax, x);
+      yMax = std::max(yMax, y);
+    }
+
+    if (!_active) {
+      if (!canStart)
+        return false;
+      _x = xMin >> 8;
+      _y = yMin >> 8;
+    }
+
+    // Coordinates are translated by whole pixels, so cells are exactly the
+    // same as if the polygon was rasterized into the canvas.
+    int bx = _x << 8;
+    int by = _y << 8;
+
+    if (xMin < bx || yMin < by || xMax > bx + int(kSize << 8) || yMax > by + int(kSize << 8))
+      return false;
+
+    _active = true;
+    _xStart = std::min(_xStart, uint32_t(xMin - bx) >> 8);
+    _xEnd = std::max(_xEnd, (uint32_t(xMax - bx) + 255) >> 8);
+
+    int x0 = static_cast<int>(poly[0].x * 256) - bx;
+    int y0 = static_cast<int>(poly[0].y * 256) - by;
+
+    for (size_t i = 1; i < count; i++) {
+      int x1 = static_cast<int>(poly[i].x * 256) - bx;
+      int y1 = static_cast<int>(poly[i].y * 256) - by;
+
+      if (x0 != x1 || y0 != y1)
+        CellRasterizer::addLineT<CellBlock, int64_t>(*this, x0, y0, x1, y1);
+
+      x0 = x1;
+      y0 = y1;
+    }
+
+    return true;
+  }
+
+  //! Merges all cells of the block into `self` by `self._spillCell()` (which
+  //! must also update bounds or bits of `self`) and clears the block.
+  template<class Self>
+  inline void spillTo(Self& self) noexcept {
+    IntUtils::BitWordIterator<uint32_t> it(_rowMask);
+    while (it.hasNext()) {
+      uint32_t y = it.next();
+      Cell* row = _cells[y];
+
+      for (uint32_t x = 0; x < kStride; x++)
+        if (row[x].cover | row[x].area)
+          self._spillCell(_x + int(x), _y + int(y), row[x].cover, row[x].area);
+
+      std::memset(row, 0, sizeof(_cells[0]));
+    }
+
+    _active = false;
+    _rowMask = 0;
+    _xStart = kSize;
+    _xEnd = 0;
+  }
+
+  //! Composites all rows of the block into `dst` and clears the block.
+  template<class Compositor, bool NonZero>
+  inline void render(Compositor& compositor, Image& dst, RasterStats& stats) noexcept {
+    // Only columns of polygons added are composited. Pixels right and below
+    // the canvas have no cells, but the block can extend past the canvas.
+    size_t x0 = _xStart;
+    size_t x1 = std::min<size_t>(_xEnd, size_t(dst.width() - _x));
+    intptr_t stride = dst.stride();
+    uint8_t* dstBase = dst.data() + intptr_t(_y) * stride + intptr_t(_x) * 4;
+
+    IntUtils::BitWordIterator<uint32_t> it(_rowMask);
+    while (it.hasNext()) {
+      uint32_t y = it.next();
+      uint32_t* dstPix = reinterpret_cast<uint32_t*>(dstBase + intptr_t(y) * stride);
+      Cell* row = _cells[y];
+      int cover = 0;
+
+      if (x1 - x0 == kSize)
+        compositor.template vmask<NonZero, false>(dstPix, 0, kSize, row, cover);
+      else
+        compositor.template vmask<NonZero, false>(dstPix, x0, x1, row, cover);
+      std::memset(row, 0, sizeof(_cells[0]));
+
+      RAS_STATS_ADD(stats, vmaskSpans, 1);
+      RAS_STATS_ADD(stats, vmaskPixels, x1 - x0);
+      RAS_STATS_ADD(stats, rowsRendered, 1);
+    }
+    (void)stats;
+
+    _active = false;
+    _rowMask = 0;
+    _xStart = kSize;
+    _xEnd = 0;
+  }
+
+  //! Clears the block without compositing it.
+  inline void clear() noexcept {
+    IntUtils::BitWordIterator<uint32_t> it(_rowMask);
+    while (it.hasNext())
+      std::memset(_cells[it.next()], 0, sizeof(_cells[0]));
+
+    _active = false;
+    _rowMask = 0;
+    _xStart = kSize;
+    _xEnd = 0;
+  }
+
+  bool _active;
+  //! Position of the top-left cell of the block in the canvas.
+  int _x;
+  int _y;
+  //! Rows of the block that have cells.
+  uint32_t _rowMask;
+  //! Columns `[_xStart, _xEnd)` of the block covered by polygons added.
+  uint32_t _xStart;
+  uint32_t _xEnd;
+  Cell _cells[kSize][kStride];
 };
 
 #endif // _RASTERIZER_H
@@ -1,6 +1,13 @@
+#include "./cmdline.h"
+#include "./frame.h"
 #include "./globals.h"
+#include "./perfcounters.h"
 #include "./performance.h"
 #include "./rasterizer.h"
+#include "./scene.h"
+#include "./threadpool.h"
+#include "./trace.h"
+#include "./workload.h"
 
 // ============================================================================
 // [BenchParams]
@@ -29,69 +36,1014 @@ static const uint32_t benchOptions[] = {
   Rasterizer::kOptionSIMD
 };
 
+// Options of the rasterizer benchmark, the SoA layout only applies to A2 and A3.
+static const uint32_t rasterizerOptions[] = {
+  0,
+  Rasterizer::kOptionSIMD,
+  Rasterizer::kOptionSoA,
+  Rasterizer::kOptionSIMD | Rasterizer::kOptionSoA
+};
+
+static const char* optionsNameOf(uint32_t options) noexcept {
+  switch (options) {
+    case 0                                                 : return "scalar";
+    case Rasterizer::kOptionSIMD                           : return "simd";
+    case Rasterizer::kOptionSoA                            : return "scalar_soa";
+    case Rasterizer::kOptionSIMD | Rasterizer::kOptionSoA  : return "simd_soa";
+    default:
+      return "unknown";
+  }
+}
+
 // ============================================================================
-// [Main]
+// [BenchConfig]
 // ============================================================================
 
-int main(int argc, char* argv[]) {
+struct BenchConfig {
+  enum Format : uint32_t {
+    kFormatText = 0,
+    kFormatCsv = 1,
+    kFormatJson = 2
+  };
+
+  uint32_t repeats;
+  uint32_t format;
+  bool writeImages;
+  //! Reports time split into rasterizer phases instead of overall statistics.
+  bool phases;
+  //! Reports work counters of rasterizers per frame instead of timings.
+  bool stats;
+  //! Hardware performance counters, null if not used.
+  PerfCounters* counters;
+
+  //! Comma separated filters, null means everything.
+  const char* rasterizers;
+  const char* sizes;
+  const char* options;
+  const char* workloads;
+
+  //! Comma separated sweeps of the workload benchmark, null means defaults.
+  const char* vertexCounts;
+  const char* shapeSizes;
+
+  //! Canvas of the workload benchmark.
+  int canvasW;
+  int canvasH;
+};
+
+// Returns `true` if the comma separated `list` contains `name` (ignoring case)
+// or if there is no list at all.
+static bool listContains(const char* list, const char* name) {
+  if (!list)
+    return true;
+
+  size_t nameSize = strlen(name);
+  for (;;) {
+    const char* end = strchr(list, ',');
+    size_t size = end ? size_t(end - list) : strlen(list);
+
+    if (size == nameSize) {
+      size_t i = 0;
+      while (i < size && tolower((unsigned char)list[i]) == tolower((unsigned char)name[i]))
+        i++;
+      if (i == size)
+        return true;
+    }
+
+    if (!end)
+      return false;
+    list = end + 1;
+  }
+}
+
+// Parses the next number of a comma separated `list` and advances it, returns
+// `false` at the end of the list.
+static bool listNextNumber(const char*& list, double& value) {
+  if (!list || !*list)
+    return false;
+
+  char* end;
+  value = strtod(list, &end);
+  if (end == list)
+    return false;
+
+  list = *end == ',' ? end + 1 : end;
+  return true;
+}
+
+// ============================================================================
+// [BenchResult]
+// ============================================================================
+
+struct BenchResult {
+  char label[128];
+  const char* rasterizer;
+  const char* options;
+  const char* workload;
+
+  int w, h;
+  uint32_t vertexCount;
+  double shapeSize;
+  uint32_t quantity;
+
+  //! Pixels of bounding boxes of all shapes (clipped to the canvas).
+  double pixels;
+  PerformanceStats stats;
+  //! Performance counters summed over all repeats.
+  PerfCounters::Values counters;
+};
+
+static void printResultHeader(const BenchConfig& config) {
+  if (config.format == BenchConfig::kFormatCsv && config.stats)
+    printf("rasterizer,options,workload,width,height,vertices,shape_size,quantity,repeats,"
+           "cells_merged,bitwords_scanned,bitwords_nonempty,cmask_spans,cmask_pixels,"
+           "vmask_spans,vmask_pixels,rows_rendered,rows_skipped\n");
+  else if (config.format == BenchConfig::kFormatCsv && config.phases)
+    printf("rasterizer,options,workload,width,height,vertices,shape_size,quantity,repeats,"
+           "addpoly_ms,render_ms,clear_ms,other_ms\n");
+  else if (config.format == BenchConfig::kFormatCsv)
+    printf("rasterizer,options,workload,width,height,vertices,shape_size,quantity,repeats,"
+           "min_ms,median_ms,p95_ms,mean_ms,stddev_ms,mpix_per_s,polys_per_s%s\n",
+           config.counters ? ",cycles,instructions,ipc,l1d_misses_per_px,llc_misses_per_px,branch_misses_per_px" : "");
+  else if (config.format == BenchConfig::kFormatJson)
+    printf("[");
+}
+
+static void printResultFooter(const BenchConfig& config, uint32_t resultCount) {
+  if (config.format == BenchConfig::kFormatJson)
+    printf(resultCount ? "\n]\n" : "]\n");
+}
+
+// Prints `value` of a counter or `n/a` (text), an empty column (CSV), or
+// `null` (JSON) if the counter is not available.
+static void printCounter(const BenchConfig& config, const char* key, bool available, double value, const char* textFormat) {
+  switch (config.format) {
+    case BenchConfig::kFormatText:
+      printf(" [%s=", key);
+      if (available)
+        printf(textFormat, value);
+      else
+        printf("n/a");
+      printf("]");
+      break;
+
+    case BenchConfig::kFormatCsv:
+      if (available)
+        printf(",%.6f", value);
+      else
+        printf(",");
+      break;
+
+    case BenchConfig::kFormatJson:
+      if (available)
+        printf(", \"%s\": %.6f", key, value);
+      else
+        printf(", \"%s\": null", key);
+      break;
+  }
+}
+
+// Counters are reported per repeat, IPC and misses per pixel of shape bounding
+// boxes.
+static void printCounters(const BenchConfig& config, const BenchResult& r) {
+  const PerfCounters& counters = *config.counters;
+  const uint64_t* v = r.counters.value;
+
+  double repeats = double(std::max<size_t>(r.stats.count, 1));
+  double pixels = std::max(r.pixels, 1.0) * repeats;
+
+  bool hasCycles = counters.isAvailable(PerfCounters::kCycles);
+  bool hasInstructions = counters.isAvailable(PerfCounters::kInstructions);
+
+  if (config.format != BenchConfig::kFormatText) {
+    printCounter(config, "cycles", hasCycles, double(v[PerfCounters::kCycles]) / repeats, nullptr);
+    printCounter(config, "instructions", hasInstructions, double(v[PerfCounters::kInstructions]) / repeats, nullptr);
+  }
+
+  printCounter(config, config.format == BenchConfig::kFormatText ? "IPC" : "ipc", hasCycles && hasInstructions,
+               double(v[PerfCounters::kInstructions]) / std::max(double(v[PerfCounters::kCycles]), 1.0), "%.2f");
+
+  const char* const names[] = { "l1d_misses_per_px", "llc_misses_per_px", "branch_misses_per_px" };
+  const char* const textNames[] = { "L1D/px", "LLC/px", "br/px" };
+  const uint32_t ids[] = { PerfCounters::kL1DMisses, PerfCounters::kLLCMisses, PerfCounters::kBranchMisses };
+
+  for (uint32_t i = 0; i < 3; i++)
+    printCounter(config, config.format == BenchConfig::kFormatText ? textNames[i] : names[i],
+                 counters.isAvailable(ids[i]), double(v[ids[i]]) / pixels, "%.4f");
+}
+
+// Throughput is normalized to pixels of shape bounding boxes and to polygons
+// (each added, rendered and cleared).
+static void printResult(const BenchConfig& config, uint32_t resultIndex, const BenchResult& r) {
+  const PerformanceStats& stats = r.stats;
+
+  double seconds = std::max(stats.median, 1.0) * 1e-9;
+  double mpixPerSec = r.pixels / seconds * 1e-6;
+  double polysPerSec = double(r.quantity) / seconds;
+
+  switch (config.format) {
+    case BenchConfig::kFormatText:
+      printf("%-31s [q=%-6u] [min=%9.3f ms] [med=%9.3f ms] [p95=%9.3f ms] [sd=%7.3f ms] [%9.1f MPix/s] [%10.0f polys/s]",
+             r.label, r.quantity, stats.min * 1e-6, stats.median * 1e-6, stats.p95 * 1e-6, stats.stddev * 1e-6,
+             mpixPerSec, polysPerSec);
+      break;
+
+    case BenchConfig::kFormatCsv:
+      printf("%s,%s,%s,%d,%d,%u,%.2f,%u,%u,%.6f,%.6f,%.6f,%.6f,%.6f,%.3f,%.1f",
+             r.rasterizer, r.options, r.workload, r.w, r.h, r.vertexCount, r.shapeSize, r.quantity, unsigned(stats.count),
+             stats.min * 1e-6, stats.median * 1e-6, stats.p95 * 1e-6, stats.mean * 1e-6, stats.stddev * 1e-6,
+             mpixPerSec, polysPerSec);
+      break;
+
+    case BenchConfig::kFormatJson:
+      printf("%s\n  {\"rasterizer\": \"%s\", \"options\": \"%s\", \"workload\": \"%s\", \"width\": %d, \"height\": %d, "
+             "\"vertices\": %u, \"shape_size\": %.2f, \"quantity\": %u, \"repeats\": %u, "
+             "\"min_ms\": %.6f, \"median_ms\": %.6f, \"p95_ms\": %.6f, \"mean_ms\": %.6f, \"stddev_ms\": %.6f, "
+             "\"mpix_per_s\": %.3f, \"polys_per_s\": %.1f",
+             resultIndex ? "," : "", r.rasterizer, r.options, r.workload, r.w, r.h,
+             r.vertexCount, r.shapeSize, r.quantity, unsigned(stats.count),
+             stats.min * 1e-6, stats.median * 1e-6, stats.p95 * 1e-6, stats.mean * 1e-6, stats.stddev * 1e-6,
+             mpixPerSec, polysPerSec);
+      break;
+  }
+
+  if (config.counters)
+    printCounters(config, r);
+
+  printf(config.format == BenchConfig::kFormatJson ? "}" : "\n");
+}
+
+// Phase times are averages per repeat, `other` is the rest of the mean time of
+// a repeat (the benchmark loop and reading the clock).
+static void printPhaseResult(const BenchConfig& config, uint32_t resultIndex, const BenchResult& r, const PhaseTimers& timers) {
+  double repeats = double(std::max<size_t>(r.stats.count, 1));
+  double addPoly = double(timers.ns[PhaseTimers::kPhaseAddPoly]) / repeats * 1e-6;
+  double render = double(timers.ns[PhaseTimers::kPhaseRender]) / repeats * 1e-6;
+  double clear = double(timers.ns[PhaseTimers::kPhaseClear]) / repeats * 1e-6;
+  double total = r.stats.mean * 1e-6;
+  double other = std::max(total - addPoly - render - clear, 0.0);
+  double pct = 100.0 / std::max(total, 1e-9);
+
+  switch (config.format) {
+    case BenchConfig::kFormatText:
+      printf("%-31s [q=%-6u] [addPoly=%9.3f ms %5.1f%%] [render=%9.3f ms %5.1f%%] [clear=%9.3f ms %5.1f%%] [other=%8.3f ms]\n",
+             r.label, r.quantity, addPoly, addPoly * pct, render, render * pct, clear, clear * pct, other);
+      break;
+
+    case BenchConfig::kFormatCsv:
+      printf("%s,%s,%s,%d,%d,%u,%.2f,%u,%u,%.6f,%.6f,%.6f,%.6f\n",
+             r.rasterizer, r.options, r.workload, r.w, r.h, r.vertexCount, r.shapeSize, r.quantity, unsigned(r.stats.count),
+             addPoly, render, clear, other);
+      break;
+
+    case BenchConfig::kFormatJson:
+      printf("%s\n  {\"rasterizer\": \"%s\", \"options\": \"%s\", \"workload\": \"%s\", \"width\": %d, \"height\": %d, "
+             "\"vertices\": %u, \"shape_size\": %.2f, \"quantity\": %u, \"repeats\": %u, "
+             "\"addpoly_ms\": %.6f, \"render_ms\": %.6f, \"clear_ms\": %.6f, \"other_ms\": %.6f}",
+             resultIndex ? "," : "", r.rasterizer, r.options, r.workload, r.w, r.h,
+             r.vertexCount, r.shapeSize, r.quantity, unsigned(r.stats.count),
+             addPoly, render, clear, other);
+      break;
+  }
+}
+
+// Work counters are averages per frame (a repeat of the whole scene).
+static void printStatsResult(const BenchConfig& config, uint32_t resultIndex, const BenchResult& r, const RasterStats& stats) {
+  double repeats = double(std::max<size_t>(r.stats.count, 1));
+  double cellsMerged = double(stats.cellsMerged) / repeats;
+  double bitWordsScanned = double(stats.bitWordsScanned) / repeats;
+  double bitWordsNonEmpty = double(stats.bitWordsNonEmpty) / repeats;
+  double cmaskSpans = double(stats.cmaskSpans) / repeats;
+  double cmaskPixels = double(stats.cmaskPixels) / repeats;
+  double vmaskSpans = double(stats.vmaskSpans) / repeats;
+  double vmaskPixels = double(stats.vmaskPixels) / repeats;
+  double rowsRendered = double(stats.rowsRendered) / repeats;
+  double rowsSkipped = double(stats.rowsSkipped) / repeats;
+
+  switch (config.format) {
+    case BenchConfig::kFormatText:
+      printf("%-31s [q=%-6u] [cells=%10.0f] [words=%10.0f nonempty=%5.1f%%] [cmask=%8.0f spans %10.0f px] "
+             "[vmask=%8.0f spans %10.0f px] [rows=%8.0f skipped=%8.0f]\n",
+             r.label, r.quantity, cellsMerged,
+             bitWordsScanned, bitWordsNonEmpty * 100.0 / std::max(bitWordsScanned, 1.0),
+             cmaskSpans, cmaskPixels, vmaskSpans, vmaskPixels, rowsRendered, rowsSkipped);
+      break;
+
+    case BenchConfig::kFormatCsv:
+      printf("%s,%s,%s,%d,%d,%u,%.2f,%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+             r.rasterizer, r.options, r.workload, r.w, r.h, r.vertexCount, r.shapeSize, r.quantity, unsigned(r.stats.count),
+             cellsMerged, bitWordsScanned, bitWordsNonEmpty, cmaskSpans, cmaskPixels,
+             vmaskSpans, vmaskPixels, rowsRendered, rowsSkipped);
+      break;
+
+    case BenchConfig::kFormatJson:
+      printf("%s\n  {\"rasterizer\": \"%s\", \"options\": \"%s\", \"workload\": \"%s\", \"width\": %d, \"height\": %d, "
+             "\"vertices\": %u, \"shape_size\": %.2f, \"quantity\": %u, \"repeats\": %u, "
+             "\"cells_merged\": %.1f, \"bitwords_scanned\": %.1f, \"bitwords_nonempty\": %.1f, "
+             "\"cmask_spans\": %.1f, \"cmask_pixels\": %.1f, \"vmask_spans\": %.1f, \"vmask_pixels\": %.1f, "
+             "\"rows_rendered\": %.1f, \"rows_skipped\": %.1f}",
+             resultIndex ? "," : "", r.rasterizer, r.options, r.workload, r.w, r.h,
+             r.vertexCount, r.shapeSize, r.quantity, unsigned(r.stats.count),
+             cellsMerged, bitWordsScanned, bitWordsNonEmpty, cmaskSpans, cmaskPixels,
+             vmaskSpans, vmaskPixels, rowsRendered, rowsSkipped);
+      break;
+  }
+}
+
+// ============================================================================
+// [BenchScene]
+// ============================================================================
+
+static double scenePixels(const Scene& scene, int w, int h) {
+  double pixels = 0.0;
+  for (size_t i = 0; i < scene.shapeCount(); i++) {
+    const Scene::Shape& shape = scene.shapeAt(i);
+    int bw = std::min(shape.x1, w) - std::max(shape.x0, 0);
+    int bh = std::min(shape.y1, h) - std::max(shape.y0, 0);
+    if (bw > 0 && bh > 0)
+      pixels += double(bw) * double(bh);
+  }
+  return pixels;
+}
+
+// What a benchmark renders - either a scene, each shape of which is rendered
+// immediately (addPoly, render, clear), or a replayed trace.
+struct BenchSource {
+  explicit inline BenchSource(const Scene& scene) noexcept
+    : scene(&scene),
+      trace(nullptr) {}
+
+  explicit inline BenchSource(const TraceReader& trace) noexcept
+    : scene(nullptr),
+      trace(&trace) {}
+
+  void render(Rasterizer* ras) const {
+    if (trace) {
+      // A trace doesn't have to end by `clear()`, each repeat starts clean.
+      trace->replay(*ras);
+      ras->clear();
+      return;
+    }
+
+    const Scene::Contour* contours = scene->contours();
+    const Point* points = scene->points();
+
+    for (size_t i = 0; i < scene->shapeCount(); i++) {
+      const Scene::Shape& shape = scene->shapeAt(i);
+
+      for (uint32_t j = 0; j < shape.contourCount; j++) {
+        const Scene::Contour& contour = contours[shape.contourIndex + j];
+        ras->addPoly(points + contour.pointIndex, contour.pointCount);
+      }
+
+      ras->setFillMode(shape.fillMode);
+      ras->render(shape.argb32);
+      ras->clear();
+    }
+  }
+
+  const Scene* scene;
+  const TraceReader* trace;
+};
+
+// Renders `source` and appends the time of each repeat to `samples`.
+// Performance counters (if any) are summed over all repeats to `counterValues`.
+// A discarded warm-up render comes first, so the samples don't include page
+// faults of the image and cell storage or cold caches, and phase timers and
+// stats of `ras` only cover the timed repeats.
+static void benchSource(Rasterizer* ras, Image& image, const BenchSource& source, uint32_t repeats, PodArray<uint64_t>& samples,
+                        PerfCounters* counters, PerfCounters::Values& counterValues) {
+  samples.clear();
+  counterValues.reset();
+
+  image.fillAll(0xFF000000);
+  source.render(ras);
+
+  ras->resetPhaseTimers();
+  ras->resetStats();
+
+  for (uint32_t repeatIndex = 0; repeatIndex < repeats; repeatIndex++) {
+    image.fillAll(0xFF000000);
+
+    if (counters)
+      counters->start();
+
+    uint64_t startTime = Performance::getTimeNs();
+    source.render(ras);
+    samples.append(Performance::getTimeNs() - startTime);
+
+    if (counters) {
+      PerfCounters::Values values;
+      counters->stop(values);
+      for (uint32_t i = 0; i < PerfCounters::kCounterCount; i++)
+        counterValues.value[i] += values.value[i];
+    }
+  }
+}
+
+// Runs `source` by all rasterizers and options that pass the filters of
+// `config`. Fills `result.rasterizer`, `result.options`, and `result.stats`,
+// the rest is filled by the caller. Writes an image `<prefix>-<rasterizer>.bmp`
+// if enabled.
+static int benchRasterizersOnSource(const BenchConfig& config, const BenchSource& source, const char* prefix,
+                                    BenchResult& result, uint32_t& resultCount) {
+  PodArray<uint64_t> samples;
+  if (!samples.reserve(config.repeats)) {
+    printf("Out of memory\n");
+    return 1;
+  }
+
+  for (uint32_t rasterizerId = 0; rasterizerId < Rasterizer::kIdCount; rasterizerId++) {
+    for (uint32_t optionId = 0; optionId < uint32_t(ARRAY_SIZE(rasterizerOptions)); optionId++) {
+      uint32_t options = rasterizerOptions[optionId];
+      const char* optionsName = optionsNameOf(options);
+
+      // SIMD is only useful in our experiments.
+      if (rasterizerId == Rasterizer::kIdAGG && (options & Rasterizer::kOptionSIMD))
+        continue;
+
+      if (!listContains(config.options, optionsName))
+        continue;
+
+      Image image;
+      image.create(result.w, result.h);
+
+      Rasterizer* ras = Rasterizer::newById(image, rasterizerId, options);
+      if (!ras) {
+        printf("Out of memory\n");
+        return 1;
+      }
+
+      // Rasterizers without the SoA layout would just repeat the AoS run.
+      if (ras->options() != options) {
+        delete ras;
+        continue;
+      }
+
+      // Filters match either the base name (all options) or the full name.
+      char baseName[64];
+      std::snprintf(baseName, ARRAY_SIZE(baseName), "%s", ras->name());
+      if (char* suffix = strchr(baseName, '_'))
+        *suffix = '\0';
+
+      if (!listContains(config.rasterizers, baseName) && !listContains(config.rasterizers, ras->name())) {
+        delete ras;
+        continue;
+      }
+
+      benchSource(ras, image, source, config.repeats, samples, config.counters, result.counters);
+
+      char label[128];
+      std::snprintf(label, ARRAY_SIZE(label), "%s-%s", prefix, ras->name());
+
+      std::snprintf(result.label, ARRAY_SIZE(result.label), "%s", label);
+      result.rasterizer = ras->name();
+      result.options = optionsName;
+      result.stats.compute(samples.data(), samples.size());
+
+      if (config.stats)
+        printStatsResult(config, resultCount++, result, ras->stats());
+      else if (config.phases)
+        printPhaseResult(config, resultCount++, result, ras->phaseTimers());
+      else
+        printResult(config, resultCount++, result);
+
+      if (config.writeImages) {
+        char fileName[160];
+        std::snprintf(fileName, ARRAY_SIZE(fileName), "%s.bmp", label);
+
+        if (!image.writeBmp(fileName)) {
+          printf("Cannot open file '%s' for writing\n", fileName);
+          delete ras;
+          return 1;
+        }
+      }
+
+      delete ras;
+    }
+  }
+
+  return 0;
+}
+
+// ============================================================================
+// [BenchRasterizers]
+// ============================================================================
+
+// Random polygons spanning the whole canvas rendered into canvases of various
+// sizes.
+static int benchRasterizers(const BenchConfig& config) {
   uint32_t baseQuantity = 100;
-  uint32_t numRepeats = 3;
-  uint32_t numPoints = 5;
+  uint32_t resultCount = 0;
+  Scene scene;
+
+  printResultHeader(config);
 
   for (uint32_t benchId = 0; benchId < uint32_t(ARRAY_SIZE(benchParams)); benchId++) {
-    for (uint32_t rasterizerId = 0; rasterizerId < Rasterizer::kIdCount; rasterizerId++) {
-      for (uint32_t optionId = 0; optionId < uint32_t(ARRAY_SIZE(benchOptions)); optionId++) {
-        const BenchParams& params = benchParams[benchId];
-        uint32_t options = benchOptions[optionId];
+    const BenchParams& params = benchParams[benchId];
 
-        // SIMD is only useful in our experiments.
-        if (rasterizerId == Rasterizer::kIdAGG && (options & Rasterizer::kOptionSIMD))
-          continue;
+    char sizeName[32];
+    std::snprintf(sizeName, ARRAY_SIZE(sizeName), "%dx%d", params.w, params.h);
+    if (!listContains(config.sizes, sizeName))
+      continue;
 
-        Image image;
-        Random rnd;
-        Point poly[128];
+    Workload::Params wp;
+    wp.id = Workload::kIdRandom;
+    wp.w = params.w;
+    wp.h = params.h;
+    wp.quantity = uint32_t(double(baseQuantity) * params.factor);
+    wp.vertexCount = 5;
+
+    if (!Workload::generate(scene, wp)) {
+      printf("Out of memory\n");
+      return 1;
+    }
+
+    BenchResult result;
+    result.workload = Workload::nameOf(wp.id);
+    result.w = params.w;
+    result.h = params.h;
+    result.vertexCount = wp.vertexCount;
+    result.shapeSize = 0.0;
+    result.quantity = wp.quantity;
+    result.pixels = scenePixels(scene, params.w, params.h);
+
+    char prefix[64];
+    std::snprintf(prefix, ARRAY_SIZE(prefix), "Bench_%04dx%04d", params.w, params.h);
+
+    if (benchRasterizersOnSource(config, BenchSource(scene), prefix, result, resultCount) != 0)
+      return 1;
+
+    if (config.format == BenchConfig::kFormatText)
+      printf("\n");
+  }
+
+  printResultFooter(config, resultCount);
+  return 0;
+}
+
+// ============================================================================
+// [BenchWorkloads]
+// ============================================================================
+
+static const double workloadSweepSizes[] = { 4.0, 16.0, 64.0, 256.0 };
+static const double workloadSweepVertices[] = { 8.0, 32.0, 128.0, 512.0, 2048.0 };
+
+// Roughly the same amount of work for each point of a sweep - cells are
+// proportional to the number of edges and compositing to the area.
+static uint32_t workloadQuantity(uint32_t id, uint32_t vertexCount, double size) {
+  double area = (id == Workload::kIdHLines || id == Workload::kIdVLines) ? size : size * size;
+  double edges = double(vertexCount) * (id == Workload::kIdOverlapping ? size : 8.0);
+  double quantity = 4e6 / (edges + area);
+  return uint32_t(std::min(std::max(quantity, 16.0), 100000.0));
+}
+
+static int benchWorkload(const BenchConfig& config, uint32_t id, uint32_t vertexCount, double size,
+                         Scene& scene, uint32_t& resultCount) {
+  Workload::Params wp;
+  wp.id = id;
+  wp.w = config.canvasW;
+  wp.h = config.canvasH;
+  wp.vertexCount = vertexCount ? vertexCount : Workload::defaultVertexCount(id);
+  wp.size = size > 0.0 ? size : Workload::defaultSize(id, wp.w, wp.h);
+  wp.quantity = workloadQuantity(id, wp.vertexCount, wp.size);
+
+  if (!Workload::generate(scene, wp)) {
+    printf("Out of memory\n");
+    return 1;
+  }
+
+  BenchResult result;
+  result.workload = Workload::nameOf(id);
+  result.w = wp.w;
+  result.h = wp.h;
+  result.vertexCount = wp.vertexCount;
+  result.shapeSize = wp.size;
+  result.quantity = wp.quantity;
+  result.pixels = scenePixels(scene, wp.w, wp.h);
+
+  char prefix[64];
+  std::snprintf(prefix, ARRAY_SIZE(prefix), "%s_v%u_s%g", result.workload, wp.vertexCount, wp.size);
+
+  int err = benchRasterizersOnSource(config, BenchSource(scene), prefix, result, resultCount);
+  if (!err && config.format == BenchConfig::kFormatText)
+    printf("\n");
+  return err;
+}
+
+// Each workload is swept over shape sizes (with the default number of
+// vertices) and, if it's scaled by vertices, over vertex counts (with the
+// default size).
+static int benchWorkloads(const BenchConfig& config) {
+  uint32_t resultCount = 0;
+  Scene scene;
+
+  printResultHeader(config);
+
+  for (uint32_t id = 0; id < Workload::kIdCount; id++) {
+    if (!listContains(config.workloads, Workload::nameOf(id)))
+      continue;
+
+    double value;
+
+    if (Workload::hasSize(id)) {
+      if (config.shapeSizes) {
+        const char* list = config.shapeSizes;
+        while (listNextNumber(list, value))
+          if (benchWorkload(config, id, 0, value, scene, resultCount) != 0)
+            return 1;
+      }
+      else {
+        for (size_t i = 0; i < ARRAY_SIZE(workloadSweepSizes); i++)
+          if (benchWorkload(config, id, 0, workloadSweepSizes[i], scene, resultCount) != 0)
+            return 1;
+      }
+    }
+
+    if (Workload::hasVertexCount(id)) {
+      if (config.vertexCounts) {
+        const char* list = config.vertexCounts;
+        while (listNextNumber(list, value))
+          if (benchWorkload(config, id, uint32_t(std::max(value, 3.0)), 0.0, scene, resultCount) != 0)
+            return 1;
+      }
+      else {
+        for (size_t i = 0; i < ARRAY_SIZE(workloadSweepVertices); i++)
+          if (benchWorkload(config, id, uint32_t(workloadSweepVertices[i]), 0.0, scene, resultCount) != 0)
+            return 1;
+      }
+    }
+  }
+
+  printResultFooter(config, resultCount);
+  return 0;
+}
+
+// ============================================================================
+// [BenchTrace]
+// ============================================================================
+
+// Replays a recorded trace (see `TraceRecorder`) by all rasterizers. Each
+// rasterizer gets a canvas of the size the trace was recorded on.
+static int benchTrace(const BenchConfig& config, const char* fileName) {
+  TraceReader trace;
+  if (!trace.open(fileName)) {
+    printf("Cannot open trace '%s' (missing, truncated, or invalid)\n", fileName);
+    return 1;
+  }
+
+  uint32_t resultCount = 0;
+  printResultHeader(config);
+
+  BenchResult result;
+  result.workload = "trace";
+  result.w = trace.width();
+  result.h = trace.height();
+  result.vertexCount = 0;
+  result.shapeSize = 0.0;
+  result.quantity = uint32_t(std::min<uint64_t>(trace.renderCount(), 0xFFFFFFFFu));
+  result.pixels = trace.pixels();
+
+  char prefix[64];
+  std::snprintf(prefix, ARRAY_SIZE(prefix), "Trace_%04dx%04d", result.w, result.h);
 
-        image.create(params.w, params.h);
-        Rasterizer* ras = Rasterizer::newById(image, rasterizerId, options);
+  if (benchRasterizersOnSource(config, BenchSource(trace), prefix, result, resultCount) != 0)
+    return 1;
 
-        double dw = double(params.w - 1);
-        double dh = double(params.h - 1);
-        uint32_t quantity = uint32_t(double(baseQuantity) * params.factor);
+  printResultFooter(config, resultCount);
+  return 0;
+}
+
+// ============================================================================
+// [BenchCalibrate]
+// ============================================================================
 
-        Performance perf;
+// Canvases of the calibration are at most this tall, shapes that don't fit
+// are not measured and use the rasterizer of the largest measured size.
+static const int calibrateMaxHeight = 1024;
 
-        for (uint32_t repeatIndex = 0; repeatIndex < numRepeats; repeatIndex++) {
-          rnd.rewind();
-          image.fillAll(0xFF000000);
+// Measures circles of each class of `AutoProfile` by all rasterizers that pass
+// the filters and saves the fastest ones to `fileName`, which can be loaded by
+// `--auto-profile=FILE` (the calibrated profile is also used by this run).
+static int benchCalibrate(const BenchConfig& config, const char* fileName) {
+  uint32_t options = listContains(config.options, "simd") ? uint32_t(Rasterizer::kOptionSIMD) : 0u;
 
-          perf.start();
-          for (uint32_t i = 0; i < quantity; i++) {
-            uint32_t argb32 = rnd.nextUInt32() | 0xFF000000U;
+  AutoProfile profile;
+  profile.resetToDefault();
 
-            for (uint32_t j = 0; j < numPoints; j++) {
-              poly[j].x = rnd.nextDouble() * dw;
-              poly[j].y = rnd.nextDouble() * dh;
-            }
+  Scene scene;
+  PodArray<uint64_t> samples;
+  if (!samples.reserve(config.repeats)) {
+    printf("Out of memory\n");
+    return 1;
+  }
 
-            poly[numPoints] = poly[0];
-            ras->addPoly(poly, numPoints + 1);
-            ras->render(argb32);
-            ras->clear();
+  for (uint32_t c = 0; c < AutoProfile::kCanvasClassCount; c++) {
+    int w = AutoProfile::canvasOfClass(c);
+    int h = std::min(w, calibrateMaxHeight);
+
+    Image image;
+    if (!image.create(w, h)) {
+      printf("Out of memory\n");
+      return 1;
+    }
+
+    uint32_t lastSizeClass = 0;
+    for (uint32_t s = 0; s < AutoProfile::kSizeClassCount && AutoProfile::sizeOfClass(s) <= h; s++) {
+      int size = AutoProfile::sizeOfClass(s);
+      lastSizeClass = s;
+
+      for (uint32_t e = 0; e < AutoProfile::kEdgeClassCount; e++) {
+        Workload::Params wp;
+        wp.id = Workload::kIdCircles;
+        wp.w = w;
+        wp.h = h;
+        wp.quantity = uint32_t(std::min(std::max((1 << 20) / (size * size), 4), 256));
+        wp.vertexCount = AutoProfile::edgesOfClass(e);
+        wp.size = double(size);
+        wp.seed = 0x5EED + c * 1000 + s * 10 + e;
+
+        if (!Workload::generate(scene, wp)) {
+          printf("Out of memory\n");
+          return 1;
+        }
+
+        uint32_t bestId = Rasterizer::kIdCount;
+        double bestTime = 0.0;
+
+        printf("Calibrate_%04dx%04d_s%d_e%u", w, h, size, wp.vertexCount);
+        for (uint32_t id = 0; id < Rasterizer::kIdAuto; id++) {
+          if (!listContains(config.rasterizers, Rasterizer::nameOf(id)))
+            continue;
+
+          Rasterizer* ras = Rasterizer::newById(image, id, options);
+          if (!ras) {
+            printf("\nOut of memory\n");
+            return 1;
+          }
+
+          PerfCounters::Values counterValues;
+          benchSource(ras, image, BenchSource(scene), config.repeats, samples, nullptr, counterValues);
+          delete ras;
+
+          PerformanceStats stats;
+          stats.compute(samples.data(), samples.size());
+          printf(" %s=%.3f", Rasterizer::nameOf(id), stats.median * 1e-6);
+
+          if (bestId == Rasterizer::kIdCount || stats.median < bestTime) {
+            bestId = id;
+            bestTime = stats.median;
           }
-          perf.end();
         }
 
-        char fileName[128];
-        std::snprintf(fileName, ARRAY_SIZE(fileName), "Bench_%04dx%04d-%s.bmp", image.width(), image.height(), ras->name());
-        delete ras;
+        if (bestId == Rasterizer::kIdCount) {
+          printf("\nNo rasterizer to calibrate\n");
+          return 1;
+        }
 
-        if (!image.writeBmp(fileName)) {
-          printf("Cannot open file '%s' for writing\n", fileName);
+        printf(" -> %s\n", Rasterizer::nameOf(bestId));
+        profile.ids[c][s][e] = uint8_t(bestId);
+      }
+    }
+
+    for (uint32_t s = lastSizeClass + 1; s < AutoProfile::kSizeClassCount; s++)
+      for (uint32_t e = 0; e < AutoProfile::kEdgeClassCount; e++)
+        profile.ids[c][s][e] = profile.ids[c][lastSizeClass][e];
+  }
+
+  if (!profile.save(fileName)) {
+    printf("Cannot write profile '%s'\n", fileName);
+    return 1;
+  }
+
+  AutoProfile::global() = profile;
+  return 0;
+}
+
+// ============================================================================
+// [BenchTiles]
+// ============================================================================
+
+// Canvases of the tile renderer benchmarks (`--threads`, `--occlusion`, and
+// `--damage`).
+static const BenchParams tileParams[] = {
+  { 1920, 1080 , 4.0   },
+  { 3840, 2160 , 1.0   }
+};
+
+static const char* tileOptionsName(uint32_t options) noexcept {
+  return (options & Rasterizer::kOptionSIMD) ? "SIMD" : "Scalar";
+}
+
+// Builds the scene of a tile renderer benchmark for a `w` x `h` canvas.
+typedef void (*TileSceneBuilder)(Scene& scene, int w, int h);
+
+// Creates the canvas of `params`, builds its scene by `build` (if any), and
+// reserves `sampleCount` samples.
+static bool setupTileBench(const BenchParams& params, TileSceneBuilder build, uint32_t sampleCount,
+                           Image& image, Scene& scene, PodArray<uint64_t>& samples) {
+  if (!image.create(params.w, params.h) || !samples.reserve(sampleCount))
+    return false;
+
+  if (build)
+    build(scene, params.w, params.h);
+  return true;
+}
+
+// Renders `scene` into `image` cleared to black `repeats` times after one
+// discarded warm-up render, which also allocates the bins and per-worker
+// storage of `renderer`. Stats of `renderer` are those of the last render.
+static bool timeTileRenderer(TileRenderer& renderer, Image& image, const Scene& scene, uint32_t repeats,
+                             PodArray<uint64_t>& samples, PerformanceStats& stats) {
+  samples.clear();
+
+  for (uint32_t repeatIndex = 0; repeatIndex <= repeats; repeatIndex++) {
+    image.fillAll(0xFF000000);
+    renderer.resetStats();
+
+    uint64_t startTime = Performance::getTimeNs();
+    if (!renderer.render(scene))
+      return false;
+    uint64_t duration = Performance::getTimeNs() - startTime;
+
+    if (repeatIndex != 0)
+      samples.append(duration);
+  }
+
+  stats.compute(samples.data(), samples.size());
+  return true;
+}
+
+// ============================================================================
+// [BenchThreads]
+// ============================================================================
+
+// Many small shapes and a few large ones.
+static void buildThreadsScene(Scene& scene, int w, int h) {
+  uint32_t numPoints = 5;
+  uint32_t numSmall = 20000;
+  uint32_t numLarge = 20;
+
+  Random rnd;
+  Point poly[16];
+
+  double dw = double(w - 1);
+  double dh = double(h - 1);
+
+  for (uint32_t i = 0; i < numSmall + numLarge; i++) {
+    uint32_t argb32 = rnd.nextUInt32() | 0xFF000000U;
+
+    if (i < numSmall) {
+      double size = 4.0 + rnd.nextDouble() * 60.0;
+      double x = rnd.nextDouble() * (dw - size);
+      double y = rnd.nextDouble() * (dh - size);
+
+      for (uint32_t j = 0; j < numPoints; j++) {
+        poly[j].x = x + rnd.nextDouble() * size;
+        poly[j].y = y + rnd.nextDouble() * size;
+      }
+    }
+    else {
+      for (uint32_t j = 0; j < numPoints; j++) {
+        poly[j].x = rnd.nextDouble() * dw;
+        poly[j].y = rnd.nextDouble() * dh;
+      }
+    }
+
+    scene.addPoly(poly, numPoints);
+    scene.fill(argb32, Rasterizer::kFillNonZero);
+  }
+}
+
+// Renders the threads scene by `TileRenderer` using 1 to `maxThreads` workers
+// and reports the speedup of the median time over one worker.
+static int benchThreads(uint32_t maxThreads) {
+  uint32_t numRepeats = 5;
+
+  for (uint32_t benchId = 0; benchId < uint32_t(ARRAY_SIZE(tileParams)); benchId++) {
+    Image image;
+    Scene scene;
+    PodArray<uint64_t> samples;
+
+    if (!setupTileBench(tileParams[benchId], buildThreadsScene, numRepeats, image, scene, samples)) {
+      printf("Out of memory\n");
+      return 1;
+    }
+
+    for (uint32_t optionId = 0; optionId < uint32_t(ARRAY_SIZE(benchOptions)); optionId++) {
+      uint32_t options = benchOptions[optionId];
+      double baseTime = 0.0;
+
+      for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount++) {
+        ThreadPool pool(threadCount);
+        TileRenderer renderer(image, options, TileRenderer::kDefaultTileSize, &pool);
+        PerformanceStats stats;
+
+        if (!timeTileRenderer(renderer, image, scene, numRepeats, samples, stats)) {
+          printf("Out of memory\n");
           return 1;
         }
 
-        printf("%-31s [q=%-6u] [%-4u ms]\n", fileName, quantity, perf.best);
+        if (threadCount == 1) {
+          baseTime = stats.median;
+
+          char fileName[128];
+          std::snprintf(fileName, ARRAY_SIZE(fileName), "Threads_%04dx%04d-%s.bmp",
+                        image.width(), image.height(), tileOptionsName(options));
+
+          if (!image.writeBmp(fileName)) {
+            printf("Cannot open file '%s' for writing\n", fileName);
+            return 1;
+          }
+        }
+
+        double speedup = baseTime / stats.median;
+        printf("Threads %04dx%04d %-6s [t=%-2u] [min=%8.3f ms] [med=%8.3f ms] [speedup=%5.2fx] [efficiency=%5.1f%%]\n",
+               image.width(), image.height(), tileOptionsName(options), threadCount,
+               stats.min * 1e-6, stats.median * 1e-6, speedup, speedup * 100.0 / double(threadCount));
+      }
+      printf("\n");
+    }
+  }
+
+  return 0;
+}
+
+// ============================================================================
+// [BenchOcclusion]
+// ============================================================================
+
+// Layers of large overlapping fills (like land and water of a map).
+static void buildOcclusionScene(Scene& scene, int w, int h) {
+  uint32_t numLayers = 8;
+  uint32_t numShapesPerLayer = 50;
+
+  Random rnd;
+  Point poly[16];
+
+  double dw = double(w - 1);
+  double dh = double(h - 1);
+
+  for (uint32_t layer = 0; layer < numLayers; layer++) {
+    // Each layer starts with a fill of the whole canvas.
+    Point background[] = { { 0.0, 0.0 }, { dw, 0.0 }, { dw, dh }, { 0.0, dh } };
+    scene.addPoly(background, 4);
+    scene.fill(rnd.nextUInt32() | 0xFF000000U, Rasterizer::kFillNonZero);
+
+    for (uint32_t i = 0; i < numShapesPerLayer; i++) {
+      double size = 100.0 + rnd.nextDouble() * dw * 0.25;
+      double x = rnd.nextDouble() * (dw - size);
+      double y = rnd.nextDouble() * (dh - size);
+
+      uint32_t numPoints = 8;
+      for (uint32_t j = 0; j < numPoints; j++) {
+        double a = double(j) * 6.283185307179586 / double(numPoints);
+        double r = size * (0.35 + rnd.nextDouble() * 0.15);
+        poly[j].x = x + size * 0.5 + std::cos(a) * r;
+        poly[j].y = y + size * 0.5 + std::sin(a) * r;
+      }
+
+      scene.addPoly(poly, numPoints);
+      scene.fill(rnd.nextUInt32() | 0xFF000000U, Rasterizer::kFillNonZero);
+    }
+  }
+}
+
+// Renders the occlusion scene with and without occlusion culling and reports
+// the overdraw saved.
+static int benchOcclusion() {
+  uint32_t numRepeats = 5;
+
+  for (uint32_t benchId = 0; benchId < uint32_t(ARRAY_SIZE(tileParams)); benchId++) {
+    Image image;
+    Scene scene;
+    PodArray<uint64_t> samples;
+
+    if (!setupTileBench(tileParams[benchId], buildOcclusionScene, numRepeats, image, scene, samples)) {
+      printf("Out of memory\n");
+      return 1;
+    }
+
+    for (uint32_t optionId = 0; optionId < uint32_t(ARRAY_SIZE(benchOptions)); optionId++) {
+      uint32_t options = benchOptions[optionId];
+
+      for (uint32_t culling = 0; culling < 2; culling++) {
+        TileRenderer renderer(image, options);
+        renderer.setOcclusionCulling(culling != 0);
+        PerformanceStats perf;
+
+        if (!timeTileRenderer(renderer, image, scene, numRepeats, samples, perf)) {
+          printf("Out of memory\n");
+          return 1;
+        }
+
+        TileRenderer::Stats stats = renderer.stats();
+        printf("Occlusion %04dx%04d %-6s [culling=%-3s] [min=%8.3f ms] [med=%8.3f ms] [culled=%llu/%llu shape-tiles] [saved=%llu px]\n",
+               image.width(), image.height(), tileOptionsName(options), culling ? "on" : "off",
+               perf.min * 1e-6, perf.median * 1e-6,
+               (unsigned long long)stats.culledShapeTiles,
+               (unsigned long long)stats.shapeTiles,
+               (unsigned long long)(stats.culledPixels + stats.occludedPixels));
       }
     }
     printf("\n");
@@ -99,3 +1051,259 @@ int main(int argc, char* argv[]) {
 
   return 0;
 }
+
+// ============================================================================
+// [BenchDamage]
+// ============================================================================
+
+// Builds a UI-like frame - a grid of widgets, each having a background and
+// a few glyph-like shapes. Only one widget is highlighted per frame.
+static void buildUiFrame(Scene& scene, int w, int h, uint32_t frameIndex) {
+  Random rnd;
+  uint32_t widgetIndex = 0;
+
+  scene.clear();
+  for (int y = 0; y + 40 <= h; y += 48) {
+    for (int x = 0; x + 120 <= w; x += 128, widgetIndex++) {
+      bool hot = widgetIndex % 101 == frameIndex % 101;
+      double wx = double(x) + 2.5;
+      double wy = double(y) + 2.5;
+
+      Point widget[] = { { wx, wy }, { wx + 118.0, wy }, { wx + 118.0, wy + 40.0 }, { wx, wy + 40.0 } };
+      scene.addPoly(widget, 4);
+      scene.fill(hot ? 0xFF3060F0U : 0xFFE0E0E0U, Rasterizer::kFillNonZero);
+
+      for (int i = 0; i < 6; i++) {
+        double gx = wx + 8.0 + double(i) * 16.0 + rnd.nextDouble();
+        double gy = wy + 12.0;
+
+        Point glyph[] = { { gx, gy }, { gx + 10.0, gy + 2.0 }, { gx + 5.0, gy + 14.0 } };
+        scene.addPoly(glyph, 3);
+        scene.fill(hot ? 0xFFFFFFFFU : 0xFF202020U, Rasterizer::kFillNonZero);
+      }
+    }
+  }
+}
+
+// Renders a sequence of UI frames completely and incrementally. Each frame is
+// a sample, building its scene is not timed. Frame 0 is a discarded warm-up,
+// which `FrameRenderer` always renders completely.
+static int benchDamage() {
+  uint32_t numFrames = 200;
+
+  for (uint32_t benchId = 0; benchId < uint32_t(ARRAY_SIZE(tileParams)); benchId++) {
+    const BenchParams& params = tileParams[benchId];
+
+    for (uint32_t optionId = 0; optionId < uint32_t(ARRAY_SIZE(benchOptions)); optionId++) {
+      uint32_t options = benchOptions[optionId];
+
+      for (uint32_t incremental = 0; incremental < 2; incremental++) {
+        Image image;
+        Scene scene;
+        PodArray<uint64_t> samples;
+
+        if (!setupTileBench(params, nullptr, numFrames, image, scene, samples)) {
+          printf("Out of memory\n");
+          return 1;
+        }
+
+        TileRenderer fullRenderer(image, options);
+        FrameRenderer frameRenderer(image, options, 0xFFFFFFFFU);
+        fullRenderer.setBackground(0xFFFFFFFFU);
+
+        uint64_t damagedTiles = 0;
+        uint64_t allTiles = 0;
+
+        for (uint32_t frameIndex = 0; frameIndex <= numFrames; frameIndex++) {
+          buildUiFrame(scene, params.w, params.h, frameIndex);
+
+          uint64_t startTime = Performance::getTimeNs();
+          bool ok = incremental ? frameRenderer.render(scene) : fullRenderer.render(scene);
+          uint64_t duration = Performance::getTimeNs() - startTime;
+
+          if (!ok) {
+            printf("Out of memory\n");
+            return 1;
+          }
+
+          if (frameIndex == 0)
+            continue;
+
+          samples.append(duration);
+          if (incremental) {
+            damagedTiles += frameRenderer.damagedTileCount();
+            allTiles += frameRenderer.tileCount();
+          }
+        }
+
+        PerformanceStats stats;
+        stats.compute(samples.data(), samples.size());
+
+        printf("Damage %04dx%04d %-6s [%-11s] [frames=%u] [total=%9.3f ms] [med=%7.3f ms/frame] [tiles rendered=%5.1f%%]\n",
+               image.width(), image.height(), tileOptionsName(options), incremental ? "incremental" : "full",
+               numFrames, stats.mean * double(stats.count) * 1e-6, stats.median * 1e-6,
+               incremental ? double(damagedTiles) * 100.0 / double(allTiles) : 100.0);
+      }
+    }
+    printf("\n");
+  }
+
+  return 0;
+}
+
+// ============================================================================
+// [Main]
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+  CmdLine cmd(argc, argv);
+
+  if (cmd.hasKey("--help")) {
+    printf("Usage: render_bench [--threads[=N]] [--occlusion] [--damage] [options]\n");
+    printf("  --phases       Time split into addPoly, render, and clear of rasterizers\n");
+    printf("                 (requires a build with -DRAS_PHASE_TIMERS=ON)\n");
+    printf("  --stats        Cells, BitWords, spans, and rows processed by rasterizers\n");
+    printf("                 per frame (requires a build with -DRAS_STATS=ON)\n");
+    printf("  --threads[=N]  Thread scaling of TileRenderer from 1 to N workers\n");
+    printf("                 (defaults to the number of hardware threads)\n");
+    printf("  --occlusion    Overdraw saved by occlusion culling of TileRenderer\n");
+    printf("  --damage       Full vs incremental (FrameRenderer) redraw of UI frames\n");
+    printf("\n");
+    printf("Options of the rasterizer benchmark (the default mode):\n");
+    printf("  --repeats=N          Number of timed repeats (default 5)\n");
+    printf("  --format=F           Output format - text, csv, or json\n");
+    printf("  --rasterizers=A,B    Rasterizers to run (for example AGG,A3x8,S4_SIMD)\n");
+    printf("  --sizes=WxH,...      Canvas sizes to run (for example 64x64,1920x1080)\n");
+    printf("  --options=O,...      Options to run - scalar, simd, scalar_soa, simd_soa\n");
+    printf("                       (*_soa store cells of A2 and A3 as cover and area planes)\n");
+    printf("  --no-images          Don't write rendered images\n");
+    printf("  --counters           Report IPC and cache and branch misses per pixel\n");
+    printf("                       (Linux perf_event_open, if permitted)\n");
+    printf("\n");
+    printf("Workload benchmark (uses the same filters and output options):\n");
+    printf("  --workloads[=A,B]    Sweeps shape sizes and vertex counts of workloads\n");
+    printf("                       (random, glyphs, slivers, hlines, vlines, stars,\n");
+    printf("                       spirals, rects, circles, overlapping)\n");
+    printf("  --shape-sizes=S,...  Shape sizes to sweep (default 4,16,64,256)\n");
+    printf("  --vertices=N,...     Vertex counts to sweep (default 8,32,128,512,2048)\n");
+    printf("  --canvas=WxH         Canvas size (default 1024x768)\n");
+    printf("  --images             Write rendered images (not written by default)\n");
+    printf("\n");
+    printf("Trace benchmark (uses the same filters and output options):\n");
+    printf("  --replay=FILE        Replays a trace recorded by TraceRecorder (for example\n");
+    printf("                       by render_cmd --record=FILE)\n");
+    printf("\n");
+    printf("Auto rasterizer (kIdAuto):\n");
+    printf("  --calibrate=FILE     Measures the fastest rasterizer for each class of shapes\n");
+    printf("                       and saves the profile (uses --rasterizers, --repeats,\n");
+    printf("                       and --options=scalar to calibrate scalar compositors)\n");
+    printf("  --auto-profile=FILE  Loads a calibrated profile before running benchmarks\n");
+    return 0;
+  }
+
+  if (cmd.hasKey("--damage"))
+    return benchDamage();
+
+  if (cmd.hasKey("--occlusion"))
+    return benchOcclusion();
+
+  if (cmd.hasKey("--threads")) {
+    int maxThreads = cmd.intValueOf("--threads");
+    if (maxThreads <= 0)
+      maxThreads = int(ThreadPool::hardwareConcurrency());
+    return benchThreads(uint32_t(maxThreads));
+  }
+
+  BenchConfig config;
+  config.repeats = cmd.hasKey("--repeats") ? uint32_t(std::max(cmd.intValueOf("--repeats"), 1)) : 5u;
+  config.format = BenchConfig::kFormatText;
+  config.writeImages = !cmd.hasKey("--no-images");
+  config.phases = cmd.hasKey("--phases");
+  config.stats = cmd.hasKey("--stats");
+  config.counters = nullptr;
+
+  PerfCounters counters;
+  if (cmd.hasKey("--counters")) {
+    if (counters.open())
+      config.counters = &counters;
+    else
+      fprintf(stderr, "Performance counters are not available (see /proc/sys/kernel/perf_event_paranoid), reporting timings only\n");
+  }
+  config.rasterizers = cmd.hasKey("--rasterizers") ? cmd.valueOf("--rasterizers") : nullptr;
+  config.sizes = cmd.hasKey("--sizes") ? cmd.valueOf("--sizes") : nullptr;
+  config.options = cmd.hasKey("--options") ? cmd.valueOf("--options") : nullptr;
+  config.workloads = nullptr;
+  config.vertexCounts = cmd.hasKey("--vertices") ? cmd.valueOf("--vertices") : nullptr;
+  config.shapeSizes = cmd.hasKey("--shape-sizes") ? cmd.valueOf("--shape-sizes") : nullptr;
+  config.canvasW = 1024;
+  config.canvasH = 768;
+
+  if (cmd.hasKey("--canvas")) {
+    if (sscanf(cmd.valueOf("--canvas"), "%dx%d", &config.canvasW, &config.canvasH) != 2 ||
+        config.canvasW <= 0 || config.canvasH <= 0) {
+      printf("Invalid canvas size '%s'\n", cmd.valueOf("--canvas"));
+      return 1;
+    }
+  }
+
+  if (cmd.hasKey("--format")) {
+    const char* format = cmd.valueOf("--format");
+    if (strcmp(format, "csv") == 0) {
+      config.format = BenchConfig::kFormatCsv;
+    }
+    else if (strcmp(format, "json") == 0) {
+      config.format = BenchConfig::kFormatJson;
+    }
+    else if (strcmp(format, "text") != 0) {
+      printf("Unknown format '%s'\n", format);
+      return 1;
+    }
+  }
+
+  if (config.phases) {
+    if (!Rasterizer::hasPhaseTimers()) {
+      printf("Phase timers are not compiled in, configure with -DRAS_PHASE_TIMERS=ON\n");
+      return 1;
+    }
+    config.writeImages = false;
+  }
+
+  if (config.stats) {
+    if (!Rasterizer::hasStats()) {
+      printf("Rasterizer stats are not compiled in, configure with -DRAS_STATS=ON\n");
+      return 1;
+    }
+    if (config.phases) {
+      printf("--stats and --phases cannot be combined\n");
+      return 1;
+    }
+    config.writeImages = false;
+  }
+
+  if (cmd.hasKey("--auto-profile")) {
+    const char* profileFileName = cmd.valueOf("--auto-profile");
+    if (!AutoProfile::global().load(profileFileName)) {
+      printf("Cannot load auto profile '%s'\n", profileFileName);
+      return 1;
+    }
+  }
+
+  if (cmd.hasKey("--calibrate")) {
+    config.options = cmd.hasKey("--options") ? config.options : "simd";
+    return benchCalibrate(config, cmd.valueOf("--calibrate"));
+  }
+
+  if (cmd.hasKey("--replay")) {
+    config.writeImages = cmd.hasKey("--images");
+    return benchTrace(config, cmd.valueOf("--replay"));
+  }
+
+  if (cmd.hasKey("--workloads")) {
+    const char* workloads = cmd.valueOf("--workloads");
+    config.workloads = *workloads ? workloads : nullptr;
+    config.writeImages = cmd.hasKey("--images");
+    return benchWorkloads(config);
+  }
+
+  return benchRasterizers(config);
+}
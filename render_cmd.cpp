@@ -1,91 +1,24 @@
+#include "./band.h"
+#include "./cmdline.h"
 #include "./globals.h"
+#include "./performance.h"
 #include "./rasterizer.h"
+#include "./scene.h"
+#include "./scenefile.h"
+#include "./trace.h"
 
 // ============================================================================
-// [CmdLine]
+// [Polygon]
 // ============================================================================
 
-class CmdLine {
-public:
-  CmdLine(int argc, const char* const* argv)
-    : argc(argc),
-      argv(argv) {}
-
-  bool hasKey(const char* key) const {
-    size_t size = ::strlen(key);
-    for (int i = 0; i < argc; i++)
-      if (::strlen(argv[i]) >= size && ::memcmp(argv[i], key, size) == 0)
-        return true;
-    return false;
-  }
-
-  const char* valueOf(const char* key) const {
-    size_t keySize = ::strlen(key);
-    size_t argSize = 0;
-
-    const char* arg = nullptr;
-    for (int i = 0; i <= argc; i++) {
-      if (i == argc)
-        return nullptr;
-
-      arg = argv[i];
-      argSize = ::strlen(arg);
-      if (argSize >= keySize && ::memcmp(arg, key, keySize) == 0)
-        break;
-    }
-
-    if (argSize > keySize && arg[keySize] == '=')
-      return arg + keySize + 1;
-    else
-      return arg + keySize;
-  }
-
-  int intValueOf(const char* key) const {
-    const char* value = valueOf(key);
-    if (!value) return 0;
-    return atoi(value);
-  }
-
-  int argc;
-  const char* const* argv;
-};
-
-// ============================================================================
-// [Main]
-// ============================================================================
-
-int main(int argc, char* argv[]) {
-  CmdLine cmd(argc, argv);
-  int i;
-
-  if (cmd.hasKey("--help") ||
-     !cmd.hasKey("--width") ||
-     !cmd.hasKey("--height") ||
-     !cmd.hasKey("--output")) {
-    printf("Usage: b2drefras --width=W --height=H --output=file.bmp X Y X Y X Y [...]\n");
-    return 1;
-  }
-
-  int w = cmd.intValueOf("--width");
-  int h = cmd.intValueOf("--height");
-  bool nonZero = !cmd.hasKey("--even-odd");
-  const char* fileName = cmd.valueOf("--output");
-
-  uint32_t color = 0xFFFFFFFF;
-
-  Image image;
-  image.create(w, h);
-  image.fillAll(0);
-
-  // Rasterize the polygon.
-  Rasterizer* ras = Rasterizer::newById(image, Rasterizer::kIdA1, 0);
-  ras->setFillMode(nonZero ? Rasterizer::kFillNonZero : Rasterizer::kFillEvenOdd);
-
+// Adds a polygon given by `X Y` pairs on the command line, returns `false` if
+// a coordinate is out of the canvas.
+static bool addPolygonFromArgs(Rasterizer* ras, int argc, char* argv[], int w, int h) {
   double line[4];
   double start[2];
   int index = 0;
 
-  for (i = 1; i < argc; i++) {
+  for (int i = 1; i < argc; i++) {
     const char* value = argv[i];
     if (value[0] == '-' && value[1] == '-')
       continue;
@@ -99,10 +32,8 @@ int main(int argc, char* argv[]) {
       start[0] = x0;
       start[1] = y0;
 
-      if (x0 < 0 || y0 < 0 || x0 > w || y0 > h) {
-        printf("Coordinates out of range\n");
-        return 1;
-      }
+      if (x0 < 0 || y0 < 0 || x0 > w || y0 > h)
+        return false;
     }
 
     if (index == 4) {
@@ -111,10 +42,8 @@ int main(int argc, char* argv[]) {
       double x1 = line[2];
       double y1 = line[3];
 
-      if (x1 < 0 || y1 < 0 || x1 > w || y1 > h) {
-        printf("Coordinates out of range\n");
-        return 1;
-      }
+      if (x1 < 0 || y1 < 0 || x1 > w || y1 > h)
+        return false;
 
       Point poly[] = { { x0, y0 }, { x1, y1 } };
       ras->addPoly(poly, 2);
@@ -136,7 +65,241 @@ int main(int argc, char* argv[]) {
     ras->addPoly(poly, 2);
   }
 
-  ras->render(color);
+  return true;
+}
+
+// ============================================================================
+// [Scene]
+// ============================================================================
+
+// Rasterizers expect all points within the canvas.
+static bool sceneFitsCanvas(const Scene& scene, int w, int h) {
+  const Point* points = scene.points();
+  size_t count = scene._points.size();
+
+  for (size_t i = 0; i < count; i++)
+    if (!(points[i].x >= 0.0 && points[i].x <= double(w) && points[i].y >= 0.0 && points[i].y <= double(h)))
+      return false;
+  return true;
+}
+
+static void renderScene(Rasterizer* ras, const Scene& scene) {
+  const Scene::Contour* contours = scene.contours();
+  const Point* points = scene.points();
+
+  for (size_t i = 0; i < scene.shapeCount(); i++) {
+    const Scene::Shape& shape = scene.shapeAt(i);
+
+    for (uint32_t j = 0; j < shape.contourCount; j++) {
+      const Scene::Contour& contour = contours[shape.contourIndex + j];
+      ras->addPoly(points + contour.pointIndex, contour.pointCount);
+    }
+
+    ras->setFillMode(shape.fillMode);
+    ras->render(shape.argb32);
+    ras->clear();
+  }
+}
+
+// ============================================================================
+// [Main]
+// ============================================================================
+
+static void printUsage() {
+  printf("Usage:\n");
+  printf("  render_cmd --width=W --height=H --output=file.bmp [options] X Y X Y X Y [...]\n");
+  printf("  render_cmd --scene=file.scene --output=file.bmp [options]\n");
+  printf("  render_cmd --scene=file.scene --band-output=file.bmp [options]\n");
+  printf("\n");
+  printf("Options:\n");
+  printf("  --width=W, --height=H    Canvas size (defaults to the size of the scene)\n");
+  printf("  --rasterizer=NAME        Rasterizer (AGG, A1, A2, A3x4, ..., F1, S4, L1, Auto) [A1]\n");
+  printf("  --auto-profile=FILE      Profile of the Auto rasterizer (see render_bench --calibrate)\n");
+  printf("  --simd                   Use SIMD compositors\n");
+  printf("  --soa                    Store cells as cover and area planes (A2, A3)\n");
+  printf("  --even-odd               Fill the polygon by the even-odd rule\n");
+  printf("  --tolerance=X            Curve flattening tolerance in pixels [0.25]\n");
+  printf("  --repeat=N               Render N times and report the time\n");
+  printf("  --record=file.trace      Record all rasterizer calls (see render_bench --replay)\n");
+  printf("  --band-output=FILE       Render the scene in bands by BandRenderer and stream\n");
+  printf("                           them to FILE (BMP, or raw ARGB32 if it ends with .raw)\n");
+  printf("  --band-height=N          Rows of each band [64]\n");
+}
+
+int main(int argc, char* argv[]) {
+  CmdLine cmd(argc, argv);
+
+  const char* sceneFileName = cmd.valueOf("--scene");
+  const char* bandFileName = cmd.valueOf("--band-output");
+  if (cmd.hasKey("--help") ||
+     (!cmd.hasKey("--output") && !bandFileName) ||
+     (!sceneFileName && (!cmd.hasKey("--width") || !cmd.hasKey("--height")))) {
+    printUsage();
+    return 1;
+  }
+
+  int w = cmd.intValueOf("--width");
+  int h = cmd.intValueOf("--height");
+  bool nonZero = !cmd.hasKey("--even-odd");
+  const char* fileName = cmd.valueOf("--output");
+
+  uint32_t color = 0xFFFFFFFF;
+  uint32_t repeat = uint32_t(std::max(cmd.intValueOf("--repeat"), 1));
+  const char* traceFileName = cmd.valueOf("--record");
+
+  if (traceFileName && repeat > 1) {
+    printf("--record and --repeat cannot be combined\n");
+    return 1;
+  }
+
+  if (bandFileName && (!sceneFileName || traceFileName || repeat > 1)) {
+    printf("--band-output requires --scene and cannot be combined with --record or --repeat\n");
+    return 1;
+  }
+
+  uint32_t rasterizerId = Rasterizer::kIdA1;
+  uint32_t options = cmd.hasKey("--simd") ? uint32_t(Rasterizer::kOptionSIMD) : 0u;
+  if (cmd.hasKey("--soa"))
+    options |= Rasterizer::kOptionSoA;
+
+  if (const char* name = cmd.valueOf("--rasterizer")) {
+    rasterizerId = Rasterizer::idByName(name, strlen(name));
+    if (rasterizerId == Rasterizer::kIdCount) {
+      printf("Unknown rasterizer '%s'\n", name);
+      return 1;
+    }
+  }
+
+  if (const char* profileFileName = cmd.valueOf("--auto-profile")) {
+    if (!AutoProfile::global().load(profileFileName)) {
+      printf("Cannot load auto profile '%s'\n", profileFileName);
+      return 1;
+    }
+  }
+
+  // Load the scene first, it can specify the canvas size.
+  Scene scene;
+  if (sceneFileName) {
+    SceneFile sceneFile;
+    if (!sceneFile.open(sceneFileName)) {
+      printf("Cannot open file '%s'\n", sceneFileName);
+      return 1;
+    }
+
+    const char* tolerance = cmd.valueOf("--tolerance");
+    if (!sceneFile.load(scene, tolerance ? atof(tolerance) : 0.25)) {
+      printf("%s:%u: %s\n", sceneFileName, sceneFile.errorLine(), sceneFile.errorMessage());
+      return 1;
+    }
+
+    if (!cmd.hasKey("--width"))
+      w = sceneFile.width();
+    if (!cmd.hasKey("--height"))
+      h = sceneFile.height();
+  }
+
+  if (w <= 0 || h <= 0) {
+    printf("Invalid canvas size, specify --width and --height\n");
+    return 1;
+  }
+
+  if (sceneFileName && !sceneFitsCanvas(scene, w, h)) {
+    printf("Coordinates out of range\n");
+    return 1;
+  }
+
+  // Bands are rendered by `TileRasterizer` with memory proportional to the
+  // width of the canvas, so the full image is only created for `--output`.
+  if (bandFileName) {
+    int bandHeight = cmd.hasKey("--band-height") ? cmd.intValueOf("--band-height") : int(BandRenderer::kDefaultBandHeight);
+    if (bandHeight <= 0) {
+      printf("Invalid band height\n");
+      return 1;
+    }
+
+    size_t nameSize = strlen(bandFileName);
+    bool raw = nameSize >= 4 && strcmp(bandFileName + nameSize - 4, ".raw") == 0;
+
+    FileBandWriter writer(bandFileName, raw ? FileBandWriter::kFormatRaw : FileBandWriter::kFormatBmp);
+    BandRenderer renderer(w, h, options, bandHeight);
+
+    if (!renderer.render(scene, 0, writer)) {
+      printf("Cannot render bands to '%s'\n", bandFileName);
+      return 1;
+    }
+
+    if (!fileName)
+      return 0;
+  }
+
+  Image image;
+  if (!image.create(w, h)) {
+    printf("Out of memory\n");
+    return 1;
+  }
+  image.fillAll(0);
+
+  Rasterizer* ras = Rasterizer::newById(image, rasterizerId, options);
+  if (!ras) {
+    printf("Out of memory\n");
+    return 1;
+  }
+
+  // Optionally record all rasterizer calls, see `render_bench --replay`.
+  TraceWriter traceWriter;
+
+  if (traceFileName) {
+    if (!traceWriter.open(traceFileName, w, h)) {
+      printf("Cannot open file '%s' for writing\n", traceFileName);
+      delete ras;
+      return 1;
+    }
+    ras = new TraceRecorder(ras, traceWriter);
+  }
+
+  if (sceneFileName) {
+    PodArray<uint64_t> samples;
+    if (!samples.reserve(repeat)) {
+      printf("Out of memory\n");
+      return 1;
+    }
+
+    for (uint32_t i = 0; i < repeat; i++) {
+      image.fillAll(0);
+
+      uint64_t startTime = Performance::getTimeNs();
+      renderScene(ras, scene);
+      samples.append(Performance::getTimeNs() - startTime);
+    }
+
+    if (repeat > 1) {
+      PerformanceStats stats;
+      stats.compute(samples.data(), samples.size());
+      printf("%s: %zu shapes, %u repeats [min=%9.3f ms] [med=%9.3f ms] [mean=%9.3f ms] [sd=%7.3f ms]\n",
+        ras->name(), scene.shapeCount(), repeat,
+        stats.min * 1e-6, stats.median * 1e-6, stats.mean * 1e-6, stats.stddev * 1e-6);
+    }
+  }
+  else {
+    // Rasterize the polygon.
+    ras->setFillMode(nonZero ? Rasterizer::kFillNonZero : Rasterizer::kFillEvenOdd);
+
+    if (!addPolygonFromArgs(ras, argc, argv, w, h)) {
+      printf("Coordinates out of range\n");
+      return 1;
+    }
+
+    ras->render(color);
+  }
+
+  if (traceFileName) {
+    delete static_cast<TraceRecorder*>(ras)->_target;
+    if (!traceWriter.close()) {
+      printf("Cannot write trace '%s'\n", traceFileName);
+      delete ras;
+      return 1;
+    }
+  }
   delete ras;
 
   if (!image.writeBmp(fileName)) {
@@ -0,0 +1,174 @@
+#include "./cmdline.h"
+#include "./globals.h"
+#include "./performance.h"
+#include "./rasterizer.h"
+#include "./shm.h"
+
+#if defined(__linux__)
+  #include <signal.h>
+  #include <sys/wait.h>
+  #include <unistd.h>
+#endif
+
+// ============================================================================
+// [Frames]
+// ============================================================================
+
+// Each frame has a different opaque background, the consumer checks the first
+// and the last row of each frame it acquires to detect torn frames.
+static uint32_t frameBackground(uint64_t sequence) noexcept {
+  uint32_t c = uint32_t(sequence * 2654435761u);
+  return 0xFF000000u | (c & 0x00FFFFFFu);
+}
+
+static void renderFrame(Image& image, Rasterizer* ras, uint64_t sequence) noexcept {
+  image.fillAll(frameBackground(sequence));
+
+  double cx = image.width() * 0.5;
+  double cy = image.height() * 0.5;
+  double r0 = std::min(cx, cy) * 0.9;
+  double r1 = r0 * 0.4;
+  double angle = double(sequence) * 0.02;
+
+  // A rotating star.
+  Point poly[10];
+  for (uint32_t i = 0; i < 10; i++) {
+    double r = (i & 1) ? r1 : r0;
+    double a = angle + double(i) * 3.14159265358979323846 / 5.0;
+    poly[i].x = cx + std::cos(a) * r;
+    poly[i].y = cy + std::sin(a) * r;
+  }
+
+  ras->addPoly(poly, 10);
+  ras->render(0xFFFFFFFFu);
+}
+
+static bool isFrameIntact(const Image& image, uint64_t sequence) noexcept {
+  uint32_t c = frameBackground(sequence);
+  const uint32_t* first = image.data<uint32_t>();
+  const uint32_t* last = reinterpret_cast<const uint32_t*>(image.data() + intptr_t(image.height() - 1) * image.stride());
+  return first[0] == c && last[image.width() - 1] == c;
+}
+
+// ============================================================================
+// [Main]
+// ============================================================================
+
+#if defined(__linux__)
+static int runConsumer(int fd, uint64_t frameCount, const char* fileName) {
+  SharedFrameBuffer fb;
+  if (!fb.open(fd)) {
+    printf("[Consumer] Cannot open the shared frame buffer\n");
+    return 1;
+  }
+
+  uint64_t acquired = 0;
+  uint64_t torn = 0;
+
+  for (;;) {
+    if (!fb.acquire(5000)) {
+      printf("[Consumer] Timed out waiting for a frame\n");
+      return 1;
+    }
+
+    uint64_t sequence = fb.frontSequence();
+    acquired++;
+    if (!isFrameIntact(fb.frontBuffer(), sequence))
+      torn++;
+
+    if (sequence == frameCount) {
+      if (fileName && !fb.frontBuffer().writeBmp(fileName)) {
+        printf("[Consumer] Cannot open file '%s' for writing\n", fileName);
+        return 1;
+      }
+      break;
+    }
+
+    fb.release();
+  }
+
+  printf("[Consumer] Acquired %llu of %llu frames, %llu torn\n",
+    (unsigned long long)acquired,
+    (unsigned long long)frameCount,
+    (unsigned long long)torn);
+  return torn ? 1 : 0;
+}
+#endif
+
+int main(int argc, char* argv[]) {
+  CmdLine cmd(argc, argv);
+
+  if (cmd.hasKey("--help")) {
+    printf("Usage: render_shm [--width=W] [--height=H] [--frames=N] [--buffers=2|3] [--output=last.bmp]\n");
+    return 0;
+  }
+
+#if defined(__linux__)
+  int w = cmd.hasKey("--width") ? cmd.intValueOf("--width") : 1280;
+  int h = cmd.hasKey("--height") ? cmd.intValueOf("--height") : 720;
+  int frames = cmd.hasKey("--frames") ? cmd.intValueOf("--frames") : 600;
+  uint32_t bufferCount = cmd.hasKey("--buffers") ? uint32_t(cmd.intValueOf("--buffers")) : 3u;
+  const char* fileName = cmd.valueOf("--output");
+
+  if (frames <= 0) {
+    printf("Invalid number of frames\n");
+    return 1;
+  }
+
+  SharedFrameBuffer fb;
+  if (!fb.create(w, h, bufferCount)) {
+    printf("Cannot create a shared frame buffer of %dx%d pixels and %u buffers\n", w, h, bufferCount);
+    return 1;
+  }
+
+  // The consumer inherits the memfd descriptor and maps it by itself.
+  std::fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    printf("Cannot fork the consumer process\n");
+    return 1;
+  }
+
+  if (pid == 0) {
+    int result = runConsumer(fb.fd(), uint64_t(frames), fileName);
+    std::fflush(stdout);
+    _exit(result);
+  }
+
+  // `present()` attaches `backBuffer()` to another buffer of the same size,
+  // cell rasterizers read the destination pointer when rendering, so a single
+  // rasterizer bound to it can be used for all frames.
+  Rasterizer* ras = Rasterizer::newById(fb.backBuffer(), Rasterizer::kIdA3x8, Rasterizer::kOptionSIMD);
+  if (!ras) {
+    printf("[Producer] Out of memory\n");
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    return 1;
+  }
+
+  Performance perf;
+  perf.start();
+
+  bool presented = true;
+  for (int i = 1; i <= frames && presented; i++) {
+    renderFrame(fb.backBuffer(), ras, uint64_t(i));
+
+    presented = fb.present(uint64_t(i), 5000);
+    if (!presented)
+      printf("[Producer] Timed out waiting for the consumer\n");
+  }
+
+  uint32_t duration = perf.end();
+  delete ras;
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  bool consumerOk = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+  printf("[Producer] Presented %d frames of %dx%d (%u buffers) in %u [ms]\n", frames, w, h, bufferCount, duration);
+  return presented && consumerOk ? 0 : 1;
+#else
+  printf("Shared frame buffers are not supported on this platform\n");
+  return 1;
+#endif
+}
@@ -0,0 +1,173 @@
+#include "./retained.h"
+
+// ============================================================================
+// [RetainedRasterizer - Construction / Destruction]
+// ============================================================================
+
+RetainedRasterizer::RetainedRasterizer(Image& dst, uint32_t options) noexcept
+  : CellRasterizer(dst, options),
+    _cellStride(0),
+    _cells(nullptr),
+    _xBounds(nullptr),
+    _yBounds { 0, 0 },
+    _dirtyRows { 0, 0 },
+    _background(nullptr) {
+  std::snprintf(_name, ARRAY_SIZE(_name), "Retained");
+  addOptionsToName();
+  _yBounds.reset();
+  _dirtyRows.reset();
+  init(dst.width(), dst.height());
+}
+
+RetainedRasterizer::~RetainedRasterizer() noexcept {
+  reset();
+}
+
+// ============================================================================
+// [RetainedRasterizer - Basics]
+// ============================================================================
+
+bool RetainedRasterizer::init(int w, int h) noexcept {
+  if (_width != w || _height != h) {
+    reset();
+
+    if (w == 0 || h == 0)
+      return true;
+
+    // One more cell per row as a line can end exactly at the right edge.
+    _cellStride = size_t(w) + 1;
+    _xBounds = static_cast<Bounds*>(std::malloc(size_t(h) * sizeof(Bounds)));
+    _cells = static_cast<Cell*>(std::malloc(size_t(h) * _cellStride * sizeof(Cell)));
+
+    if (!_cells || !_xBounds) {
+      if (_cells) std::free(_cells);
+      if (_xBounds) std::free(_xBounds);
+
+      _cellStride = 0;
+      _cells = nullptr;
+      _xBounds = nullptr;
+      return false;
+    }
+
+    _width = w;
+    _height = h;
+
+    std::memset(_cells, 0, size_t(h) * _cellStride * sizeof(Cell));
+    for (int y = 0; y < h; y++)
+      _xBounds[y].reset();
+  }
+  else {
+    clear();
+  }
+
+  return true;
+}
+
+void RetainedRasterizer::setBackground(const Image* background) noexcept {
+  assert(!background || (background->width() == _width && background->height() == _height));
+  _background = background;
+
+  // Everything has to be restored from the new background.
+  if (background && _height)
+    _dirtyRows.union_(0, _height - 1);
+}
+
+void RetainedRasterizer::reset() noexcept {
+  if (isInitialized()) {
+    std::free(_cells);
+    std::free(_xBounds);
+
+    _width = 0;
+    _height = 0;
+    _cellStride = 0;
+    _cells = nullptr;
+    _xBounds = nullptr;
+    _yBounds.reset();
+    _dirtyRows.reset();
+  }
+}
+
+void RetainedRasterizer::clear() noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseClear);
+
+  if (isInitialized() && !_yBounds.empty()) {
+    size_t y0 = size_t(_yBounds.start);
+    size_t y1 = size_t(_yBounds.end);
+
+    _dirtyRows.union_(int(y0), int(y1));
+
+    Cell* cellPtr = _cells + y0 * _cellStride;
+    while (y0 <= y1) {
+      int x0 = _xBounds[y0].start;
+      int x1 = _xBounds[y0].end;
+
+      if (x0 <= x1) {
+        size_t width = size_t(x1 - x0 + 1);
+        std::memset(cellPtr + x0, 0, width * sizeof(Cell));
+        _xBounds[y0].reset();
+      }
+
+      cellPtr += _cellStride;
+      y0++;
+    }
+
+    _yBounds.reset();
+  }
+}
+
+void RetainedRasterizer::invalidate() noexcept {
+  if (!_yBounds.empty())
+    _dirtyRows.union_(_yBounds.start, _yBounds.end);
+}
+
+// ============================================================================
+// [RetainedRasterizer - AddPoly / RemovePoly / UpdatePoly]
+// ============================================================================
+
+bool RetainedRasterizer::addPoly(const Point* poly, size_t count) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseAddPoly);
+
+  assert(isInitialized());
+
+  for (size_t i = 1; i < count; i++)
+    _addEdge(poly[i - 1], poly[i]);
+
+  return true;
+}
+
+bool RetainedRasterizer::removePoly(const Point* poly, size_t count) noexcept {
+  assert(isInitialized());
+
+  for (size_t i = 1; i < count; i++)
+    _addEdge(poly[i], poly[i - 1]);
+
+  return true;
+}
+
+bool RetainedRasterizer::updatePoly(const Point* oldPoly, const Point* newPoly, size_t count) noexcept {
+  assert(isInitialized());
+
+  for (size_t i = 1; i < count; i++) {
+    const Point& a0 = oldPoly[i - 1];
+    const Point& a1 = oldPoly[i];
+    const Point& b0 = newPoly[i - 1];
+    const Point& b1 = newPoly[i];
+
+    if (a0.x == b0.x && a0.y == b0.y && a1.x == b1.x && a1.y == b1.y)
+      continue;
+
+    _addEdge(a1, a0);
+    _addEdge(b0, b1);
+  }
+
+  return true;
+}
+
+// ============================================================================
+// [RetainedRasterizer - Render]
+// ============================================================================
+
+void RetainedRasterizer::render(uint32_t argb32) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseRender);
+  doRender(*this, argb32);
+}
@@ -0,0 +1,137 @@
+#ifndef _RETAINED_H
+#define _RETAINED_H
+
+#include "./compositor.h"
+#include "./globals.h"
+#include "./rasterizer.h"
+
+// ============================================================================
+// [RetainedRasterizer]
+// ============================================================================
+
+//! Cell rasterizer that keeps its cells between frames (retained shape).
+//!
+//! Cells are additive, so a shape can be edited by subtracting the old edges
+//! (rasterized in the reverse direction, which produces the same cells with
+//! opposite sign) and adding the new ones - `updatePoly()` only does that for
+//! edges that have actually changed. `render()` doesn't consume the cells, it
+//! only re-composites rows that were affected by edits since the last render.
+//! If a background image is set each such row is first restored from it, so
+//! the destination always shows the background plus the current shape.
+class RetainedRasterizer : public CellRasterizer {
+public:
+  RetainedRasterizer(Image& dst, uint32_t options) noexcept;
+  virtual ~RetainedRasterizer() noexcept;
+
+  bool init(int w, int h) noexcept;
+
+  //! Sets an image of the same size as `dst` that dirty rows are restored
+  //! from before compositing, `nullptr` composites onto `dst` as is. All rows
+  //! are restored by the next `render()`.
+  void setBackground(const Image* background) noexcept;
+
+  virtual void reset() noexcept override;
+  //! Removes all edges, rows that had any cells are re-composited by the next
+  //! `render()`.
+  virtual void clear() noexcept override;
+  //! Adds edges of the polygon to the retained shape.
+  virtual bool addPoly(const Point* poly, size_t count) noexcept override;
+
+  //! Removes edges previously added by `addPoly()` with the same points.
+  bool removePoly(const Point* poly, size_t count) noexcept;
+  //! Replaces edges of `oldPoly` by edges of `newPoly` (both having `count`
+  //! points), only edges that differ are rasterized.
+  bool updatePoly(const Point* oldPoly, const Point* newPoly, size_t count) noexcept;
+
+  //! Marks all rows having cells dirty (for example if the color changes).
+  void invalidate() noexcept;
+
+  inline void _addEdge(const Point& p0, const Point& p1) noexcept {
+    int x0 = static_cast<int>(p0.x * 256);
+    int y0 = static_cast<int>(p0.y * 256);
+    int x1 = static_cast<int>(p1.x * 256);
+    int y1 = static_cast<int>(p1.y * 256);
+
+    if (x0 != x1 || y0 != y1)
+      addLineT<RetainedRasterizer, int64_t>(*this, x0, y0, x1, y1);
+  }
+
+  inline void _mergeCell(int x, int y, int cover, int area) noexcept {
+    assert(x >= 0 && x <= _width);
+    assert(y >= 0 && y < _height);
+
+    _xBounds[y].union_(x, x);
+    _yBounds.union_(y, y);
+    _dirtyRows.union_(y, y);
+
+    Cell& cell = _cells[size_t(y) * _cellStride + size_t(x)];
+    cell.cover += cover;
+    cell.area  += area;
+  }
+
+  template<class Compositor, bool NonZero>
+  inline void _renderImpl(uint32_t argb32) noexcept;
+
+  //! Re-composites dirty rows, cells are kept.
+  virtual void render(uint32_t argb32) noexcept override;
+
+  size_t _cellStride;
+  Cell* _cells;
+  //! Extent of cells of each row, only grows until `clear()`.
+  Bounds* _xBounds;
+  //! Rows having cells.
+  Bounds _yBounds;
+  //! Rows to re-composite by the next `render()`.
+  Bounds _dirtyRows;
+
+  const Image* _background;
+};
+
+// ============================================================================
+// [RetainedRasterizer - Render]
+// ============================================================================
+
+template<class Compositor, bool NonZero>
+inline void RetainedRasterizer::_renderImpl(uint32_t argb32) noexcept {
+  if (_dirtyRows.empty())
+    return;
+
+  size_t y0 = size_t(_dirtyRows.start);
+  size_t y1 = size_t(_dirtyRows.end);
+  size_t w = size_t(_width);
+
+  intptr_t stride = _dst->stride();
+  uint8_t* dstLine = _dst->data() + intptr_t(y0) * stride;
+  Cell* cellLine = _cells + y0 * _cellStride;
+
+  Compositor compositor(argb32);
+  while (y0 <= y1) {
+    uint32_t* dstPix = reinterpret_cast<uint32_t*>(dstLine);
+
+    if (_background)
+      std::memcpy(dstLine, _background->data() + intptr_t(y0) * _background->stride(), w * 4);
+
+    const Bounds& xBounds = _xBounds[y0];
+    if (!xBounds.empty()) {
+      size_t x0 = size_t(xBounds.start);
+      size_t x1 = std::min(size_t(xBounds.end) + 1, w);
+
+      int cover = 0;
+      compositor.template vmask<NonZero, false>(dstPix, x0, x1, cellLine, cover);
+
+      if (x1 < w) {
+        uint32_t mask = CompositeUtils::calcMask<NonZero>(cover);
+        if (mask)
+          compositor.cmask(dstPix, x1, w, mask);
+      }
+    }
+
+    y0++;
+    dstLine += stride;
+    cellLine += _cellStride;
+  }
+
+  _dirtyRows.reset();
+}
+
+#endif // _RETAINED_H
@@ -0,0 +1,426 @@
+#include "./scene.h"
+
+// ============================================================================
+// [Scene - Construction / Destruction]
+// ============================================================================
+
+Scene::Scene() noexcept
+  : _openContourIndex(0) {}
+
+Scene::~Scene() noexcept {}
+
+// ============================================================================
+// [Scene - Basics]
+// ============================================================================
+
+void Scene::reset() noexcept {
+  _shapes.reset();
+  _contours.reset();
+  _points.reset();
+  _openContourIndex = 0;
+}
+
+void Scene::clear() noexcept {
+  _shapes.clear();
+  _contours.clear();
+  _points.clear();
+  _openContourIndex = 0;
+}
+
+// ============================================================================
+// [Scene - AddPoly / Fill]
+// ============================================================================
+
+bool Scene::addPoly(const Point* poly, size_t count) noexcept {
+  if (count < 2)
+    return true;
+
+  bool close = poly[0].x != poly[count - 1].x || poly[0].y != poly[count - 1].y;
+  Contour contour { uint32_t(_points.size()), uint32_t(count + close) };
+
+  if (!_points.append(poly, count) || (close && !_points.append(poly[0])) || !_contours.append(contour))
+    return false;
+
+  if (_openContourIndex == _contours.size() - 1) {
+    _bounds[0] = _bounds[2] = poly[0].x;
+    _bounds[1] = _bounds[3] = poly[0].y;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    _bounds[0] = std::min(_bounds[0], poly[i].x);
+    _bounds[1] = std::min(_bounds[1], poly[i].y);
+    _bounds[2] = std::max(_bounds[2], poly[i].x);
+    _bounds[3] = std::max(_bounds[3], poly[i].y);
+  }
+
+  return true;
+}
+
+bool Scene::fill(uint32_t argb32, uint32_t fillMode) noexcept {
+  uint32_t contourCount = uint32_t(_contours.size()) - _openContourIndex;
+  if (!contourCount)
+    return true;
+
+  Shape shape;
+  shape.contourIndex = _openContourIndex;
+  shape.contourCount = contourCount;
+  shape.argb32 = argb32;
+  shape.fillMode = fillMode;
+  shape.x0 = int(std::floor(_bounds[0]));
+  shape.y0 = int(std::floor(_bounds[1]));
+  shape.x1 = int(std::floor(_bounds[2])) + 1;
+  shape.y1 = int(std::floor(_bounds[3])) + 1;
+
+  if (!_shapes.append(shape))
+    return false;
+
+  _openContourIndex = uint32_t(_contours.size());
+  return true;
+}
+
+uint64_t Scene::shapeHash(size_t i) const noexcept {
+  const Shape& shape = _shapes[i];
+
+  // FNV-1a over everything that affects the rendered pixels.
+  uint64_t h = 14695981039346656037u;
+  auto add = [&](const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t j = 0; j < size; j++)
+      h = (h ^ p[j]) * 1099511628211u;
+  };
+
+  add(&shape.argb32, sizeof(uint32_t));
+  add(&shape.fillMode, sizeof(uint32_t));
+
+  for (uint32_t c = 0; c < shape.contourCount; c++) {
+    const Contour& contour = _contours[shape.contourIndex + c];
+    add(&contour.pointCount, sizeof(uint32_t));
+    add(_points.data() + contour.pointIndex, contour.pointCount * sizeof(Point));
+  }
+
+  return h;
+}
+
+// ============================================================================
+// [TileRenderer - Construction / Destruction]
+// ============================================================================
+
+TileRenderer::TileRenderer(Image& dst, uint32_t options, uint32_t tileSize, ThreadPool* pool) noexcept
+  : _dst(&dst),
+    _pool(pool),
+    _options(options),
+    _tileSize(tileSize),
+    _rasterizerCount(0),
+    _occlusionCulling(false),
+    _hasBackground(false),
+    _background(0),
+    _tilesX(0),
+    _tilesY(0),
+    _workers(nullptr),
+    _scene(nullptr),
+    _tileList(nullptr) {
+
+  uint32_t count = pool ? pool->workerCount() : 1;
+  _workers = static_cast<Worker*>(std::malloc(count * sizeof(Worker)));
+  if (!_workers)
+    return;
+
+  for (uint32_t i = 0; i < count; i++) {
+    TileRasterizer* ras = new(std::nothrow) TileRasterizer(dst, options);
+    if (ras && !ras->init(int(tileSize), int(tileSize))) {
+      delete ras;
+      ras = nullptr;
+    }
+
+    if (!ras)
+      break;
+
+    Worker* worker = new(&_workers[i]) Worker();
+    worker->rasterizer = ras;
+    worker->stats.reset();
+    _rasterizerCount++;
+  }
+}
+
+TileRenderer::~TileRenderer() noexcept {
+  for (uint32_t i = 0; i < _rasterizerCount; i++) {
+    delete _workers[i].rasterizer;
+    _workers[i].~Worker();
+  }
+  std::free(_workers);
+}
+
+// ============================================================================
+// [TileRenderer - Stats]
+// ============================================================================
+
+TileRenderer::Stats TileRenderer::stats() const noexcept {
+  Stats stats;
+  stats.reset();
+
+  for (uint32_t i = 0; i < _rasterizerCount; i++) {
+    const Worker& worker = _workers[i];
+    stats.shapeTiles += worker.stats.shapeTiles;
+    stats.culledShapeTiles += worker.stats.culledShapeTiles;
+    stats.culledPixels += worker.stats.culledPixels;
+    stats.occludedPixels += worker.rasterizer->occludedPixels();
+  }
+
+  return stats;
+}
+
+void TileRenderer::resetStats() noexcept {
+  for (uint32_t i = 0; i < _rasterizerCount; i++) {
+    _workers[i].stats.reset();
+    _workers[i].rasterizer->resetOccludedPixels();
+  }
+}
+
+// ============================================================================
+// [TileRenderer - Render]
+// ============================================================================
+
+bool TileRenderer::_bin(const Scene& scene) noexcept {
+  uint32_t ts = _tileSize;
+
+  _tilesX = (uint32_t(_dst->width()) + ts - 1) / ts;
+  _tilesY = (uint32_t(_dst->height()) + ts - 1) / ts;
+
+  size_t tileCount = size_t(_tilesX) * _tilesY;
+  if (!_binOffsets.resize(tileCount + 1))
+    return false;
+
+  uint32_t* offsets = _binOffsets.data();
+  std::memset(offsets, 0, (tileCount + 1) * sizeof(uint32_t));
+
+  // Two passes, the first counts shapes per tile and the second fills the bins
+  // so each bin is a contiguous range of shape indexes in scene order.
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (size_t i = 0; i < scene.shapeCount(); i++) {
+      const Scene::Shape& shape = scene.shapeAt(i);
+
+      int x0 = std::max(shape.x0, 0);
+      int y0 = std::max(shape.y0, 0);
+      int x1 = std::min(shape.x1, _dst->width());
+      int y1 = std::min(shape.y1, _dst->height());
+
+      if (x0 >= x1 || y0 >= y1)
+        continue;
+
+      uint32_t tx0 = uint32_t(x0) / ts;
+      uint32_t ty0 = uint32_t(y0) / ts;
+      uint32_t tx1 = uint32_t(x1 - 1) / ts;
+      uint32_t ty1 = uint32_t(y1 - 1) / ts;
+
+      for (uint32_t ty = ty0; ty <= ty1; ty++) {
+        for (uint32_t tx = tx0; tx <= tx1; tx++) {
+          size_t tileIndex = size_t(ty) * _tilesX + tx;
+          if (pass == 0)
+            offsets[tileIndex + 1]++;
+          else
+            _binShapes[offsets[tileIndex]++] = uint32_t(i);
+        }
+      }
+    }
+
+    if (pass == 0) {
+      for (size_t t = 0; t < tileCount; t++)
+        offsets[t + 1] += offsets[t];
+
+      if (!_binShapes.resize(offsets[tileCount]))
+        return false;
+    }
+    else {
+      // The second pass advanced each offset to the end of its bin, which is
+      // the start of the next one - shift them back.
+      std::memmove(offsets + 1, offsets, tileCount * sizeof(uint32_t));
+      offsets[0] = 0;
+    }
+  }
+
+  return true;
+}
+
+
+bool TileRenderer::_cullTile(const Scene& scene, Worker& worker, uint32_t start, uint32_t end) noexcept {
+  TileRasterizer& ras = *worker.rasterizer;
+  int tx = ras.tileX();
+  int ty = ras.tileY();
+  int tw = ras.tileW();
+  int th = ras.tileH();
+
+  worker.snapshots.clear();
+  worker.savedRows.clear();
+  worker.savedCells.clear();
+
+  if (!worker.occlusion.resize(size_t(th)) ||
+      !worker.spans.resize(size_t(th)) ||
+      !worker.culledShapes.resize(end - start))
+    return false;
+
+  Bounds* occlusion = worker.occlusion.data();
+  Bounds* spans = worker.spans.data();
+
+  for (int y = 0; y < th; y++)
+    occlusion[y].reset();
+
+  const Scene::Contour* contours = scene.contours();
+  const Point* points = scene.points();
+
+  // Front-to-back, each shape sees the occlusion of all shapes drawn after it.
+  uint32_t i = end;
+  while (i != start) {
+    i--;
+
+    const Scene::Shape& shape = scene.shapeAt(_binShapes[i]);
+    int x0 = std::max(shape.x0 - tx, 0);
+    int y0 = std::max(shape.y0 - ty, 0);
+    int x1 = std::min(shape.x1 - tx, tw) - 1;
+    int y1 = std::min(shape.y1 - ty, th) - 1;
+
+    bool culled = true;
+    for (int y = y0; y <= y1; y++) {
+      if (occlusion[y].start > x0 || occlusion[y].end < x1) {
+        culled = false;
+        break;
+      }
+    }
+
+    CulledShape& culledShape = worker.culledShapes[i - start];
+    if (culled) {
+      culledShape.snapshotIndex = kCulled;
+      worker.stats.culledShapeTiles++;
+      worker.stats.culledPixels += uint64_t(x1 - x0 + 1) * uint64_t(y1 - y0 + 1);
+      continue;
+    }
+
+    culledShape.snapshotIndex = uint32_t(worker.snapshots.size());
+    if (!worker.snapshots.append(occlusion + y0, size_t(y1 - y0 + 1)))
+      return false;
+
+    for (uint32_t c = 0; c < shape.contourCount; c++) {
+      const Scene::Contour& contour = contours[shape.contourIndex + c];
+      ras.addPoly(points + contour.pointIndex, contour.pointCount);
+    }
+
+    // Keep a copy of the cells for `_renderTile()`, `fullSpans()` consumes them.
+    culledShape.rowIndex = uint32_t(worker.savedRows.size());
+    if (!ras.saveCells(worker.savedRows, worker.savedCells))
+      return false;
+    culledShape.rowCount = uint32_t(worker.savedRows.size()) - culledShape.rowIndex;
+
+    ras.setFillMode(shape.fillMode);
+    ras.fullSpans(spans);
+
+    // Keep a single interval per row - merge if the spans touch, otherwise
+    // keep the longer one.
+    for (int y = y0; y <= y1; y++) {
+      Bounds& o = occlusion[y];
+      const Bounds& span = spans[y];
+
+      if (span.empty())
+        continue;
+
+      if (!o.empty() && span.start <= o.end + 1 && span.end + 1 >= o.start)
+        o.union_(span.start, span.end);
+      else if (o.empty() || span.end - span.start > o.end - o.start)
+        o = span;
+    }
+  }
+
+  return true;
+}
+
+void TileRenderer::_renderTile(const Scene& scene, Worker& worker, uint32_t tileIndex) noexcept {
+  uint32_t start = _binOffsets[tileIndex];
+  uint32_t end = _binOffsets[tileIndex + 1];
+
+  int ts = int(_tileSize);
+  int x = int(tileIndex % _tilesX) * ts;
+  int y = int(tileIndex / _tilesX) * ts;
+
+  if (_hasBackground)
+    _dst->fillRect(x, y, ts, ts, _background);
+
+  if (start == end)
+    return;
+
+  TileRasterizer& ras = *worker.rasterizer;
+  ras.setTile(x, y, std::min(ts, _dst->width() - x), std::min(ts, _dst->height() - y));
+
+  // Without scratch memory for the culling pass the tile is rendered as is.
+  bool culling = _occlusionCulling && end - start > 1;
+  if (culling && !_cullTile(scene, worker, start, end)) {
+    ras.clear();
+    culling = false;
+  }
+
+  const Scene::Contour* contours = scene.contours();
+  const Point* points = scene.points();
+
+  worker.stats.shapeTiles += end - start;
+
+  for (uint32_t i = start; i < end; i++) {
+    const Scene::Shape& shape = scene.shapeAt(_binShapes[i]);
+
+    if (culling) {
+      const CulledShape& culledShape = worker.culledShapes[i - start];
+      if (culledShape.snapshotIndex == kCulled)
+        continue;
+
+      int y0 = std::max(shape.y0 - y, 0);
+      int y1 = std::min(shape.y1 - y, ras.tileH()) - 1;
+      ras.setOcclusion(worker.snapshots.data() + culledShape.snapshotIndex, y0, y1);
+
+      // The culling pass already accumulated the cells of this shape.
+      ras.loadCells(worker.savedRows.data() + culledShape.rowIndex, culledShape.rowCount, worker.savedCells.data());
+    }
+    else {
+      for (uint32_t c = 0; c < shape.contourCount; c++) {
+        const Scene::Contour& contour = contours[shape.contourIndex + c];
+        ras.addPoly(points + contour.pointIndex, contour.pointCount);
+      }
+    }
+
+    ras.setFillMode(shape.fillMode);
+    ras.render(shape.argb32);
+  }
+
+  ras.setOcclusion(nullptr, 0, -1);
+}
+
+void TileRenderer::_renderTileJob(void* data, uint32_t jobIndex, uint32_t workerId) noexcept {
+  TileRenderer* self = static_cast<TileRenderer*>(data);
+  uint32_t tileIndex = self->_tileList ? self->_tileList[jobIndex] : jobIndex;
+  self->_renderTile(*self->_scene, self->_workers[workerId], tileIndex);
+}
+
+bool TileRenderer::render(const Scene& scene) noexcept {
+  return renderTiles(scene, nullptr, 0);
+}
+
+bool TileRenderer::renderTiles(const Scene& scene, const uint32_t* tiles, uint32_t tileCount) noexcept {
+  // A worker without its own rasterizer cannot run jobs.
+  uint32_t workerCount = _pool ? _pool->workerCount() : 1;
+  if (_rasterizerCount != workerCount || !_bin(scene))
+    return false;
+
+  // No tile list means all tiles.
+  if (!tiles)
+    tileCount = _tilesX * _tilesY;
+
+  _scene = &scene;
+  _tileList = tiles;
+
+  if (_pool) {
+    _pool->run(_renderTileJob, this, tileCount);
+  }
+  else {
+    for (uint32_t i = 0; i < tileCount; i++)
+      _renderTileJob(this, i, 0);
+  }
+
+  _scene = nullptr;
+  _tileList = nullptr;
+  return true;
+}
@@ -0,0 +1,203 @@
+#ifndef _SCENE_H
+#define _SCENE_H
+
+#include "./globals.h"
+#include "./rasterizer.h"
+#include "./threadpool.h"
+#include "./tile.h"
+
+// ============================================================================
+// [Scene]
+// ============================================================================
+
+//! Recorded list of filled shapes.
+//!
+//! Works like the `Rasterizer` interface - `addPoly()` adds a contour to the
+//! current shape and `fill()` finishes the shape with the given color and fill
+//! mode. Contours are closed implicitly.
+class Scene {
+public:
+  struct Contour {
+    uint32_t pointIndex;
+    uint32_t pointCount;
+  };
+
+  struct Shape {
+    uint32_t contourIndex;
+    uint32_t contourCount;
+    uint32_t argb32;
+    uint32_t fillMode;
+
+    //! Bounding box of the shape in pixels as `[x0, x1) x [y0, y1)`.
+    int x0, y0, x1, y1;
+  };
+
+  Scene() noexcept;
+  ~Scene() noexcept;
+
+  Scene(const Scene& other) noexcept = delete;
+  Scene& operator=(const Scene& other) noexcept = delete;
+
+  //! Clears the scene and releases all memory.
+  void reset() noexcept;
+  //! Clears the scene, but keeps the memory for reuse.
+  void clear() noexcept;
+
+  bool addPoly(const Point* poly, size_t count) noexcept;
+  bool fill(uint32_t argb32, uint32_t fillMode) noexcept;
+
+  inline size_t shapeCount() const noexcept { return _shapes.size(); }
+  inline const Shape& shapeAt(size_t i) const noexcept { return _shapes[i]; }
+
+  //! Returns a hash of the geometry, color, and fill mode of the shape `i`,
+  //! used to find shapes that changed between frames.
+  uint64_t shapeHash(size_t i) const noexcept;
+
+  inline const Contour* contours() const noexcept { return _contours.data(); }
+  inline const Point* points() const noexcept { return _points.data(); }
+
+  PodArray<Shape> _shapes;
+  PodArray<Contour> _contours;
+  PodArray<Point> _points;
+
+  uint32_t _openContourIndex;
+  double _bounds[4];
+};
+
+// ============================================================================
+// [TileRenderer]
+// ============================================================================
+
+//! Tile-binned scene renderer.
+//!
+//! Shapes of a `Scene` are binned by their bounding boxes into square screen
+//! tiles. Each tile is then rasterized and composited independently by a
+//! `TileRasterizer`, so the destination pixels and cells of a tile stay in
+//! cache while all shapes that overlap it are rendered. Tiles are submitted as
+//! jobs to a `ThreadPool` (if given), each worker having its own
+//! `TileRasterizer` allocated once by the constructor.
+//!
+//! With occlusion culling enabled each tile is first processed front-to-back
+//! to find, per row, the pixels fully covered by shapes drawn later. As the
+//! compositors replace the destination where coverage is full (`overwrite()`),
+//! such pixels cannot be affected by earlier shapes regardless of their alpha.
+//! Shapes hidden within a tile are then skipped entirely (no cells are
+//! accumulated) and partially hidden shapes don't composite occluded pixels.
+//! Occluded pixels are tracked as a single interval per row, which is cheap
+//! and conservative - it works best for large fills like land and water.
+class TileRenderer {
+public:
+  enum : uint32_t {
+    kDefaultTileSize = 64
+  };
+
+  //! Overdraw statistics accumulated by `render()`.
+  struct Stats {
+    inline void reset() noexcept { *this = Stats {}; }
+
+    //! Number of rendered (shape, tile) pairs, including culled ones.
+    uint64_t shapeTiles;
+    //! Number of (shape, tile) pairs culled without accumulating cells.
+    uint64_t culledShapeTiles;
+    //! Pixels within bounding boxes of culled (shape, tile) pairs.
+    uint64_t culledPixels;
+    //! Pixels of rasterized shapes that were not composited as occluded.
+    uint64_t occludedPixels;
+  };
+
+  //! Per-worker scratch data.
+  //! Culling pass result of a shape of a bin.
+  struct CulledShape {
+    //! Index into `Worker::snapshots`, `kCulled` if the shape is culled.
+    uint32_t snapshotIndex;
+    //! Rows `[rowIndex, rowIndex + rowCount)` of `Worker::savedRows`.
+    uint32_t rowIndex;
+    uint32_t rowCount;
+  };
+
+  struct Worker {
+    TileRasterizer* rasterizer;
+    //! Occluded interval of each tile row, built front-to-back.
+    PodArray<Bounds> occlusion;
+    //! Fully covered span of each tile row of the current shape.
+    PodArray<Bounds> spans;
+    //! Occlusion seen by each shape of the bin (rows of its bounding box).
+    PodArray<Bounds> snapshots;
+    //! Culling pass result of each shape of the bin.
+    PodArray<CulledShape> culledShapes;
+    //! Cells of visible shapes saved by the culling pass, so `_renderTile()`
+    //! doesn't need to add their polygons again.
+    PodArray<TileRasterizer::SavedRow> savedRows;
+    PodArray<Cell> savedCells;
+    Stats stats;
+  };
+
+  enum : uint32_t {
+    kCulled = 0xFFFFFFFFu
+  };
+
+  TileRenderer(Image& dst, uint32_t options, uint32_t tileSize = kDefaultTileSize, ThreadPool* pool = nullptr) noexcept;
+  ~TileRenderer() noexcept;
+
+  TileRenderer(const TileRenderer& other) noexcept = delete;
+  TileRenderer& operator=(const TileRenderer& other) noexcept = delete;
+
+  inline uint32_t tileSize() const noexcept { return _tileSize; }
+  inline ThreadPool* pool() const noexcept { return _pool; }
+  inline uint32_t rasterizerCount() const noexcept { return _rasterizerCount; }
+
+  inline bool occlusionCulling() const noexcept { return _occlusionCulling; }
+  inline void setOcclusionCulling(bool value) noexcept { _occlusionCulling = value; }
+
+  //! Fills each rendered tile by `argb32` before rendering its shapes.
+  inline void setBackground(uint32_t argb32) noexcept {
+    _hasBackground = true;
+    _background = argb32;
+  }
+
+  inline void resetBackground() noexcept { _hasBackground = false; }
+
+  //! Returns statistics accumulated by all `render()` calls since the last
+  //! `resetStats()`.
+  Stats stats() const noexcept;
+  void resetStats() noexcept;
+
+  //! Renders the whole `scene` into the destination image.
+  bool render(const Scene& scene) noexcept;
+
+  //! Renders only `tileCount` tiles of the given indexes (row-major), pixels
+  //! outside of them are not touched.
+  bool renderTiles(const Scene& scene, const uint32_t* tiles, uint32_t tileCount) noexcept;
+
+  bool _bin(const Scene& scene) noexcept;
+  void _renderTile(const Scene& scene, Worker& worker, uint32_t tileIndex) noexcept;
+  bool _cullTile(const Scene& scene, Worker& worker, uint32_t start, uint32_t end) noexcept;
+
+  static void _renderTileJob(void* data, uint32_t jobIndex, uint32_t workerId) noexcept;
+
+  Image* _dst;
+  ThreadPool* _pool;
+  uint32_t _options;
+  uint32_t _tileSize;
+  uint32_t _rasterizerCount;
+  bool _occlusionCulling;
+  bool _hasBackground;
+  uint32_t _background;
+
+  uint32_t _tilesX;
+  uint32_t _tilesY;
+
+  //! Offsets into `_binShapes` of each tile (`tileCount + 1` items).
+  PodArray<uint32_t> _binOffsets;
+  //! Shape indexes of all bins, in scene order.
+  PodArray<uint32_t> _binShapes;
+
+  //! Scratch data, one per worker of `_pool`.
+  Worker* _workers;
+  //! Scene being rendered, only valid during `render()`.
+  const Scene* _scene;
+  //! Tiles being rendered, only valid during `renderTiles()`.
+  const uint32_t* _tileList;
+};
+
+#endif // _SCENE_H
@@ -0,0 +1,475 @@
+#include "./scenefile.h"
+
+// ============================================================================
+// [SceneFile - Tokenizer]
+// ============================================================================
+
+// All functions work on `[p, end)` of the mapped file, which is not NUL
+// terminated, and advance `p` past what they consumed.
+
+static inline bool isSpace(char c) noexcept { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool isDigit(char c) noexcept { return uint32_t(c - '0') < 10u; }
+static inline bool isAlpha(char c) noexcept { return uint32_t((c | 0x20) - 'a') < 26u; }
+
+static inline void skipSpaces(const char*& p, const char* end) noexcept {
+  while (p != end && isSpace(*p))
+    p++;
+}
+
+// Path data also separates numbers by commas.
+static inline void skipSeparators(const char*& p, const char* end) noexcept {
+  while (p != end && (isSpace(*p) || *p == ','))
+    p++;
+}
+
+// Matches `word` followed by a space or the end of the line.
+static bool matchWord(const char*& p, const char* end, const char* word) noexcept {
+  size_t n = strlen(word);
+  if (size_t(end - p) < n || memcmp(p, word, n) != 0 || (size_t(end - p) > n && !isSpace(p[n])))
+    return false;
+
+  p += n;
+  return true;
+}
+
+static bool parseInt(const char*& p, const char* end, int& out) noexcept {
+  const char* s = p;
+  int value = 0;
+
+  while (s != end && isDigit(*s)) {
+    if (value > (std::numeric_limits<int>::max() - 9) / 10)
+      return false;
+    value = value * 10 + (*s++ - '0');
+  }
+
+  if (s == p)
+    return false;
+
+  p = s;
+  out = value;
+  return true;
+}
+
+// Parses a number of SVG path data - `[+-](digits[.digits]|.digits)[(e|E)[+-]digits]`.
+//
+// The mantissa is accumulated as an integer and scaled by an exact power of
+// ten, which is correctly rounded for all numbers of up to 15 significant
+// digits (that's more than any asset uses).
+static bool parseNumber(const char*& p, const char* end, double& out) noexcept {
+  static const double pow10[] = {
+    1e0 , 1e1 , 1e2 , 1e3 , 1e4 , 1e5 , 1e6 , 1e7 , 1e8 , 1e9 , 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  const char* s = p;
+  bool negative = false;
+
+  if (s != end && (*s == '+' || *s == '-'))
+    negative = *s++ == '-';
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  uint32_t digits = 0;
+
+  for (; s != end && isDigit(*s); s++, digits++) {
+    if (mantissa < 100000000000000000u)
+      mantissa = mantissa * 10 + uint32_t(*s - '0');
+    else
+      exponent++;
+  }
+
+  if (s != end && *s == '.') {
+    s++;
+    for (; s != end && isDigit(*s); s++, digits++) {
+      if (mantissa < 100000000000000000u) {
+        mantissa = mantissa * 10 + uint32_t(*s - '0');
+        exponent--;
+      }
+    }
+  }
+
+  if (!digits)
+    return false;
+
+  // The exponent is only consumed if it has digits, `e` alone is not a number.
+  if (s != end && (*s | 0x20) == 'e') {
+    const char* e = s + 1;
+    bool negativeExponent = false;
+
+    if (e != end && (*e == '+' || *e == '-'))
+      negativeExponent = *e++ == '-';
+
+    if (e != end && isDigit(*e)) {
+      int value = 0;
+      for (; e != end && isDigit(*e); e++)
+        value = std::min(value * 10 + (*e - '0'), 1000);
+      exponent += negativeExponent ? -value : value;
+      s = e;
+    }
+  }
+
+  double value = double(mantissa);
+  if (exponent != 0) {
+    if (exponent > 0)
+      value = exponent <= 22 ? value * pow10[exponent] : value * std::pow(10.0, double(exponent));
+    else
+      value = exponent >= -22 ? value / pow10[-exponent] : value * std::pow(10.0, double(exponent));
+  }
+
+  p = s;
+  out = negative ? -value : value;
+  return std::isfinite(out);
+}
+
+static inline uint32_t hexValue(char c) noexcept {
+  if (isDigit(c))
+    return uint32_t(c - '0');
+
+  uint32_t lower = uint32_t((c | 0x20) - 'a');
+  return lower < 6u ? lower + 10 : 0xFFu;
+}
+
+// Parses `#RGB`, `#RRGGBB`, or `#RRGGBBAA` and returns the color as ARGB32.
+static bool parseColor(const char*& p, const char* end, uint32_t& out) noexcept {
+  if (p == end || *p != '#')
+    return false;
+
+  const char* s = p + 1;
+  uint32_t value = 0;
+  uint32_t n = 0;
+
+  for (; s != end && !isSpace(*s); s++, n++) {
+    uint32_t digit = hexValue(*s);
+    if (digit > 0xF || n == 8)
+      return false;
+    value = (value << 4) | digit;
+  }
+
+  switch (n) {
+    case 3:
+      value = ((value & 0xF00u) << 8) | ((value & 0x0F0u) << 4) | (value & 0x00Fu);
+      out = 0xFF000000u | (value * 0x11u);
+      break;
+
+    case 6:
+      out = 0xFF000000u | value;
+      break;
+
+    case 8:
+      out = (value >> 8) | (value << 24);
+      break;
+
+    default:
+      return false;
+  }
+
+  p = s;
+  return true;
+}
+
+// ============================================================================
+// [SceneFile - Flattening]
+// ============================================================================
+
+// Number of segments of a curve whose second derivative is at most `dd` so
+// that the segments deviate at most `tolerance` from it. A chord of a
+// parameter interval `h` deviates at most `h^2 / 8 * dd`.
+static inline uint32_t curveSegmentCount(double dd, double tolerance) noexcept {
+  double n = std::ceil(std::sqrt(dd / (8.0 * tolerance)));
+  return n <= 1.0 ? 1u : uint32_t(std::min(n, double(SceneFile::kMaxCurveSegments)));
+}
+
+static bool flattenQuad(PodArray<Point>& out, const Point& p0, const Point& p1, const Point& p2, double tolerance) noexcept {
+  // Second derivative is constant - `2 * (p0 - 2p1 + p2)`.
+  double ddx = p0.x - 2.0 * p1.x + p2.x;
+  double ddy = p0.y - 2.0 * p1.y + p2.y;
+  uint32_t n = curveSegmentCount(2.0 * std::hypot(ddx, ddy), tolerance);
+
+  if (!out.reserve(out.size() + n))
+    return false;
+
+  double step = 1.0 / double(n);
+  for (uint32_t i = 1; i < n; i++) {
+    double t = double(i) * step;
+    double u = 1.0 - t;
+
+    double a = u * u;
+    double b = 2.0 * u * t;
+    double c = t * t;
+
+    out.append(Point { a * p0.x + b * p1.x + c * p2.x, a * p0.y + b * p1.y + c * p2.y });
+  }
+
+  out.append(p2);
+  return true;
+}
+
+static bool flattenCubic(PodArray<Point>& out, const Point& p0, const Point& p1, const Point& p2, const Point& p3, double tolerance) noexcept {
+  // Second derivative is linear, its maximum is at one of the ends - six times
+  // the larger of `p0 - 2p1 + p2` and `p1 - 2p2 + p3`.
+  double dd0 = std::hypot(p0.x - 2.0 * p1.x + p2.x, p0.y - 2.0 * p1.y + p2.y);
+  double dd1 = std::hypot(p1.x - 2.0 * p2.x + p3.x, p1.y - 2.0 * p2.y + p3.y);
+  uint32_t n = curveSegmentCount(6.0 * std::max(dd0, dd1), tolerance);
+
+  if (!out.reserve(out.size() + n))
+    return false;
+
+  double step = 1.0 / double(n);
+  for (uint32_t i = 1; i < n; i++) {
+    double t = double(i) * step;
+    double u = 1.0 - t;
+
+    double a = u * u * u;
+    double b = 3.0 * u * u * t;
+    double c = 3.0 * u * t * t;
+    double d = t * t * t;
+
+    out.append(Point { a * p0.x + b * p1.x + c * p2.x + d * p3.x,
+                       a * p0.y + b * p1.y + c * p2.y + d * p3.y });
+  }
+
+  out.append(p3);
+  return true;
+}
+
+// ============================================================================
+// [SceneFile - Construction / Destruction]
+// ============================================================================
+
+SceneFile::SceneFile() noexcept
+  : _width(0),
+    _height(0),
+    _errorLine(0),
+    _errorMessage("") {}
+
+SceneFile::~SceneFile() noexcept {}
+
+bool SceneFile::open(const char* fileName) noexcept {
+  reset();
+  return _file.open(fileName);
+}
+
+void SceneFile::reset() noexcept {
+  _file.reset();
+  _contour.reset();
+
+  _width = 0;
+  _height = 0;
+  _errorLine = 0;
+  _errorMessage = "";
+}
+
+// ============================================================================
+// [SceneFile - Load]
+// ============================================================================
+
+bool SceneFile::load(Scene& scene, double tolerance) noexcept {
+  scene.clear();
+
+  _width = 0;
+  _height = 0;
+  _errorLine = 0;
+  _errorMessage = "";
+
+  if (!(tolerance > 0.0)) {
+    _errorMessage = "Invalid tolerance";
+    return false;
+  }
+
+  const char* p = reinterpret_cast<const char*>(_file.data());
+  const char* fileEnd = p + _file.size();
+  uint32_t line = 0;
+
+  while (p != fileEnd) {
+    const char* end = static_cast<const char*>(memchr(p, '\n', size_t(fileEnd - p)));
+    const char* next = end ? end + 1 : fileEnd;
+
+    if (!end)
+      end = fileEnd;
+
+    _errorLine = ++line;
+    skipSpaces(p, end);
+
+    if (p == end || *p == '#') {
+      // Empty line or comment.
+    }
+    else if (matchWord(p, end, "size")) {
+      skipSpaces(p, end);
+      if (!parseInt(p, end, _width)) {
+        _errorMessage = "Invalid width";
+        return false;
+      }
+
+      skipSpaces(p, end);
+      if (!parseInt(p, end, _height)) {
+        _errorMessage = "Invalid height";
+        return false;
+      }
+
+      skipSpaces(p, end);
+      if (p != end || _width <= 0 || _height <= 0) {
+        _errorMessage = "Invalid size";
+        return false;
+      }
+    }
+    else if (matchWord(p, end, "path")) {
+      if (!_loadPath(scene, p, end, tolerance))
+        return false;
+    }
+    else {
+      _errorMessage = "Unknown statement";
+      return false;
+    }
+
+    p = next;
+  }
+
+  _errorLine = 0;
+  return true;
+}
+
+bool SceneFile::_loadPath(Scene& scene, const char* p, const char* end, double tolerance) noexcept {
+  uint32_t argb32;
+  uint32_t fillMode;
+
+  skipSpaces(p, end);
+  if (!parseColor(p, end, argb32)) {
+    _errorMessage = "Invalid color";
+    return false;
+  }
+
+  skipSpaces(p, end);
+  if (matchWord(p, end, "nonzero")) {
+    fillMode = Rasterizer::kFillNonZero;
+  }
+  else if (matchWord(p, end, "evenodd")) {
+    fillMode = Rasterizer::kFillEvenOdd;
+  }
+  else {
+    _errorMessage = "Invalid fill rule";
+    return false;
+  }
+
+  // Current point and the start of the current subpath.
+  Point cur { 0.0, 0.0 };
+  Point start { 0.0, 0.0 };
+
+  _contour.clear();
+  char cmd = 0;
+
+  for (;;) {
+    skipSeparators(p, end);
+    if (p == end)
+      break;
+
+    if (isAlpha(*p)) {
+      cmd = *p++;
+
+      if ((cmd | 0x20) == 'z') {
+        if (!_flushContour(scene))
+          goto OutOfMemory;
+        cur = start;
+        continue;
+      }
+
+      if (!strchr("MLHVQCmlhvqc", cmd)) {
+        _errorMessage = "Unsupported path command";
+        return false;
+      }
+
+      skipSeparators(p, end);
+    }
+    else if (!cmd || (cmd | 0x20) == 'z') {
+      _errorMessage = "Expected a path command";
+      return false;
+    }
+
+    // Arguments of `cmd`, relative commands are relative to the current point.
+    uint32_t argCount = 0;
+    switch (cmd | 0x20) {
+      case 'h':
+      case 'v': argCount = 1; break;
+      case 'm':
+      case 'l': argCount = 2; break;
+      case 'q': argCount = 4; break;
+      case 'c': argCount = 6; break;
+    }
+
+    double args[6];
+    for (uint32_t i = 0; i < argCount; i++) {
+      if (i)
+        skipSeparators(p, end);
+
+      if (!parseNumber(p, end, args[i])) {
+        _errorMessage = "Invalid number";
+        return false;
+      }
+    }
+
+    bool relative = cmd >= 'a';
+    Point pts[3];
+
+    switch (cmd | 0x20) {
+      case 'h':
+        pts[0] = Point { relative ? cur.x + args[0] : args[0], cur.y };
+        argCount = 2;
+        break;
+
+      case 'v':
+        pts[0] = Point { cur.x, relative ? cur.y + args[0] : args[0] };
+        argCount = 2;
+        break;
+
+      default:
+        for (uint32_t i = 0; i < argCount; i += 2)
+          pts[i / 2] = relative ? Point { cur.x + args[i], cur.y + args[i + 1] } : Point { args[i], args[i + 1] };
+        break;
+    }
+
+    if ((cmd | 0x20) == 'm') {
+      if (!_flushContour(scene) || !_contour.append(pts[0]))
+        goto OutOfMemory;
+
+      start = pts[0];
+      cur = pts[0];
+
+      // Coordinates that follow a move are implicit line-to commands.
+      cmd = relative ? 'l' : 'L';
+      continue;
+    }
+
+    // A drawing command after `Z` starts a new subpath at the current point.
+    if (_contour.empty()) {
+      if (!_contour.append(cur))
+        goto OutOfMemory;
+      start = cur;
+    }
+
+    bool ok;
+    switch (cmd | 0x20) {
+      case 'q': ok = flattenQuad(_contour, cur, pts[0], pts[1], tolerance); break;
+      case 'c': ok = flattenCubic(_contour, cur, pts[0], pts[1], pts[2], tolerance); break;
+      default : ok = _contour.append(pts[0]); break;
+    }
+
+    if (!ok)
+      goto OutOfMemory;
+
+    cur = pts[argCount / 2 - 1];
+  }
+
+  if (!_flushContour(scene) || !scene.fill(argb32, fillMode))
+    goto OutOfMemory;
+  return true;
+
+OutOfMemory:
+  _errorMessage = "Out of memory";
+  return false;
+}
+
+bool SceneFile::_flushContour(Scene& scene) noexcept {
+  // Contours are closed implicitly by `Scene::addPoly()`.
+  bool ok = scene.addPoly(_contour.data(), _contour.size());
+  _contour.clear();
+  return ok;
+}
@@ -0,0 +1,76 @@
+#ifndef _SCENEFILE_H
+#define _SCENEFILE_H
+
+#include "./globals.h"
+#include "./scene.h"
+
+// ============================================================================
+// [SceneFile]
+// ============================================================================
+
+//! Scene file loader.
+//!
+//! A scene file is a line based text format of filled paths:
+//!
+//!   # Comment.
+//!   size 256 256
+//!   path #FF8000 nonzero M10 10 L246 10 Q246 246 10 246Z
+//!   path #0080FF80 evenodd M20,20 C100,0 150,200 230,230z m100 100 h20 v20 h-20z
+//!
+//! `size W H` is the canvas size the scene was drawn for (optional). Each
+//! `path` is a shape filled by a color (`#RGB`, `#RRGGBB`, or `#RRGGBBAA` like
+//! in CSS) and a fill rule (`nonzero` or `evenodd`), followed by SVG path data
+//! on the same line. Path data can use `M`, `L`, `H`, `V`, `Q`, `C`, and `Z`
+//! commands (absolute and relative), curves are flattened to line segments.
+//!
+//! The file is mapped and tokenized in place - the parser doesn't allocate
+//! anything except the storage of the resulting `Scene` and a scratch buffer
+//! of the current contour, which is reused by all paths.
+class SceneFile {
+public:
+  enum : uint32_t {
+    //! Maximum number of line segments of a single curve.
+    kMaxCurveSegments = 256
+  };
+
+  SceneFile() noexcept;
+  ~SceneFile() noexcept;
+
+  SceneFile(const SceneFile& other) noexcept = delete;
+  SceneFile& operator=(const SceneFile& other) noexcept = delete;
+
+  //! Maps scene file `fileName`, which is then parsed by `load()`.
+  bool open(const char* fileName) noexcept;
+  void reset() noexcept;
+
+  //! Clears `scene` and parses all paths into it. Curves are flattened so
+  //! their line segments deviate at most `tolerance` pixels from the curve.
+  //!
+  //! Returns `false` on a syntax error (see `errorLine()` and `errorMessage()`)
+  //! or if out of memory.
+  bool load(Scene& scene, double tolerance = 0.25) noexcept;
+
+  //! Canvas size given by `size`, zero if the scene doesn't specify it (only
+  //! valid after `load()`).
+  inline int width() const noexcept { return _width; }
+  inline int height() const noexcept { return _height; }
+
+  //! Line (starting at 1) and description of the error of the last `load()`.
+  inline uint32_t errorLine() const noexcept { return _errorLine; }
+  inline const char* errorMessage() const noexcept { return _errorMessage; }
+
+  bool _loadPath(Scene& scene, const char* p, const char* end, double tolerance) noexcept;
+  bool _flushContour(Scene& scene) noexcept;
+
+  MappedFile _file;
+  //! Points of the contour being parsed.
+  PodArray<Point> _contour;
+
+  int _width;
+  int _height;
+
+  uint32_t _errorLine;
+  const char* _errorMessage;
+};
+
+#endif // _SCENEFILE_H
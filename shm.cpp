@@ -0,0 +1,327 @@
+#include "./shm.h"
+
+#if defined(__linux__)
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <linux/futex.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <sys/syscall.h>
+  #include <time.h>
+  #include <unistd.h>
+#endif
+
+// ============================================================================
+// [SharedFrameBuffer - Utilities]
+// ============================================================================
+
+#if defined(__linux__)
+static int64_t shmMonotonicNs() noexcept {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return int64_t(ts.tv_sec) * 1000000000 + int64_t(ts.tv_nsec);
+}
+
+static size_t shmAlignUp(size_t x, size_t alignment) noexcept {
+  return (x + alignment - 1) / alignment * alignment;
+}
+#endif
+
+static int64_t shmDeadline(int timeoutMs) noexcept {
+#if defined(__linux__)
+  return timeoutMs < 0 ? -1 : shmMonotonicNs() + int64_t(timeoutMs) * 1000000;
+#else
+  (void)timeoutMs;
+  return -1;
+#endif
+}
+
+// ============================================================================
+// [SharedFrameBuffer - Construction / Destruction]
+// ============================================================================
+
+SharedFrameBuffer::SharedFrameBuffer() noexcept
+  : _fd(-1),
+    _role(kRoleNone),
+    _backIndex(kStateNone),
+    _frontIndex(kStateNone),
+    _frontSequence(0),
+    _header(nullptr),
+    _mappingSize(0) {}
+
+SharedFrameBuffer::~SharedFrameBuffer() noexcept {
+  reset();
+}
+
+bool SharedFrameBuffer::isSupported() noexcept {
+#if defined(__linux__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+// ============================================================================
+// [SharedFrameBuffer - Create / Open / Reset]
+// ============================================================================
+
+bool SharedFrameBuffer::create(int w, int h, uint32_t bufferCount) noexcept {
+  reset();
+
+#if defined(__linux__)
+  if (w <= 0 || h <= 0 || bufferCount < 2 || bufferCount > SharedFrameHeader::kMaxBuffers)
+    return false;
+
+  size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+  size_t stride = shmAlignUp(size_t(w) * 4, Image::kRowAlignment);
+  size_t bufferOffset = shmAlignUp(sizeof(SharedFrameHeader), pageSize);
+  size_t bufferSize = shmAlignUp(stride * size_t(h), pageSize);
+  size_t size = bufferOffset + bufferSize * bufferCount;
+
+  int fd = int(syscall(SYS_memfd_create, "b2drefras-frames", unsigned(MFD_CLOEXEC)));
+  if (fd < 0)
+    return false;
+
+  if (ftruncate(fd, off_t(size)) != 0 || !_map(fd, size)) {
+    close(fd);
+    return false;
+  }
+
+  // The file is zero initialized, so only non-zero fields are written.
+  SharedFrameHeader* header = _header;
+  header->magic = SharedFrameHeader::kMagic;
+  header->bufferCount = bufferCount;
+  header->width = w;
+  header->height = h;
+  header->stride = int64_t(stride);
+  header->bufferOffset = bufferOffset;
+  header->bufferSize = bufferSize;
+
+  // The producer starts with buffer 0, buffer 1 is the middle one and the
+  // consumer owns buffer 2 (if triple buffered) without having a frame in it.
+  header->state.store(1, std::memory_order_release);
+
+  _role = kRoleProducer;
+  _backIndex = 0;
+  _attach(_back, _backIndex);
+  return true;
+#else
+  (void)w;
+  (void)h;
+  (void)bufferCount;
+  return false;
+#endif
+}
+
+bool SharedFrameBuffer::open(int fd) noexcept {
+  reset();
+
+#if defined(__linux__)
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SharedFrameHeader))
+    return false;
+
+  int dupFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (dupFd < 0)
+    return false;
+
+  size_t size = size_t(st.st_size);
+  if (!_map(dupFd, size)) {
+    close(dupFd);
+    return false;
+  }
+
+  // Don't trust the header more than necessary, the file comes from another
+  // process.
+  const SharedFrameHeader* header = _header;
+  if (header->magic != SharedFrameHeader::kMagic ||
+      header->bufferCount < 2 || header->bufferCount > SharedFrameHeader::kMaxBuffers ||
+      header->width <= 0 || header->height <= 0 ||
+      header->stride < int64_t(header->width) * 4 ||
+      header->bufferSize < uint64_t(header->stride) * uint64_t(header->height) ||
+      header->bufferOffset < sizeof(SharedFrameHeader) ||
+      header->bufferOffset + header->bufferSize * header->bufferCount > size) {
+    reset();
+    return false;
+  }
+
+  _role = kRoleConsumer;
+  _frontIndex = header->bufferCount == 3 ? 2 : uint32_t(kStateNone);
+  return true;
+#else
+  (void)fd;
+  return false;
+#endif
+}
+
+void SharedFrameBuffer::reset() noexcept {
+  _back.reset();
+  _front.reset();
+
+#if defined(__linux__)
+  if (_header)
+    munmap(_header, _mappingSize);
+
+  if (_fd >= 0)
+    close(_fd);
+#endif
+
+  _fd = -1;
+  _role = kRoleNone;
+  _backIndex = kStateNone;
+  _frontIndex = kStateNone;
+  _frontSequence = 0;
+  _header = nullptr;
+  _mappingSize = 0;
+}
+
+bool SharedFrameBuffer::_map(int fd, size_t size) noexcept {
+#if defined(__linux__)
+  void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    return false;
+
+  _fd = fd;
+  _header = static_cast<SharedFrameHeader*>(p);
+  _mappingSize = size;
+  return true;
+#else
+  (void)fd;
+  (void)size;
+  return false;
+#endif
+}
+
+uint8_t* SharedFrameBuffer::_bufferData(uint32_t index) const noexcept {
+  return reinterpret_cast<uint8_t*>(_header) + _header->bufferOffset + size_t(index) * _header->bufferSize;
+}
+
+void SharedFrameBuffer::_attach(Image& image, uint32_t index) noexcept {
+  if (index == kStateNone)
+    image.reset();
+  else
+    image.attach(_bufferData(index), _header->width, _header->height, intptr_t(_header->stride));
+}
+
+// ============================================================================
+// [SharedFrameBuffer - Wait / Wake]
+// ============================================================================
+
+// The state word is used as a futex (not private, it's shared by processes),
+// `_wait()` returns `false` on timeout and `true` if the caller should check
+// the state again.
+bool SharedFrameBuffer::_wait(uint32_t observed, int64_t deadline) noexcept {
+#if defined(__linux__)
+  struct timespec ts;
+  struct timespec* timeout = nullptr;
+
+  if (deadline >= 0) {
+    int64_t remaining = deadline - shmMonotonicNs();
+    if (remaining <= 0)
+      return false;
+
+    ts.tv_sec = time_t(remaining / 1000000000);
+    ts.tv_nsec = long(remaining % 1000000000);
+    timeout = &ts;
+  }
+
+  uint32_t* addr = reinterpret_cast<uint32_t*>(&_header->state);
+  if (syscall(SYS_futex, addr, FUTEX_WAIT, observed, timeout, nullptr, 0) != 0 && errno == ETIMEDOUT)
+    return false;
+  return true;
+#else
+  (void)observed;
+  (void)deadline;
+  return false;
+#endif
+}
+
+void SharedFrameBuffer::_wake() noexcept {
+#if defined(__linux__)
+  uint32_t* addr = reinterpret_cast<uint32_t*>(&_header->state);
+  syscall(SYS_futex, addr, FUTEX_WAKE, 0x7FFFFFFF, nullptr, nullptr, 0);
+#endif
+}
+
+// ============================================================================
+// [SharedFrameBuffer - Producer]
+// ============================================================================
+
+bool SharedFrameBuffer::present(uint64_t sequence, int timeoutMs) noexcept {
+  if (_role != kRoleProducer)
+    return false;
+
+  SharedFrameHeader* header = _header;
+  header->sequence[_backIndex] = sequence;
+
+  bool doubleBuffered = header->bufferCount == 2;
+  int64_t deadline = shmDeadline(timeoutMs);
+  uint32_t state = header->state.load(std::memory_order_acquire);
+
+  for (;;) {
+    // A double buffered target has either no middle buffer (the consumer holds
+    // it) or the previous frame in it, which must not be dropped.
+    if ((state & kStateIndexMask) == kStateNone || (doubleBuffered && (state & kStateFresh))) {
+      if (!_wait(state, deadline))
+        return false;
+      state = header->state.load(std::memory_order_acquire);
+      continue;
+    }
+
+    // Release makes pixels and the sequence visible to the consumer, acquire
+    // makes sure the consumer is done reading the buffer taken back.
+    if (header->state.compare_exchange_weak(state, _backIndex | kStateFresh, std::memory_order_acq_rel, std::memory_order_acquire))
+      break;
+  }
+
+  _wake();
+  _backIndex = state & kStateIndexMask;
+  _attach(_back, _backIndex);
+  return true;
+}
+
+// ============================================================================
+// [SharedFrameBuffer - Consumer]
+// ============================================================================
+
+bool SharedFrameBuffer::acquire(int timeoutMs) noexcept {
+  if (_role != kRoleConsumer)
+    return false;
+
+  SharedFrameHeader* header = _header;
+  int64_t deadline = shmDeadline(timeoutMs);
+  uint32_t state = header->state.load(std::memory_order_acquire);
+
+  for (;;) {
+    if (!(state & kStateFresh)) {
+      if (timeoutMs == 0 || !_wait(state, deadline))
+        return false;
+      state = header->state.load(std::memory_order_acquire);
+      continue;
+    }
+
+    // Without a front buffer (double buffering) the middle becomes empty.
+    if (header->state.compare_exchange_weak(state, _frontIndex, std::memory_order_acq_rel, std::memory_order_acquire))
+      break;
+  }
+
+  _wake();
+  _frontIndex = state & kStateIndexMask;
+  _frontSequence = header->sequence[_frontIndex];
+  _attach(_front, _frontIndex);
+  return true;
+}
+
+void SharedFrameBuffer::release() noexcept {
+  if (_role != kRoleConsumer || _frontIndex == kStateNone)
+    return;
+
+  // Only succeeds if there is no middle buffer, which is never the case when
+  // triple buffered - the consumer keeps the front buffer until `acquire()`.
+  uint32_t expected = kStateNone;
+  if (_header->state.compare_exchange_strong(expected, _frontIndex, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+    _frontIndex = kStateNone;
+    _front.reset();
+    _wake();
+  }
+}
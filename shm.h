@@ -0,0 +1,151 @@
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "./globals.h"
+
+#include <atomic>
+
+// ============================================================================
+// [SharedFrameHeader]
+// ============================================================================
+
+//! Header at the beginning of a shared frame buffer mapping, followed by the
+//! pixel buffers (each starting at a page boundary).
+struct SharedFrameHeader {
+  enum : uint32_t {
+    kMagic = 0x46524D53u, // 'SMRF'.
+    kMaxBuffers = 3
+  };
+
+  uint32_t magic;
+  uint32_t bufferCount;
+  int32_t width;
+  int32_t height;
+  int64_t stride;
+  uint64_t bufferOffset;
+  uint64_t bufferSize;
+
+  //! Index of the buffer owned by neither side (`SharedFrameBuffer::kStateNone`
+  //! if there is none) combined with `SharedFrameBuffer::kStateFresh` if it
+  //! contains a frame not acquired by the consumer yet. It's also a futex.
+  std::atomic<uint32_t> state;
+  uint32_t reserved;
+
+  //! Frame sequence of each buffer, written by the producer before `present()`.
+  uint64_t sequence[kMaxBuffers];
+};
+
+// ============================================================================
+// [SharedFrameBuffer]
+// ============================================================================
+
+//! Double or triple buffered render target in shared memory (Linux only).
+//!
+//! Pixel buffers live in a `memfd_create()` file mapped by both a producer
+//! process, which renders into the back buffer by any rasterizer (it's just an
+//! `Image` view), and a consumer process, which reads the front buffer. Frames
+//! are passed by swapping buffer indexes in a single atomic word of the shared
+//! header, pixels are never copied or serialized.
+//!
+//! The buffer that is owned by neither side is called middle. `present()`
+//! exchanges the back buffer with the middle one and marks it fresh, and
+//! `acquire()` exchanges the front buffer with a fresh middle one:
+//!
+//!   - Triple buffering - the producer never waits, a frame the consumer
+//!     didn't acquire in time is replaced by a newer one (latest frame wins).
+//!   - Double buffering - there is no middle buffer while the consumer holds
+//!     the front one, so `present()` waits until the consumer acquires the
+//!     previous frame and calls `release()` (a display would do that after
+//!     scanning the frame out). No frame is dropped.
+//!
+//! The file descriptor can be passed to the consumer by `fork()` or over a
+//! unix socket (`SCM_RIGHTS`), the consumer then calls `open()`.
+class SharedFrameBuffer {
+public:
+  enum : uint32_t {
+    kStateNone = 0x3u,
+    kStateIndexMask = 0x3u,
+    kStateFresh = 0x4u
+  };
+
+  enum Role : uint32_t {
+    kRoleNone = 0,
+    kRoleProducer = 1,
+    kRoleConsumer = 2
+  };
+
+  SharedFrameBuffer() noexcept;
+  ~SharedFrameBuffer() noexcept;
+
+  SharedFrameBuffer(const SharedFrameBuffer& other) noexcept = delete;
+  SharedFrameBuffer& operator=(const SharedFrameBuffer& other) noexcept = delete;
+
+  //! Returns `true` if shared frame buffers are supported by the platform.
+  static bool isSupported() noexcept;
+
+  //! Creates a new shared memory file of `bufferCount` (2 or 3) buffers of
+  //! `w` x `h` pixels and maps it as a producer.
+  bool create(int w, int h, uint32_t bufferCount) noexcept;
+
+  //! Maps an existing shared memory file `fd` (the descriptor is duplicated)
+  //! as a consumer.
+  bool open(int fd) noexcept;
+
+  void reset() noexcept;
+
+  inline int fd() const noexcept { return _fd; }
+  inline uint32_t role() const noexcept { return _role; }
+  inline int width() const noexcept { return _header ? _header->width : 0; }
+  inline int height() const noexcept { return _header ? _header->height : 0; }
+  inline uint32_t bufferCount() const noexcept { return _header ? _header->bufferCount : 0; }
+
+  // --------------------------------------------------------------------------
+  // [Producer]
+  // --------------------------------------------------------------------------
+
+  //! Returns the back buffer to render into.
+  inline Image& backBuffer() noexcept { return _back; }
+
+  //! Publishes the back buffer as frame `sequence` and takes a new back buffer.
+  //! Waits at most `timeoutMs` milliseconds (negative waits forever) for the
+  //! consumer in double buffering mode, returns `false` on timeout.
+  bool present(uint64_t sequence, int timeoutMs = -1) noexcept;
+
+  // --------------------------------------------------------------------------
+  // [Consumer]
+  // --------------------------------------------------------------------------
+
+  //! Takes the latest presented frame as the front buffer, waits at most
+  //! `timeoutMs` milliseconds for it (zero polls, negative waits forever).
+  //! Returns `false` if no new frame was presented in time.
+  bool acquire(int timeoutMs = -1) noexcept;
+
+  //! Gives the front buffer back, required in double buffering mode before the
+  //! producer can present another frame.
+  void release() noexcept;
+
+  //! Returns the front buffer, which is empty if no frame was acquired.
+  inline const Image& frontBuffer() const noexcept { return _front; }
+  //! Returns the sequence of the front buffer frame.
+  inline uint64_t frontSequence() const noexcept { return _frontSequence; }
+
+  bool _map(int fd, size_t size) noexcept;
+  uint8_t* _bufferData(uint32_t index) const noexcept;
+  void _attach(Image& image, uint32_t index) noexcept;
+  bool _wait(uint32_t observed, int64_t deadline) noexcept;
+  void _wake() noexcept;
+
+  int _fd;
+  uint32_t _role;
+  uint32_t _backIndex;
+  uint32_t _frontIndex;
+  uint64_t _frontSequence;
+
+  SharedFrameHeader* _header;
+  size_t _mappingSize;
+
+  Image _back;
+  Image _front;
+};
+
+#endif // _SHM_H
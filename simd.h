@@ -382,6 +382,8 @@ SIMD_INLINE void vstorei32(void* p, const I128& x) noexcept { static_cast<int*>(
 SIMD_INLINE void vstorei64(void* p, const I128& x) noexcept { _mm_storel_epi64(static_cast<I128*>(p), x); }
 SIMD_INLINE void vstorei128a(void* p, const I128& x) noexcept { _mm_store_si128(static_cast<I128*>(p), x); }
 SIMD_INLINE void vstorei128u(void* p, const I128& x) noexcept { _mm_storeu_si128(static_cast<I128*>(p), x); }
+SIMD_INLINE void vstreami128(void* p, const I128& x) noexcept { _mm_stream_si128(static_cast<I128*>(p), x); }
+SIMD_INLINE void vsfence() noexcept { _mm_sfence(); }
 
 SIMD_INLINE void vstoreli64(void* p, const I128& x) noexcept { _mm_storel_epi64(static_cast<I128*>(p), x); }
 SIMD_INLINE void vstorehi64(void* p, const I128& x) noexcept { _mm_storeh_pd(static_cast<double*>(p), vcast<D128>(x)); }
@@ -0,0 +1,229 @@
+#include "./threadpool.h"
+
+// ============================================================================
+// [WorkDeque - Construction / Destruction]
+// ============================================================================
+
+WorkDeque::WorkDeque() noexcept
+  : _top(0),
+    _bottom(0),
+    _buffer(nullptr),
+    _mask(0) {}
+
+WorkDeque::~WorkDeque() noexcept {
+  std::free(_buffer);
+}
+
+// ============================================================================
+// [WorkDeque - Init]
+// ============================================================================
+
+bool WorkDeque::init(size_t capacity) noexcept {
+  _top.store(0, std::memory_order_relaxed);
+  _bottom.store(0, std::memory_order_relaxed);
+
+  if (!_buffer || capacity > _mask + 1) {
+    size_t n = 16;
+    while (n < capacity)
+      n *= 2;
+
+    // `std::atomic<uint32_t>` is a standard-layout type without a constructor
+    // that does anything, so a raw allocation is fine.
+    void* p = std::realloc(_buffer, n * sizeof(std::atomic<uint32_t>));
+    if (!p)
+      return false;
+
+    _buffer = static_cast<std::atomic<uint32_t>*>(p);
+    _mask = n - 1;
+  }
+
+  return true;
+}
+
+// ============================================================================
+// [ThreadPool - Construction / Destruction]
+// ============================================================================
+
+ThreadPool::ThreadPool(uint32_t workerCount) noexcept
+  : _workerCount(0),
+    _threads(nullptr),
+    _deques(nullptr),
+    _generation(0),
+    _busyThreads(0),
+    _stop(false),
+    _func(nullptr),
+    _data(nullptr),
+    _remaining(0) {
+
+  if (workerCount == 0)
+    workerCount = hardwareConcurrency();
+
+  _deques = static_cast<WorkDeque*>(std::malloc(workerCount * sizeof(WorkDeque)));
+  if (!_deques) {
+    _workerCount = 1;
+    return;
+  }
+
+  for (uint32_t i = 0; i < workerCount; i++)
+    new(&_deques[i]) WorkDeque();
+  _workerCount = workerCount;
+
+  if (workerCount > 1) {
+    _threads = static_cast<std::thread*>(std::malloc((workerCount - 1) * sizeof(std::thread)));
+    if (!_threads) {
+      _workerCount = 1;
+      return;
+    }
+
+    for (uint32_t i = 1; i < workerCount; i++)
+      new(&_threads[i - 1]) std::thread(&ThreadPool::_threadMain, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() noexcept {
+  if (_threads) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _wakeCondition.notify_all();
+
+    for (uint32_t i = 1; i < _workerCount; i++) {
+      _threads[i - 1].join();
+      _threads[i - 1].~thread();
+    }
+    std::free(_threads);
+  }
+
+  if (_deques) {
+    for (uint32_t i = 0; i < _workerCount; i++)
+      _deques[i].~WorkDeque();
+    std::free(_deques);
+  }
+}
+
+uint32_t ThreadPool::hardwareConcurrency() noexcept {
+  return std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+}
+
+// ============================================================================
+// [ThreadPool - Run]
+// ============================================================================
+
+bool ThreadPool::run(JobFunc func, void* data, uint32_t jobCount) noexcept {
+  if (!jobCount)
+    return true;
+
+  uint32_t n = _workerCount;
+  bool distributed = n > 1;
+
+  // Worker threads are idle here, so the deques can be safely reinitialized.
+  if (distributed) {
+    uint32_t chunk = (jobCount + n - 1) / n;
+    for (uint32_t i = 0; i < n; i++) {
+      if (!_deques[i].init(chunk)) {
+        distributed = false;
+        break;
+      }
+    }
+  }
+
+  if (!distributed) {
+    for (uint32_t i = 0; i < jobCount; i++)
+      func(data, i, 0);
+    return n <= 1;
+  }
+
+  // Each worker gets a contiguous chunk of jobs pushed in reverse order, so
+  // `pop()` processes them in ascending order while thieves take them from the
+  // other end, furthest from what the owner is working on.
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t start = uint32_t(uint64_t(jobCount) * i / n);
+    uint32_t end = uint32_t(uint64_t(jobCount) * (i + 1) / n);
+
+    while (end != start)
+      _deques[i].push(--end);
+  }
+
+  _func = func;
+  _data = data;
+  _remaining.store(jobCount, std::memory_order_relaxed);
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _generation++;
+    _busyThreads = n - 1;
+  }
+  _wakeCondition.notify_all();
+
+  // The calling thread is worker 0.
+  _work(0);
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _doneCondition.wait(lock, [&] { return _busyThreads == 0; });
+
+  return true;
+}
+
+void ThreadPool::_threadMain(uint32_t workerId) noexcept {
+  uint64_t generation = 0;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wakeCondition.wait(lock, [&] { return _stop || _generation != generation; });
+
+      if (_stop)
+        return;
+      generation = _generation;
+    }
+
+    _work(workerId);
+
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      last = --_busyThreads == 0;
+    }
+
+    if (last)
+      _doneCondition.notify_one();
+  }
+}
+
+void ThreadPool::_work(uint32_t workerId) noexcept {
+  uint32_t n = _workerCount;
+  uint32_t job;
+
+  JobFunc func = _func;
+  void* data = _data;
+  WorkDeque& own = _deques[workerId];
+
+  for (;;) {
+    while (own.pop(job)) {
+      func(data, job, workerId);
+      _remaining.fetch_sub(1, std::memory_order_release);
+    }
+
+    // Own deque is empty, steal from others starting with the next worker.
+    bool stolen = false;
+    for (uint32_t i = 1; i < n && !stolen; i++) {
+      WorkDeque& victim = _deques[(workerId + i) % n];
+      stolen = victim.steal(job);
+    }
+
+    if (stolen) {
+      func(data, job, workerId);
+      _remaining.fetch_sub(1, std::memory_order_release);
+      continue;
+    }
+
+    // Jobs are never added during a run, so when all deques look empty the
+    // worker is only waiting for the jobs of others to finish. A failed steal
+    // can also be caused by contention, so retry until all jobs are done.
+    if (_remaining.load(std::memory_order_acquire) == 0)
+      break;
+
+    std::this_thread::yield();
+  }
+}
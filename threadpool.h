@@ -0,0 +1,139 @@
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include "./globals.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// ============================================================================
+// [WorkDeque]
+// ============================================================================
+
+//! Lock-free work-stealing deque of job indexes (Chase-Lev).
+//!
+//! Only the owner calls `push()` and `pop()`, which work on the bottom end,
+//! other workers call `steal()`, which takes from the top end. The capacity
+//! is fixed by `init()`, which must not be called while the deque is shared.
+//!
+//! Based on "Correct and Efficient Work-Stealing for Weak Memory Models" by
+//! Nhat Minh Le, Antoniu Pop, Albert Cohen and Francesco Zappa Nardelli.
+class WorkDeque {
+public:
+  WorkDeque() noexcept;
+  ~WorkDeque() noexcept;
+
+  WorkDeque(const WorkDeque& other) noexcept = delete;
+  WorkDeque& operator=(const WorkDeque& other) noexcept = delete;
+
+  bool init(size_t capacity) noexcept;
+
+  ALWAYS_INLINE void push(uint32_t job) noexcept {
+    int64_t b = _bottom.load(std::memory_order_relaxed);
+    assert(b - _top.load(std::memory_order_relaxed) < int64_t(_mask + 1));
+
+    _buffer[size_t(b) & _mask].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  ALWAYS_INLINE bool pop(uint32_t& job) noexcept {
+    int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = _top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      _bottom.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    job = _buffer[size_t(b) & _mask].load(std::memory_order_relaxed);
+    if (t == b) {
+      // The last job, race against thieves.
+      bool won = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      _bottom.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+
+    return true;
+  }
+
+  ALWAYS_INLINE bool steal(uint32_t& job) noexcept {
+    int64_t t = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = _bottom.load(std::memory_order_acquire);
+
+    if (t >= b)
+      return false;
+
+    job = _buffer[size_t(t) & _mask].load(std::memory_order_relaxed);
+    return _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+  alignas(64) std::atomic<int64_t> _top;
+  alignas(64) std::atomic<int64_t> _bottom;
+
+  std::atomic<uint32_t>* _buffer;
+  size_t _mask;
+};
+
+// ============================================================================
+// [ThreadPool]
+// ============================================================================
+
+//! Work-stealing thread pool for tile and band jobs.
+//!
+//! `run()` distributes `jobCount` jobs in contiguous chunks (so neighboring
+//! tiles are processed by the same worker) into per-worker deques. A worker
+//! that runs out of its own jobs steals from the others, which handles uneven
+//! costs of jobs - one tile can contain a dense text run while its neighbors
+//! are empty. The calling thread is worker `0`, so a pool of a single worker
+//! doesn't create any threads.
+//!
+//! Each job receives the index of the worker that runs it, which can be used
+//! to index per-worker scratch data (cells, bit rows) allocated once upfront.
+class ThreadPool {
+public:
+  typedef void (*JobFunc)(void* data, uint32_t jobIndex, uint32_t workerId);
+
+  //! Creates a pool of `workerCount` workers (including the calling thread),
+  //! zero means the number of hardware threads.
+  explicit ThreadPool(uint32_t workerCount = 0) noexcept;
+  ~ThreadPool() noexcept;
+
+  ThreadPool(const ThreadPool& other) noexcept = delete;
+  ThreadPool& operator=(const ThreadPool& other) noexcept = delete;
+
+  inline uint32_t workerCount() const noexcept { return _workerCount; }
+
+  //! Runs `func(data, jobIndex, workerId)` for each job and waits for all
+  //! of them to finish. Returns `false` if the jobs couldn't be distributed
+  //! (out of memory), in that case they were all run by the calling thread.
+  bool run(JobFunc func, void* data, uint32_t jobCount) noexcept;
+
+  static uint32_t hardwareConcurrency() noexcept;
+
+  void _threadMain(uint32_t workerId) noexcept;
+  void _work(uint32_t workerId) noexcept;
+
+  uint32_t _workerCount;
+  std::thread* _threads;
+  WorkDeque* _deques;
+
+  std::mutex _mutex;
+  std::condition_variable _wakeCondition;
+  std::condition_variable _doneCondition;
+
+  uint64_t _generation;
+  uint32_t _busyThreads;
+  bool _stop;
+
+  JobFunc _func;
+  void* _data;
+  std::atomic<uint32_t> _remaining;
+};
+
+#endif // _THREADPOOL_H
@@ -0,0 +1,286 @@
+#include "./tile.h"
+
+// ============================================================================
+// [TileRasterizer - Construction / Destruction]
+// ============================================================================
+
+TileRasterizer::TileRasterizer(Image& dst, uint32_t options) noexcept
+  : CellRasterizer(dst, options),
+    _tileX(0),
+    _tileY(0),
+    _tileW(0),
+    _tileH(0),
+    _originX(0),
+    _originY(0),
+    _cellStride(0),
+    _cells(nullptr),
+    _xBounds(nullptr),
+    _yBounds { 0, 0 },
+    _occlusion(nullptr),
+    _occlusionY0(0),
+    _occlusionY1(-1),
+    _occludedPixels(0) {
+  std::snprintf(_name, ARRAY_SIZE(_name), "Tile");
+  addOptionsToName();
+  _yBounds.reset();
+}
+
+TileRasterizer::~TileRasterizer() noexcept {
+  reset();
+}
+
+// ============================================================================
+// [TileRasterizer - Basics]
+// ============================================================================
+
+bool TileRasterizer::init(int w, int h) noexcept {
+  if (_width != w || _height != h) {
+    reset();
+
+    if (w == 0 || h == 0)
+      return true;
+
+    // One more cell per row as a line can end exactly at the right edge.
+    _cellStride = size_t(w) + 1;
+    _xBounds = static_cast<Bounds*>(std::malloc(size_t(h) * sizeof(Bounds)));
+    _cells = static_cast<Cell*>(std::malloc(size_t(h) * _cellStride * sizeof(Cell)));
+
+    if (!_cells || !_xBounds) {
+      if (_cells) std::free(_cells);
+      if (_xBounds) std::free(_xBounds);
+
+      _cellStride = 0;
+      _cells = nullptr;
+      _xBounds = nullptr;
+      return false;
+    }
+
+    _width = w;
+    _height = h;
+
+    std::memset(_cells, 0, size_t(h) * _cellStride * sizeof(Cell));
+    for (int y = 0; y < h; y++)
+      _xBounds[y].reset();
+    _yBounds.reset();
+
+    setTile(0, 0, std::min(w, _dst->width()), std::min(h, _dst->height()));
+  }
+  else {
+    clear();
+  }
+
+  return true;
+}
+
+void TileRasterizer::setTile(int x, int y, int w, int h) noexcept {
+  assert(w <= _width && h <= _height);
+  assert(x >= 0 && y >= 0 && x + w <= _dst->width() && y + h <= _dst->height());
+
+  clear();
+
+  _tileX = x;
+  _tileY = y;
+  _tileW = w;
+  _tileH = h;
+  _originX = x;
+  _originY = y;
+}
+
+void TileRasterizer::reset() noexcept {
+  if (isInitialized()) {
+    std::free(_cells);
+    std::free(_xBounds);
+
+    _width = 0;
+    _height = 0;
+    _tileX = 0;
+    _tileY = 0;
+    _tileW = 0;
+    _tileH = 0;
+    _originX = 0;
+    _originY = 0;
+    _cellStride = 0;
+    _cells = nullptr;
+    _xBounds = nullptr;
+    _yBounds.reset();
+  }
+}
+
+void TileRasterizer::clear() noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseClear);
+
+  if (isInitialized() && !_yBounds.empty()) {
+    size_t y0 = size_t(_yBounds.start);
+    size_t y1 = size_t(_yBounds.end);
+
+    Cell* cellPtr = _cells + y0 * _cellStride;
+    while (y0 <= y1) {
+      int x0 = _xBounds[y0].start;
+      int x1 = _xBounds[y0].end;
+
+      if (x0 <= x1) {
+        size_t width = size_t(x1 - x0 + 1);
+        std::memset(cellPtr + x0, 0, width * sizeof(Cell));
+        _xBounds[y0].reset();
+      }
+
+      cellPtr += _cellStride;
+      y0++;
+    }
+
+    _yBounds.reset();
+  }
+}
+
+// ============================================================================
+// [TileRasterizer - AddPoly / AddLine]
+// ============================================================================
+
+bool TileRasterizer::addPoly(const Point* poly, size_t count) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseAddPoly);
+
+  assert(isInitialized());
+
+  if (count < 2)
+    return true;
+
+  // Convert to fixed point first and translate afterwards so lines inside the
+  // tile produce the same cells as `RasterizerA1`. Lines crossing an edge of
+  // the tile don't, see `_addClippedLine()`.
+  int64_t ox = int64_t(_originX) << kA8Shift;
+  int64_t oy = int64_t(_originY) << kA8Shift;
+
+  int64_t x0 = int64_t(static_cast<int>(poly[0].x * 256)) - ox;
+  int64_t y0 = int64_t(static_cast<int>(poly[0].y * 256)) - oy;
+
+  for (size_t i = 1; i < count; i++) {
+    int64_t x1 = int64_t(static_cast<int>(poly[i].x * 256)) - ox;
+    int64_t y1 = int64_t(static_cast<int>(poly[i].y * 256)) - oy;
+
+    if (y0 != y1)
+      _addClippedLine(x0, y0, x1, y1);
+
+    x0 = x1;
+    y0 = y1;
+  }
+
+  return true;
+}
+
+// Lines are split at the edges of the tile. The split point is truncated to
+// 1/256 of a pixel and the walker then advances from it by its own error terms,
+// so each row crossing of the clipped part can move by a subpixel unit against
+// the unsplit line of `RasterizerA1`. That changes the coverage of a pixel by up
+// to 2 levels for each clipped edge passing through it (pixels where two edges
+// meet can differ by 4), and the result depends on where the tile edges are.
+// Walking whole lines instead would be exact, but a tile would then walk every
+// row of each line crossing it, which is 2-4x slower with 64x64 tiles.
+void TileRasterizer::_addClippedLine(int64_t x0, int64_t y0, int64_t x1, int64_t y1) noexcept {
+  int64_t yMax = int64_t(_tileH) << kA8Shift;
+
+  // Discard lines that are completely above or below the tile.
+  if ((y0 <= 0 && y1 <= 0) || (y0 >= yMax && y1 >= yMax))
+    return;
+
+  // Clip to [0, yMax].
+  if (y0 < 0) { x0 += (x1 - x0) * (0 - y0) / (y1 - y0); y0 = 0; }
+  if (y1 < 0) { x1 += (x0 - x1) * (0 - y1) / (y0 - y1); y1 = 0; }
+
+  if (y0 > yMax) { x0 += (x1 - x0) * (yMax - y0) / (y1 - y0); y0 = yMax; }
+  if (y1 > yMax) { x1 += (x0 - x1) * (yMax - y1) / (y0 - y1); y1 = yMax; }
+
+  // Project parts left of the tile onto its left edge.
+  if (x0 < 0 || x1 < 0) {
+    if (x0 <= 0 && x1 <= 0) {
+      _addRightClippedLine(0, y0, 0, y1);
+      return;
+    }
+
+    int64_t yc = y0 + (y1 - y0) * (0 - x0) / (x1 - x0);
+    if (x0 < 0) {
+      _addRightClippedLine(0, y0, 0, yc);
+      x0 = 0;
+      y0 = yc;
+    }
+    else {
+      _addRightClippedLine(0, yc, 0, y1);
+      x1 = 0;
+      y1 = yc;
+    }
+  }
+
+  _addRightClippedLine(x0, y0, x1, y1);
+}
+
+void TileRasterizer::_addRightClippedLine(int64_t x0, int64_t y0, int64_t x1, int64_t y1) noexcept {
+  int64_t xMax = int64_t(_tileW) << kA8Shift;
+
+  // Parts right of the tile don't contribute to any pixel of the tile.
+  if (x0 >= xMax && x1 >= xMax)
+    return;
+
+  if (x0 > xMax) { y0 += (y1 - y0) * (xMax - x0) / (x1 - x0); x0 = xMax; }
+  if (x1 > xMax) { y1 += (y0 - y1) * (xMax - x1) / (x0 - x1); x1 = xMax; }
+
+  if (y0 != y1)
+    addLineT<TileRasterizer, int64_t>(*this, x0, y0, x1, y1);
+}
+
+// ============================================================================
+// [TileRasterizer - Render]
+// ============================================================================
+
+void TileRasterizer::render(uint32_t argb32) noexcept {
+  PhaseScope scope(*this, PhaseTimers::kPhaseRender);
+  doRender(*this, argb32);
+}
+
+void TileRasterizer::fullSpans(Bounds* spans) noexcept {
+  if (_fillMode == kFillNonZero)
+    _fullSpansImpl<true>(spans);
+  else
+    _fullSpansImpl<false>(spans);
+}
+
+// ============================================================================
+// [TileRasterizer - Save / Load]
+// ============================================================================
+
+bool TileRasterizer::saveCells(PodArray<SavedRow>& rows, PodArray<Cell>& cells) const noexcept {
+  if (_yBounds.empty())
+    return true;
+
+  for (int y = _yBounds.start; y <= _yBounds.end; y++) {
+    const Bounds& xBounds = _xBounds[y];
+    if (xBounds.empty())
+      continue;
+
+    SavedRow row;
+    row.y = y;
+    row.x0 = xBounds.start;
+    row.x1 = xBounds.end;
+    row.cellIndex = uint32_t(cells.size());
+
+    const Cell* cellLine = _cells + size_t(y) * _cellStride;
+    if (!rows.append(row) || !cells.append(cellLine + row.x0, size_t(row.x1 - row.x0 + 1)))
+      return false;
+  }
+
+  return true;
+}
+
+void TileRasterizer::loadCells(const SavedRow* rows, size_t rowCount, const Cell* cells) noexcept {
+  assert(_yBounds.empty());
+
+  for (size_t i = 0; i < rowCount; i++) {
+    const SavedRow& row = rows[i];
+    assert(row.y >= 0 && row.y < _tileH);
+    assert(row.x0 >= 0 && row.x1 <= _tileW);
+
+    Cell* cellLine = _cells + size_t(row.y) * _cellStride;
+    std::memcpy(cellLine + row.x0, cells + row.cellIndex, size_t(row.x1 - row.x0 + 1) * sizeof(Cell));
+
+    _xBounds[row.y].reset(row.x0, row.x1);
+    _yBounds.union_(row.y, row.y);
+  }
+}
@@ -0,0 +1,325 @@
+#ifndef _TILE_H
+#define _TILE_H
+
+#include "./compositor.h"
+#include "./globals.h"
+#include "./rasterizer.h"
+
+// ============================================================================
+// [TileRasterizer]
+// ============================================================================
+
+//! Cell rasterizer that works on a rectangular window (tile) of `dst`.
+//!
+//! Cell storage is only as large as the biggest tile passed to `init()`, so a
+//! 64x64 tile keeps all of its cells in L1/L2. Polygons are given in canvas
+//! coordinates and clipped to the tile:
+//!
+//!   - parts above and below the tile are discarded,
+//!   - parts right of the tile are discarded, they cannot affect pixels of the
+//!     tile as coverage only accumulates from left to right,
+//!   - parts left of the tile are projected onto its left edge, so they still
+//!     contribute their cover, but no area.
+//!
+//! Splitting lines at the edges of the tile is not exact, pixels crossed by a
+//! clipped edge can differ from `RasterizerA1` by up to 2 levels per edge, and
+//! the difference depends on the tile size (see `_addClippedLine()`).
+//!
+//! Because coverage can leave the tile through its right edge `render()`
+//! composites the remaining cover up to the right edge of the tile (like A3).
+//!
+//! Rows can have an occluded interval set by `setOcclusion()`, pixels within it
+//! are not composited (cells are still consumed to keep the cover correct).
+class TileRasterizer : public CellRasterizer {
+public:
+  TileRasterizer(Image& dst, uint32_t options) noexcept;
+  virtual ~TileRasterizer() noexcept;
+
+  //! Allocates cell storage for tiles up to `w` x `h` pixels.
+  bool init(int w, int h) noexcept;
+
+  //! Selects the window of `dst` the rasterizer renders to, which must fit into
+  //! the size passed to `init()` and into `dst`.
+  void setTile(int x, int y, int w, int h) noexcept;
+
+  inline int tileX() const noexcept { return _tileX; }
+  inline int tileY() const noexcept { return _tileY; }
+  inline int tileW() const noexcept { return _tileW; }
+  inline int tileH() const noexcept { return _tileH; }
+
+  //! Sets canvas coordinates of the top-left corner of the tile, which are the
+  //! same as its position in `dst` by default. Used to render a window of a
+  //! large canvas into a smaller `dst` (a strip).
+  inline void setOrigin(int x, int y) noexcept {
+    _originX = x;
+    _originY = y;
+  }
+
+  //! Sets occluded pixels of tile rows `[y0, y1]`, `occlusion[0]` describes
+  //! row `y0` as an inclusive tile-local interval. Pass `nullptr` to disable.
+  inline void setOcclusion(const Bounds* occlusion, int y0, int y1) noexcept {
+    _occlusion = occlusion;
+    _occlusionY0 = y0;
+    _occlusionY1 = y1;
+  }
+
+  //! Number of pixels that were not composited because they were occluded.
+  inline uint64_t occludedPixels() const noexcept { return _occludedPixels; }
+  inline void resetOccludedPixels() noexcept { _occludedPixels = 0; }
+
+  virtual void reset() noexcept override;
+  virtual void clear() noexcept override;
+  virtual bool addPoly(const Point* poly, size_t count) noexcept override;
+
+  //! Adds a line in tile-local 24.8 fixed point, clipping it to the tile.
+  void _addClippedLine(int64_t x0, int64_t y0, int64_t x1, int64_t y1) noexcept;
+  void _addRightClippedLine(int64_t x0, int64_t y0, int64_t x1, int64_t y1) noexcept;
+
+  inline void _mergeCell(int x, int y, int cover, int area) noexcept {
+    assert(x >= 0 && x <= _tileW);
+    assert(y >= 0 && y < _tileH);
+
+    _xBounds[y].union_(x, x);
+    _yBounds.union_(y, y);
+
+    Cell& cell = _cells[size_t(y) * _cellStride + size_t(x)];
+    cell.cover += cover;
+    cell.area  += area;
+    RAS_STATS_ADD(_stats, cellsMerged, 1);
+  }
+
+  template<class Compositor, bool NonZero>
+  inline void _renderImpl(uint32_t argb32) noexcept;
+
+  virtual void render(uint32_t argb32) noexcept override;
+
+  //! Consumes the cells like `render()` without compositing anything and stores
+  //! the longest run of fully covered pixels of each tile row into `spans`.
+  //! Rows without a run get an empty interval.
+  void fullSpans(Bounds* spans) noexcept;
+
+  template<bool NonZero>
+  inline void _fullSpansImpl(Bounds* spans) noexcept;
+
+  //! Row of cells copied by `saveCells()`, `cellIndex` is the index of the
+  //! cell at `x0` and the row has cells `[x0, x1]`.
+  struct SavedRow {
+    int y;
+    int x0;
+    int x1;
+    uint32_t cellIndex;
+  };
+
+  //! Appends a copy of the accumulated cells to `rows` and `cells`, the cells
+  //! themselves are kept. Used to render a polygon after `fullSpans()` without
+  //! adding it again.
+  bool saveCells(PodArray<SavedRow>& rows, PodArray<Cell>& cells) const noexcept;
+
+  //! Restores `rowCount` rows saved by `saveCells()`, the rasterizer must be
+  //! empty and the tile the same as when the cells were saved.
+  void loadCells(const SavedRow* rows, size_t rowCount, const Cell* cells) noexcept;
+
+  //! Accumulates the cover of cells `[x0, x1)` and resets them.
+  static ALWAYS_INLINE void _skipCells(Cell* cells, size_t x0, size_t x1, int& cover) noexcept {
+    while (x0 < x1) {
+      cover += cells[x0].cover;
+      cells[x0].reset();
+      x0++;
+    }
+  }
+
+  int _tileX;
+  int _tileY;
+  int _tileW;
+  int _tileH;
+  int _originX;
+  int _originY;
+
+  size_t _cellStride;
+  Cell* _cells;
+  Bounds* _xBounds;
+  Bounds _yBounds;
+
+  const Bounds* _occlusion;
+  int _occlusionY0;
+  int _occlusionY1;
+  uint64_t _occludedPixels;
+};
+
+// ============================================================================
+// [TileRasterizer - Render]
+// ============================================================================
+
+template<class Compositor, bool NonZero>
+inline void TileRasterizer::_renderImpl(uint32_t argb32) noexcept {
+  RAS_STATS_ADD(_stats, renderCalls, 1);
+
+  if (_yBounds.empty()) {
+    RAS_STATS_ADD(_stats, rowsSkipped, _tileH);
+    return;
+  }
+
+  size_t y0 = size_t(_yBounds.start);
+  size_t y1 = size_t(_yBounds.end);
+  size_t w = size_t(_tileW);
+
+  intptr_t stride = _dst->stride();
+  uint8_t* dstLine = _dst->data() + intptr_t(_tileY + int(y0)) * stride + intptr_t(_tileX) * 4;
+  Cell* cellLine = _cells + y0 * _cellStride;
+
+  Compositor compositor(argb32);
+  size_t rowsRendered = 0;
+
+  while (y0 <= y1) {
+    Bounds& xBounds = _xBounds[y0];
+
+    if (!xBounds.empty()) {
+      uint32_t* dstPix = reinterpret_cast<uint32_t*>(dstLine);
+      size_t x0 = size_t(xBounds.start);
+      size_t xEnd = size_t(xBounds.end) + 1;
+      size_t x1 = std::min(xEnd, w);
+
+      // Occluded pixels `[oStart, oEnd)` of this row, if any.
+      size_t oStart = w;
+      size_t oEnd = w;
+
+      if (_occlusion && int(y0) >= _occlusionY0 && int(y0) <= _occlusionY1) {
+        const Bounds& o = _occlusion[int(y0) - _occlusionY0];
+        if (!o.empty()) {
+          oStart = std::min(size_t(o.start), w);
+          oEnd = std::min(size_t(o.end) + 1, w);
+        }
+      }
+
+      int cover = 0;
+      if (oStart >= oEnd) {
+        compositor.template vmask<NonZero>(dstPix, x0, x1, cellLine, cover);
+        RAS_STATS_ADD(_stats, vmaskSpans, 1);
+        RAS_STATS_ADD(_stats, vmaskPixels, x1 - x0);
+      }
+      else {
+        size_t a = std::min(std::max(oStart, x0), x1);
+        size_t b = std::min(std::max(oEnd, a), x1);
+
+        if (x0 < a) compositor.template vmask<NonZero>(dstPix, x0, a, cellLine, cover);
+        _skipCells(cellLine, a, b, cover);
+        if (b < x1) compositor.template vmask<NonZero>(dstPix, b, x1, cellLine, cover);
+        _occludedPixels += b - a;
+
+        RAS_STATS_ADD(_stats, vmaskSpans, size_t(x0 < a) + size_t(b < x1));
+        RAS_STATS_ADD(_stats, vmaskPixels, (a - x0) + (x1 - b));
+      }
+
+      // A line ending exactly at the right edge of the tile can produce a cell
+      // at `w`, which has no pixel, but must be cleared.
+      if (x1 < xEnd)
+        cellLine[x1].reset();
+
+      if (x1 < w) {
+        uint32_t mask = CompositeUtils::calcMask<NonZero>(cover);
+        if (mask) {
+          size_t a = std::max(oStart, x1);
+          size_t b = std::max(oEnd, a);
+
+          if (x1 < a) compositor.cmask(dstPix, x1, a, mask);
+          if (b < w) compositor.cmask(dstPix, b, w, mask);
+          _occludedPixels += b - a;
+
+          RAS_STATS_ADD(_stats, cmaskSpans, size_t(x1 < a) + size_t(b < w));
+          RAS_STATS_ADD(_stats, cmaskPixels, (a - x1) + (w - b));
+        }
+      }
+
+      xBounds.reset();
+      rowsRendered++;
+    }
+
+    y0++;
+    dstLine += stride;
+    cellLine += _cellStride;
+  }
+
+  // Rows are counted within the tile.
+  RAS_STATS_ADD(_stats, rowsRendered, rowsRendered);
+  RAS_STATS_ADD(_stats, rowsSkipped, size_t(_tileH) - rowsRendered);
+  _yBounds.reset();
+}
+
+template<bool NonZero>
+inline void TileRasterizer::_fullSpansImpl(Bounds* spans) noexcept {
+  for (int y = 0; y < _tileH; y++)
+    spans[y].reset();
+
+  if (_yBounds.empty())
+    return;
+
+  size_t y0 = size_t(_yBounds.start);
+  size_t y1 = size_t(_yBounds.end);
+  size_t w = size_t(_tileW);
+
+  Cell* cellLine = _cells + y0 * _cellStride;
+  while (y0 <= y1) {
+    Bounds& xBounds = _xBounds[y0];
+
+    if (!xBounds.empty()) {
+      size_t x = size_t(xBounds.start);
+      size_t xEnd = size_t(xBounds.end) + 1;
+      size_t x1 = std::min(xEnd, w);
+
+      size_t runStart = 0;
+      size_t bestStart = 0;
+      size_t bestEnd = 0;
+      bool inRun = false;
+      int cover = 0;
+
+      for (; x < x1; x++) {
+        cover += cellLine[x].cover;
+        uint32_t mask = CompositeUtils::calcMask<NonZero>(cover - (cellLine[x].area >> 9));
+        cellLine[x].reset();
+
+        if (mask == 255) {
+          if (!inRun) {
+            runStart = x;
+            inRun = true;
+          }
+        }
+        else if (inRun) {
+          if (x - runStart > bestEnd - bestStart) {
+            bestStart = runStart;
+            bestEnd = x;
+          }
+          inRun = false;
+        }
+      }
+
+      if (x1 < xEnd)
+        cellLine[x1].reset();
+
+      // The remaining cover spans up to the right edge of the tile.
+      if (x1 < w && CompositeUtils::calcMask<NonZero>(cover) == 255) {
+        if (!inRun) {
+          runStart = x1;
+          inRun = true;
+        }
+        x1 = w;
+      }
+
+      if (inRun && x1 - runStart > bestEnd - bestStart) {
+        bestStart = runStart;
+        bestEnd = x1;
+      }
+
+      if (bestStart < bestEnd)
+        spans[y0].reset(int(bestStart), int(bestEnd) - 1);
+
+      xBounds.reset();
+    }
+
+    y0++;
+    cellLine += _cellStride;
+  }
+
+  _yBounds.reset();
+}
+
+#endif // _TILE_H
@@ -0,0 +1,295 @@
+#include "./trace.h"
+
+// ============================================================================
+// [TraceWriter - Construction / Destruction]
+// ============================================================================
+
+TraceWriter::TraceWriter() noexcept
+  : _file(nullptr),
+    _commandCount(0),
+    _failed(false) {}
+
+TraceWriter::~TraceWriter() noexcept {
+  close();
+}
+
+// ============================================================================
+// [TraceWriter - Open / Close]
+// ============================================================================
+
+bool TraceWriter::open(const char* fileName, int w, int h) noexcept {
+  close();
+
+  if (w <= 0 || h <= 0)
+    return false;
+
+  _file = std::fopen(fileName, "wb");
+  if (!_file)
+    return false;
+
+  _commandCount = 0;
+  _failed = false;
+
+  // The number of commands is only known when the trace is closed.
+  TraceHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = TraceHeader::kMagic;
+  header.version = TraceHeader::kVersion;
+  header.width = w;
+  header.height = h;
+
+  if (std::fwrite(&header, sizeof(header), 1, _file) != 1)
+    _failed = true;
+  return !_failed;
+}
+
+bool TraceWriter::close() noexcept {
+  if (!_file)
+    return true;
+
+  if (!_failed) {
+    uint64_t commandCount = _commandCount;
+    if (std::fseek(_file, long(offsetof(TraceHeader, commandCount)), SEEK_SET) != 0 ||
+        std::fwrite(&commandCount, sizeof(commandCount), 1, _file) != 1)
+      _failed = true;
+  }
+
+  if (std::fclose(_file) != 0)
+    _failed = true;
+
+  _file = nullptr;
+  return !_failed;
+}
+
+// ============================================================================
+// [TraceWriter - Commands]
+// ============================================================================
+
+bool TraceWriter::command(uint32_t op, uint32_t value) noexcept {
+  if (!_file || _failed)
+    return false;
+
+  TraceCommand cmd;
+  cmd.op = op;
+  cmd.value = value;
+
+  if (std::fwrite(&cmd, sizeof(cmd), 1, _file) != 1) {
+    _failed = true;
+    return false;
+  }
+
+  _commandCount++;
+  return true;
+}
+
+bool TraceWriter::addPoly(const Point* poly, size_t count) noexcept {
+  if (count > std::numeric_limits<uint32_t>::max() || !command(TraceCommand::kOpAddPoly, uint32_t(count)))
+    return false;
+
+  if (count && std::fwrite(poly, sizeof(Point), count, _file) != count) {
+    _failed = true;
+    return false;
+  }
+  return true;
+}
+
+// ============================================================================
+// [TraceRecorder]
+// ============================================================================
+
+TraceRecorder::TraceRecorder(Rasterizer* target, TraceWriter& writer) noexcept
+  : Rasterizer(*target->_dst, target->options()),
+    _target(target),
+    _writer(&writer),
+    _recordedFillMode(0xFFFFFFFFu) {
+
+  std::snprintf(_name, ARRAY_SIZE(_name), "%s", target->name());
+  _width = target->width();
+  _height = target->height();
+  _fillMode = target->fillMode();
+}
+
+TraceRecorder::~TraceRecorder() noexcept {}
+
+void TraceRecorder::reset() noexcept {
+  _target->reset();
+
+  // The target has a canvas of zero size now.
+  _width = 0;
+  _height = 0;
+}
+
+void TraceRecorder::clear() noexcept {
+  _writer->command(TraceCommand::kOpClear, 0);
+  _target->clear();
+}
+
+bool TraceRecorder::addPoly(const Point* poly, size_t count) noexcept {
+  _writer->addPoly(poly, count);
+  return _target->addPoly(poly, count);
+}
+
+void TraceRecorder::render(uint32_t argb32) noexcept {
+  if (_fillMode != _recordedFillMode) {
+    _writer->command(TraceCommand::kOpSetFillMode, _fillMode);
+    _recordedFillMode = _fillMode;
+  }
+
+  _writer->command(TraceCommand::kOpRender, argb32);
+  _target->setFillMode(_fillMode);
+  _target->render(argb32);
+}
+
+// ============================================================================
+// [TraceReader - Construction / Destruction]
+// ============================================================================
+
+TraceReader::TraceReader() noexcept
+  : _header(nullptr),
+    _commandCount(0),
+    _polyCount(0),
+    _renderCount(0),
+    _pixels(0.0) {}
+
+TraceReader::~TraceReader() noexcept {
+  reset();
+}
+
+void TraceReader::reset() noexcept {
+  _file.reset();
+  _header = nullptr;
+  _commandCount = 0;
+  _polyCount = 0;
+  _renderCount = 0;
+  _pixels = 0.0;
+}
+
+// ============================================================================
+// [TraceReader - Open]
+// ============================================================================
+
+bool TraceReader::open(const char* fileName) noexcept {
+  reset();
+
+  if (!_file.open(fileName))
+    return false;
+
+  if (_file.size() < sizeof(TraceHeader) || !_validate()) {
+    reset();
+    return false;
+  }
+
+  return true;
+}
+
+bool TraceReader::_validate() noexcept {
+  const uint8_t* data = _file.data();
+  size_t size = _file.size();
+
+  const TraceHeader* header = reinterpret_cast<const TraceHeader*>(data);
+  if (header->magic != TraceHeader::kMagic || header->version != TraceHeader::kVersion ||
+      header->width <= 0 || header->height <= 0)
+    return false;
+
+  double w = double(header->width);
+  double h = double(header->height);
+
+  // Bounding box of polygons added since the last render.
+  double bx0 = w, by0 = h, bx1 = 0.0, by1 = 0.0;
+
+  size_t offset = sizeof(TraceHeader);
+  while (offset < size) {
+    if (size - offset < sizeof(TraceCommand))
+      return false;
+
+    const TraceCommand* cmd = reinterpret_cast<const TraceCommand*>(data + offset);
+    offset += sizeof(TraceCommand);
+
+    switch (cmd->op) {
+      case TraceCommand::kOpClear:
+        bx0 = w; by0 = h; bx1 = 0.0; by1 = 0.0;
+        break;
+
+      case TraceCommand::kOpAddPoly: {
+        size_t count = cmd->value;
+        if ((size - offset) / sizeof(Point) < count)
+          return false;
+
+        // Rasterizers expect all points within the canvas (`!(a <= b)` also
+        // rejects NaNs).
+        const Point* poly = reinterpret_cast<const Point*>(data + offset);
+        for (size_t i = 0; i < count; i++) {
+          double x = poly[i].x;
+          double y = poly[i].y;
+          if (!(x >= 0.0 && x <= w && y >= 0.0 && y <= h))
+            return false;
+
+          bx0 = std::min(bx0, x);
+          by0 = std::min(by0, y);
+          bx1 = std::max(bx1, x);
+          by1 = std::max(by1, y);
+        }
+
+        offset += count * sizeof(Point);
+        _polyCount++;
+        break;
+      }
+
+      case TraceCommand::kOpSetFillMode:
+        if (cmd->value != Rasterizer::kFillEvenOdd && cmd->value != Rasterizer::kFillNonZero)
+          return false;
+        break;
+
+      case TraceCommand::kOpRender:
+        if (bx0 < bx1 && by0 < by1)
+          _pixels += (std::ceil(bx1) - std::floor(bx0)) * (std::ceil(by1) - std::floor(by0));
+        _renderCount++;
+        break;
+
+      default:
+        return false;
+    }
+
+    _commandCount++;
+  }
+
+  if (header->commandCount != 0 && header->commandCount != _commandCount)
+    return false;
+
+  _header = header;
+  return true;
+}
+
+// ============================================================================
+// [TraceReader - Replay]
+// ============================================================================
+
+void TraceReader::replay(Rasterizer& ras) const noexcept {
+  const uint8_t* data = _file.data();
+  size_t size = _file.size();
+  size_t offset = sizeof(TraceHeader);
+
+  while (offset < size) {
+    const TraceCommand* cmd = reinterpret_cast<const TraceCommand*>(data + offset);
+    offset += sizeof(TraceCommand);
+
+    switch (cmd->op) {
+      case TraceCommand::kOpClear:
+        ras.clear();
+        break;
+
+      case TraceCommand::kOpAddPoly:
+        ras.addPoly(reinterpret_cast<const Point*>(data + offset), cmd->value);
+        offset += size_t(cmd->value) * sizeof(Point);
+        break;
+
+      case TraceCommand::kOpSetFillMode:
+        ras.setFillMode(cmd->value);
+        break;
+
+      case TraceCommand::kOpRender:
+        ras.render(cmd->value);
+        break;
+    }
+  }
+}
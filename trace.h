@@ -0,0 +1,152 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "./globals.h"
+#include "./rasterizer.h"
+
+// ============================================================================
+// [TraceFormat]
+// ============================================================================
+
+//! Header at the beginning of a trace file.
+//!
+//! A trace is a sequence of `TraceCommand` records, each optionally followed
+//! by its data. All records are 8-byte aligned so the points of `addPoly()`
+//! can be passed to a rasterizer directly from a mapped file. Values are
+//! stored in the native byte order (traces are not portable between little
+//! and big endian machines).
+struct TraceHeader {
+  enum : uint32_t {
+    kMagic = 0x43525452u, // 'RTRC'.
+    kVersion = 1
+  };
+
+  uint32_t magic;
+  uint32_t version;
+  //! Size of the canvas the trace was recorded on.
+  int32_t width;
+  int32_t height;
+  //! Number of commands, zero if the recording was not finished properly.
+  uint64_t commandCount;
+  uint64_t reserved;
+};
+
+//! A recorded rasterizer call.
+struct TraceCommand {
+  enum Op : uint32_t {
+    //! `clear()`.
+    kOpClear = 0,
+    //! `addPoly()`, `value` is the number of points that follow the command.
+    kOpAddPoly,
+    //! `setFillMode()`, `value` is the fill mode.
+    kOpSetFillMode,
+    //! `render()`, `value` is the ARGB32 color.
+    kOpRender,
+
+    kOpCount
+  };
+
+  uint32_t op;
+  uint32_t value;
+};
+
+// ============================================================================
+// [TraceWriter]
+// ============================================================================
+
+//! Writes rasterizer calls into a trace file.
+class TraceWriter {
+public:
+  TraceWriter() noexcept;
+  ~TraceWriter() noexcept;
+
+  TraceWriter(const TraceWriter& other) noexcept = delete;
+  TraceWriter& operator=(const TraceWriter& other) noexcept = delete;
+
+  //! Creates a trace file `fileName` of a `w` x `h` canvas.
+  bool open(const char* fileName, int w, int h) noexcept;
+  //! Finishes the trace (writes the number of commands to its header), returns
+  //! `false` if any write failed.
+  bool close() noexcept;
+
+  inline bool isOpen() const noexcept { return _file != nullptr; }
+  inline uint64_t commandCount() const noexcept { return _commandCount; }
+
+  bool command(uint32_t op, uint32_t value) noexcept;
+  bool addPoly(const Point* poly, size_t count) noexcept;
+
+  FILE* _file;
+  uint64_t _commandCount;
+  bool _failed;
+};
+
+// ============================================================================
+// [TraceRecorder]
+// ============================================================================
+
+//! Rasterizer that records all calls by a `TraceWriter` and forwards them to
+//! `target`, which renders as usual (the recorder doesn't own it).
+//!
+//! `setFillMode()` is not virtual, the fill mode is recorded by `render()` if
+//! it changed since the previous one. `reset()` is not recorded, it releases
+//! the storage of the target, which cannot be used afterwards.
+class TraceRecorder : public Rasterizer {
+public:
+  TraceRecorder(Rasterizer* target, TraceWriter& writer) noexcept;
+  virtual ~TraceRecorder() noexcept;
+
+  virtual void reset() noexcept override;
+  virtual void clear() noexcept override;
+  virtual bool addPoly(const Point* poly, size_t count) noexcept override;
+  virtual void render(uint32_t argb32) noexcept override;
+
+  Rasterizer* _target;
+  TraceWriter* _writer;
+  uint32_t _recordedFillMode;
+};
+
+// ============================================================================
+// [TraceReader]
+// ============================================================================
+
+//! Maps a trace file (read-only) and replays it against any rasterizer.
+//!
+//! The whole trace is validated by `open()`, so a replay never passes invalid
+//! data (points outside of the canvas, unknown fill modes) to a rasterizer.
+class TraceReader {
+public:
+  TraceReader() noexcept;
+  ~TraceReader() noexcept;
+
+  TraceReader(const TraceReader& other) noexcept = delete;
+  TraceReader& operator=(const TraceReader& other) noexcept = delete;
+
+  //! Maps and validates trace `fileName`.
+  bool open(const char* fileName) noexcept;
+  void reset() noexcept;
+
+  inline int width() const noexcept { return _header ? _header->width : 0; }
+  inline int height() const noexcept { return _header ? _header->height : 0; }
+
+  inline uint64_t commandCount() const noexcept { return _commandCount; }
+  inline uint64_t polyCount() const noexcept { return _polyCount; }
+  inline uint64_t renderCount() const noexcept { return _renderCount; }
+  //! Pixels of bounding boxes of all rendered polygons (like `Scene` pixels).
+  inline double pixels() const noexcept { return _pixels; }
+
+  //! Issues all commands of the trace on `ras`, which should have a canvas of
+  //! the size of the trace (or larger).
+  void replay(Rasterizer& ras) const noexcept;
+
+  bool _validate() noexcept;
+
+  MappedFile _file;
+  //! Header of a validated trace, `nullptr` if there is none.
+  const TraceHeader* _header;
+  uint64_t _commandCount;
+  uint64_t _polyCount;
+  uint64_t _renderCount;
+  double _pixels;
+};
+
+#endif // _TRACE_H
@@ -0,0 +1,321 @@
+#include "./workload.h"
+
+// ============================================================================
+// [Workload - Names]
+// ============================================================================
+
+static const char workloadNames[] =
+  "random\0"
+  "glyphs\0"
+  "slivers\0"
+  "hlines\0"
+  "vlines\0"
+  "stars\0"
+  "spirals\0"
+  "rects\0"
+  "circles\0"
+  "overlapping\0";
+
+const char* Workload::nameOf(uint32_t id) noexcept {
+  const char* name = workloadNames;
+  if (id >= kIdCount)
+    return "unknown";
+
+  while (id) {
+    name += strlen(name) + 1;
+    id--;
+  }
+  return name;
+}
+
+uint32_t Workload::idByName(const char* name, size_t nameSize) noexcept {
+  for (uint32_t id = 0; id < kIdCount; id++) {
+    const char* s = nameOf(id);
+    if (strlen(s) == nameSize && memcmp(s, name, nameSize) == 0)
+      return id;
+  }
+  return kIdCount;
+}
+
+// ============================================================================
+// [Workload - Parameters]
+// ============================================================================
+
+bool Workload::hasVertexCount(uint32_t id) noexcept {
+  return id == kIdRandom  ||
+         id == kIdStars   ||
+         id == kIdSpirals ||
+         id == kIdCircles ||
+         id == kIdOverlapping;
+}
+
+bool Workload::hasSize(uint32_t id) noexcept {
+  return id != kIdRandom;
+}
+
+uint32_t Workload::defaultVertexCount(uint32_t id) noexcept {
+  switch (id) {
+    case kIdRandom     : return 5;
+    case kIdGlyphs     : return 16;
+    case kIdSlivers    : return 3;
+    case kIdStars      : return 10;
+    case kIdSpirals    : return 128;
+    case kIdCircles    : return 64;
+    case kIdOverlapping: return 64;
+    default            : return 4;
+  }
+}
+
+double Workload::defaultSize(uint32_t id, int w, int h) noexcept {
+  double minSize = double(std::min(w, h));
+  switch (id) {
+    case kIdGlyphs     : return 12.0;
+    case kIdSlivers    : return minSize * 0.5;
+    case kIdHLines     : return double(w) * 0.9;
+    case kIdVLines     : return double(h) * 0.9;
+    case kIdRects      : return 16.0;
+    case kIdRandom     : return minSize;
+    default            : return 64.0;
+  }
+}
+
+// ============================================================================
+// [Workload - Generate]
+// ============================================================================
+
+static constexpr double kWorkloadPi = 3.14159265358979323846;
+
+// Returns a random position of an object of `size` so it fits the canvas of
+// `canvasSize` (if possible).
+static inline double workloadPlace(Random& rnd, double size, int canvasSize) noexcept {
+  return rnd.nextDouble() * std::max(double(canvasSize) - size, 0.0);
+}
+
+static inline uint32_t workloadGcd(uint32_t a, uint32_t b) noexcept {
+  while (b) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// Points can get slightly out of the canvas (thickness of slivers, shapes that
+// don't fit), rasterizers expect them within.
+static void workloadClamp(Point* poly, uint32_t n, double dw, double dh) noexcept {
+  for (uint32_t i = 0; i < n; i++) {
+    poly[i].x = std::min(std::max(poly[i].x, 0.0), dw);
+    poly[i].y = std::min(std::max(poly[i].y, 0.0), dh);
+  }
+}
+
+static void workloadEllipse(Point* poly, uint32_t n, double cx, double cy, double rx, double ry, bool reverse) noexcept {
+  for (uint32_t i = 0; i < n; i++) {
+    double a = double(reverse ? n - i : i) * (2.0 * kWorkloadPi) / double(n);
+    poly[i].x = cx + std::cos(a) * rx;
+    poly[i].y = cy + std::sin(a) * ry;
+  }
+}
+
+bool Workload::generate(Scene& scene, const Params& params) noexcept {
+  scene.clear();
+
+  int w = params.w;
+  int h = params.h;
+  if (w <= 0 || h <= 0 || params.id >= kIdCount)
+    return false;
+
+  uint32_t id = params.id;
+  uint32_t n = params.vertexCount ? params.vertexCount : defaultVertexCount(id);
+  double size = params.size > 0.0 ? params.size : defaultSize(id, w, h);
+
+  // Vertices are counted per shape, a glyph has two contours.
+  n = std::max<uint32_t>(n, 3);
+  if (id == kIdStars || id == kIdSpirals)
+    n = std::max<uint32_t>((n + 1) & ~uint32_t(1), 4);
+
+  PodArray<Point> points;
+  if (!points.reserve(n))
+    return false;
+
+  Point* poly = points.data();
+  Random rnd(params.seed);
+
+  double dw = double(w - 1);
+  double dh = double(h - 1);
+
+  if (id == kIdHLines)
+    size = std::min(size, dw);
+  else if (id == kIdVLines)
+    size = std::min(size, dh);
+  else
+    size = std::min(size, std::min(dw, dh));
+
+  for (uint32_t shapeIndex = 0; shapeIndex < params.quantity; shapeIndex++) {
+    uint32_t argb32 = rnd.nextUInt32() | 0xFF000000U;
+
+    switch (id) {
+      case kIdRandom: {
+        for (uint32_t i = 0; i < n; i++) {
+          poly[i].x = rnd.nextDouble() * dw;
+          poly[i].y = rnd.nextDouble() * dh;
+        }
+
+        if (!scene.addPoly(poly, n))
+          return false;
+        break;
+      }
+
+      case kIdGlyphs: {
+        uint32_t outerCount = std::max<uint32_t>(n - n / 3, 3);
+        uint32_t innerCount = std::max<uint32_t>(n - outerCount, 3);
+
+        double rx = size * 0.4;
+        double ry = size * 0.5;
+        double cx = workloadPlace(rnd, size, w) + size * 0.5;
+        double cy = workloadPlace(rnd, size, h) + size * 0.5;
+
+        workloadEllipse(poly, outerCount, cx, cy, rx, ry, false);
+        for (uint32_t i = 0; i < outerCount; i++) {
+          double jitter = 0.85 + rnd.nextDouble() * 0.15;
+          poly[i].x = cx + (poly[i].x - cx) * jitter;
+          poly[i].y = cy + (poly[i].y - cy) * jitter;
+        }
+
+        workloadClamp(poly, outerCount, dw, dh);
+        if (!scene.addPoly(poly, outerCount))
+          return false;
+
+        // The counter has the opposite direction, so it's a hole.
+        workloadEllipse(poly, innerCount, cx, cy, rx * 0.45, ry * 0.45, true);
+        workloadClamp(poly, innerCount, dw, dh);
+        if (!scene.addPoly(poly, innerCount))
+          return false;
+        break;
+      }
+
+      case kIdSlivers: {
+        double a = rnd.nextDouble() * (2.0 * kWorkloadPi);
+        double dx = std::cos(a) * size;
+        double dy = std::sin(a) * size;
+        double thickness = 0.25 + rnd.nextDouble() * 1.25;
+
+        double x = workloadPlace(rnd, std::fabs(dx), w) + std::max(-dx, 0.0);
+        double y = workloadPlace(rnd, std::fabs(dy), h) + std::max(-dy, 0.0);
+
+        poly[0].x = x;
+        poly[0].y = y;
+        poly[1].x = x + dx;
+        poly[1].y = y + dy;
+        poly[2].x = x + dx - std::sin(a) * thickness;
+        poly[2].y = y + dy + std::cos(a) * thickness;
+
+        workloadClamp(poly, 3, dw, dh);
+        if (!scene.addPoly(poly, 3))
+          return false;
+        break;
+      }
+
+      case kIdHLines:
+      case kIdVLines:
+      case kIdRects: {
+        double sx = id == kIdVLines ? 1.0 : size;
+        double sy = id == kIdHLines ? 1.0 : size;
+        double x = workloadPlace(rnd, sx, w);
+        double y = workloadPlace(rnd, sy, h);
+
+        Point rect[] = { { x, y }, { x + sx, y }, { x + sx, y + sy }, { x, y + sy } };
+        workloadClamp(rect, 4, dw, dh);
+        if (!scene.addPoly(rect, 4))
+          return false;
+        break;
+      }
+
+      case kIdStars: {
+        double r = size * 0.5;
+        double cx = workloadPlace(rnd, size, w) + r;
+        double cy = workloadPlace(rnd, size, h) + r;
+        double angle = rnd.nextDouble() * (2.0 * kWorkloadPi);
+
+        for (uint32_t i = 0; i < n; i++) {
+          double a = angle + double(i) * (2.0 * kWorkloadPi) / double(n);
+          double ri = (i & 1) ? r * 0.5 : r;
+          poly[i].x = cx + std::cos(a) * ri;
+          poly[i].y = cy + std::sin(a) * ri;
+        }
+
+        workloadClamp(poly, n, dw, dh);
+        if (!scene.addPoly(poly, n))
+          return false;
+        break;
+      }
+
+      case kIdSpirals: {
+        // A band of 3 turns, the outer edge goes out and the inner one back.
+        uint32_t half = n / 2;
+        double turns = 3.0;
+        double r = size * 0.5;
+        double band = r / (turns * 2.0);
+        double cx = workloadPlace(rnd, size, w) + r;
+        double cy = workloadPlace(rnd, size, h) + r;
+
+        for (uint32_t i = 0; i < half; i++) {
+          double t = double(i) / double(half - 1);
+          double a = t * turns * (2.0 * kWorkloadPi);
+          double ro = band + (r - band) * t;
+          double ri = ro - band;
+
+          poly[i].x = cx + std::cos(a) * ro;
+          poly[i].y = cy + std::sin(a) * ro;
+          poly[n - 1 - i].x = cx + std::cos(a) * ri;
+          poly[n - 1 - i].y = cy + std::sin(a) * ri;
+        }
+
+        workloadClamp(poly, n, dw, dh);
+        if (!scene.addPoly(poly, n))
+          return false;
+        break;
+      }
+
+      case kIdCircles: {
+        double r = size * 0.5;
+        double cx = workloadPlace(rnd, size, w) + r;
+        double cy = workloadPlace(rnd, size, h) + r;
+
+        workloadEllipse(poly, n, cx, cy, r, r, false);
+        workloadClamp(poly, n, dw, dh);
+        if (!scene.addPoly(poly, n))
+          return false;
+        break;
+      }
+
+      case kIdOverlapping: {
+        // Star polygon `{n/k}` with `k` close to `n/2`, which winds around its
+        // center `k` times.
+        uint32_t k = std::max<uint32_t>(n / 2 - 1, 1);
+        while (k > 1 && workloadGcd(n, k) != 1)
+          k--;
+
+        double r = size * 0.5;
+        double cx = workloadPlace(rnd, size, w) + r;
+        double cy = workloadPlace(rnd, size, h) + r;
+
+        for (uint32_t i = 0; i < n; i++) {
+          double a = double((uint64_t(i) * k) % n) * (2.0 * kWorkloadPi) / double(n);
+          poly[i].x = cx + std::cos(a) * r;
+          poly[i].y = cy + std::sin(a) * r;
+        }
+
+        workloadClamp(poly, n, dw, dh);
+        if (!scene.addPoly(poly, n))
+          return false;
+        break;
+      }
+    }
+
+    if (!scene.fill(argb32, Rasterizer::kFillNonZero))
+      return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,84 @@
+#ifndef _WORKLOAD_H
+#define _WORKLOAD_H
+
+#include "./globals.h"
+#include "./scene.h"
+
+// ============================================================================
+// [Workload]
+// ============================================================================
+
+//! Parameterized generators of benchmark scenes.
+//!
+//! Each workload generates `quantity` shapes of random opaque colors placed
+//! randomly within the canvas. Most workloads are scaled by the size of their
+//! shapes and some of them (stars, spirals, circles, and overlapping shapes)
+//! also by their number of vertices, which shows how rasterizers scale with
+//! the number of edges vs the number of pixels.
+class Workload {
+public:
+  enum Id : uint32_t {
+    //! Polygons with random vertices spanning the whole canvas.
+    kIdRandom = 0,
+    //! Tiny glyph-like shapes - an outline with a counter (hole).
+    kIdGlyphs,
+    //! Long thin triangles.
+    kIdSlivers,
+    //! Long horizontal lines, one pixel thick.
+    kIdHLines,
+    //! Long vertical lines, one pixel thick.
+    kIdVLines,
+    //! Stars having `vertexCount` vertices.
+    kIdStars,
+    //! Spiral bands having `vertexCount` vertices.
+    kIdSpirals,
+    //! Axis aligned rectangles at fractional coordinates.
+    kIdRects,
+    //! Circles approximated by `vertexCount` segments.
+    kIdCircles,
+    //! Star polygons `{n/k}` that wind around their center many times (filled
+    //! by the non-zero rule).
+    kIdOverlapping,
+
+    kIdCount
+  };
+
+  struct Params {
+    inline Params() noexcept
+      : id(kIdRandom),
+        w(0),
+        h(0),
+        quantity(0),
+        vertexCount(0),
+        size(0.0),
+        seed(0) {}
+
+    uint32_t id;
+    //! Canvas size.
+    int w, h;
+    //! Number of shapes.
+    uint32_t quantity;
+    //! Number of vertices of each shape (zero means the default of the workload).
+    uint32_t vertexCount;
+    //! Size of each shape in pixels (zero means the default of the workload).
+    double size;
+    uint64_t seed;
+  };
+
+  static const char* nameOf(uint32_t id) noexcept;
+  //! Returns the id of workload `name` or `kIdCount` if there is no such one.
+  static uint32_t idByName(const char* name, size_t nameSize) noexcept;
+
+  //! Returns `true` if the workload is scaled by `Params::vertexCount`.
+  static bool hasVertexCount(uint32_t id) noexcept;
+  //! Returns `true` if the workload is scaled by `Params::size`.
+  static bool hasSize(uint32_t id) noexcept;
+
+  static uint32_t defaultVertexCount(uint32_t id) noexcept;
+  static double defaultSize(uint32_t id, int w, int h) noexcept;
+
+  //! Clears `scene` and generates shapes of the workload into it.
+  static bool generate(Scene& scene, const Params& params) noexcept;
+};
+
+#endif // _WORKLOAD_H